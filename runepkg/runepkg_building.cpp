@@ -175,7 +175,7 @@ private:
 
                         // Replace 'Architecture: any' with actual architecture
                         if (line.compare(0, 13, "Architecture:") == 0 && line.find("any") != std::string::npos) {
-                            out << "Architecture: amd64\n";
+                            out << "Architecture: " << runepkg_config_native_arch() << "\n";
                         } else {
                             out << line << "\n";
                         }
@@ -194,7 +194,7 @@ private:
 
         // 5. Build .deb using core runepkg logic
         std::cout << "  -> Assembling .deb package..." << std::endl;
-        std::string out_deb_name = source_name_ + "_" + version_ + "_amd64.deb";
+        std::string out_deb_name = source_name_ + "_" + version_ + "_" + runepkg_config_native_arch() + ".deb";
         fs::path out_deb_path = working_dir_ / out_deb_name;
 
         if (runepkg_util_create_deb(staging_dir.c_str(), out_deb_path.c_str()) != 0) {
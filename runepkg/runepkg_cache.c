@@ -0,0 +1,242 @@
+/******************************************************************************
+ * Filename:    runepkg_cache.c
+ * Author:      <michkochris@gmail.com>
+ * Date:        started 01-03-2025
+ * Description: Size-bounded download_dir cache with access tracking
+ *
+ * Copyright (c) 2025 runepkg (Runar Linux) All rights reserved.
+ * GPLV3
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <https://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <time.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+#include "runepkg_cache.h"
+#include "runepkg_config.h"
+#include "runepkg_util.h"
+
+typedef struct {
+    char *name;
+    uint64_t size;
+    int64_t last_use;
+    uint32_t uses;
+    bool evicted;
+} CacheEntry;
+
+static bool g_cache_touched = false;
+static int g_hold_fd = -1;  // download_dir, flocked shared by runepkg_cache_hold()
+
+bool runepkg_cache_enabled(void) {
+    return g_download_cache_mb > 0 && g_download_dir && g_runepkg_db_dir;
+}
+
+static char *cache_log_path(void) {
+    return runepkg_util_concat_path(g_runepkg_db_dir, "download_cache.log");
+}
+
+// Length of download_dir without trailing slashes.
+static size_t download_dir_len(void) {
+    size_t len = strlen(g_download_dir);
+    while (len > 1 && g_download_dir[len - 1] == '/') len--;
+    return len;
+}
+
+void runepkg_cache_touch(const char *path) {
+    if (!path || !runepkg_cache_enabled()) return;
+    size_t dir_len = download_dir_len();
+    if (strncmp(path, g_download_dir, dir_len) != 0 || path[dir_len] != '/') return;
+    const char *name = path + dir_len + 1;
+    if (!*name || strchr(name, '/') || strchr(name, '\n')) return;
+
+    char *log_path = cache_log_path();
+    if (!log_path) return;
+    int fd = open(log_path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    free(log_path);
+    if (fd < 0) return;
+    // One write per record, so concurrent appends never interleave.
+    char line[PATH_MAX + 48];
+    int n = snprintf(line, sizeof(line), "%lld 1 %s\n", (long long)time(NULL), name);
+    if (n > 0 && (size_t)n < sizeof(line) && write(fd, line, n) == n) g_cache_touched = true;
+    close(fd);
+}
+
+void runepkg_cache_hold(void) {
+    if (g_hold_fd >= 0 || !runepkg_cache_enabled()) return;
+    int fd = open(g_download_dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return;
+    if (flock(fd, LOCK_SH) != 0) {
+        close(fd);
+        return;
+    }
+    g_hold_fd = fd;
+}
+
+static int cache_entry_name_cmp(const void *a, const void *b) {
+    return strcmp(((const CacheEntry *)a)->name, ((const CacheEntry *)b)->name);
+}
+
+static int64_t cache_entry_priority(const CacheEntry *e) {
+    int doublings = 0;
+    for (uint32_t u = e->uses; u > 1; u >>= 1) doublings++;
+    return e->last_use + (int64_t)RUNEPKG_CACHE_REUSE_CREDIT * doublings;
+}
+
+static int cache_entry_priority_cmp(const void *a, const void *b) {
+    int64_t pa = cache_entry_priority((const CacheEntry *)a), pb = cache_entry_priority((const CacheEntry *)b);
+    return pa < pb ? -1 : pa > pb;
+}
+
+// Folds "<time> <uses> <name>" records from fp into the entries (sorted by name).
+static void cache_fold_log(FILE *fp, CacheEntry *entries, size_t count) {
+    char line[PATH_MAX + 48];
+    while (fgets(line, sizeof(line), fp)) {
+        long long when;
+        unsigned int uses;
+        int name_off = 0;
+        if (sscanf(line, "%lld %u %n", &when, &uses, &name_off) != 2 || name_off == 0) continue;
+        line[strcspn(line, "\n")] = '\0';
+        CacheEntry key = { line + name_off, 0, 0, 0, false };
+        CacheEntry *e = bsearch(&key, entries, count, sizeof(CacheEntry), cache_entry_name_cmp);
+        if (!e || e->evicted) continue;
+        // A download followed by its install is one use, not two.
+        bool first = e->uses == 0;
+        if (first || when >= e->last_use + RUNEPKG_CACHE_SAME_USE) e->uses += uses;
+        if (first || when > e->last_use) e->last_use = when;
+    }
+}
+
+int runepkg_cache_evict(uint64_t budget_bytes, int *removed, uint64_t *freed) {
+    if (removed) *removed = 0;
+    if (freed) *freed = 0;
+    if (!runepkg_cache_enabled()) return 0;
+
+    // The directory lock keeps concurrent evictions (several runepkg processes
+    // finishing at once) from working on the same files, and keeps all of them
+    // off files a running install still needs (see runepkg_cache_hold); losers
+    // just skip.
+    DIR *dir = opendir(g_download_dir);
+    if (!dir) return -1;
+    if (flock(dirfd(dir), LOCK_EX | LOCK_NB) != 0) {
+        closedir(dir);
+        return 0;
+    }
+
+    CacheEntry *entries = NULL;
+    size_t count = 0, cap = 0;
+    uint64_t total = 0;
+    struct dirent *de;
+    while ((de = readdir(dir)) != NULL) {
+        size_t len = strlen(de->d_name);
+        struct stat st;
+        if (len < 5 || strcmp(de->d_name + len - 4, ".deb") != 0) continue;
+        if (fstatat(dirfd(dir), de->d_name, &st, 0) != 0 || !S_ISREG(st.st_mode)) continue;
+        if (count == cap) {
+            size_t new_cap = cap ? cap * 2 : 64;
+            CacheEntry *grown = realloc(entries, new_cap * sizeof(CacheEntry));
+            if (!grown) break;
+            entries = grown;
+            cap = new_cap;
+        }
+        char *name = strdup(de->d_name);
+        if (!name) break;
+        entries[count].name = name;
+        entries[count].size = (uint64_t)st.st_size;
+        entries[count].last_use = (int64_t)st.st_mtime;
+        entries[count].uses = 0;
+        entries[count].evicted = false;
+        total += (uint64_t)st.st_size;
+        count++;
+    }
+    if (count) qsort(entries, count, sizeof(CacheEntry), cache_entry_name_cmp);
+
+    char *log_path = cache_log_path();
+    FILE *log = log_path ? fopen(log_path, "r") : NULL;
+    if (log) cache_fold_log(log, entries, count);
+    for (size_t i = 0; i < count; i++) if (entries[i].uses == 0) entries[i].uses = 1;
+
+    if (total > budget_bytes) {
+        qsort(entries, count, sizeof(CacheEntry), cache_entry_priority_cmp);
+        for (size_t i = 0; i < count && total > budget_bytes; i++) {
+            if (unlinkat(dirfd(dir), entries[i].name, 0) != 0) continue;
+            runepkg_log_verbose("Evicted cached download: %s (%llu bytes)\n", entries[i].name, (unsigned long long)entries[i].size);
+            total -= entries[i].size;
+            if (removed) (*removed)++;
+            if (freed) *freed += entries[i].size;
+            entries[i].evicted = true;
+        }
+        qsort(entries, count, sizeof(CacheEntry), cache_entry_name_cmp);
+    }
+
+    // Rewrite the log with one record per cached file, first folding in any
+    // records appended while this ran so those uses are not lost.
+    if (log_path) {
+        if (log) {
+            clearerr(log);
+            cache_fold_log(log, entries, count);
+        }
+        char tmp_path[PATH_MAX];
+        snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", log_path);
+        FILE *out = fopen(tmp_path, "w");
+        if (out) {
+            for (size_t i = 0; i < count; i++) {
+                if (!entries[i].evicted) fprintf(out, "%lld %u %s\n", (long long)entries[i].last_use, entries[i].uses, entries[i].name);
+            }
+            if (fclose(out) != 0 || rename(tmp_path, log_path) != 0) unlink(tmp_path);
+        }
+    }
+    if (log) fclose(log);
+    free(log_path);
+
+    for (size_t i = 0; i < count; i++) free(entries[i].name);
+    free(entries);
+    closedir(dir); // Releases the lock
+    return 0;
+}
+
+void runepkg_cache_evict_in_background(void) {
+    // The command is done with its files; a held lock would also block the child's own eviction.
+    if (g_hold_fd >= 0) {
+        close(g_hold_fd);
+        g_hold_fd = -1;
+    }
+    if (!g_cache_touched || !runepkg_cache_enabled()) return;
+    g_cache_touched = false;
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    if (pid != 0) {
+        if (pid > 0) runepkg_log_verbose("Trimming download cache to %lu MiB in the background (pid %d)\n", g_download_cache_mb, (int)pid);
+        return;
+    }
+    // Detach from the terminal and from any pipe the caller is read through.
+    setsid();
+    int devnull = open("/dev/null", O_RDWR);
+    if (devnull >= 0) {
+        dup2(devnull, STDIN_FILENO);
+        dup2(devnull, STDOUT_FILENO);
+        dup2(devnull, STDERR_FILENO);
+        if (devnull > STDERR_FILENO) close(devnull);
+    }
+    runepkg_cache_evict((uint64_t)g_download_cache_mb << 20, NULL, NULL);
+    _exit(0);
+}
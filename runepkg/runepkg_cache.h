@@ -0,0 +1,92 @@
+/******************************************************************************
+ * Filename:    runepkg_cache.h
+ * Author:      <michkochris@gmail.com>
+ * Date:        started 01-03-2025
+ * Description: Size-bounded download_dir cache with access tracking
+ *
+ * Copyright (c) 2025 runepkg (Runar Linux) All rights reserved.
+ * GPLV3
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <https://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#ifndef RUNEPKG_CACHE_H
+#define RUNEPKG_CACHE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * With download_cache_mb set, .deb files in download_dir are kept after
+ * install and the directory is held under that budget instead. Every use of a
+ * cached file (downloaded, found already present, installed from) appends
+ * "<time> <uses> <name>" to db/download_cache.log with O_APPEND, so recording
+ * an access is one small write. Eviction folds the log into per-file last-use
+ * times and use counts, rewrites it compacted, and removes files in order of
+ *     last_use + RUNEPKG_CACHE_REUSE_CREDIT * log2(uses)
+ * so a package reused across many installs (kernels, toolchains) outlives a
+ * one-off download fetched a little later. Files with no log entry count as
+ * used once, at their mtime.
+ *
+ * Eviction takes an exclusive flock on download_dir. Runs that download or
+ * install .debs hold a shared one until they finish (runepkg_cache_hold), so
+ * a file fetched by one process is never removed by another's eviction before
+ * it has been installed; such an eviction is skipped and left to a later run.
+ */
+
+#define RUNEPKG_CACHE_REUSE_CREDIT (7 * 24 * 3600) // Seconds of recency per doubling of uses
+#define RUNEPKG_CACHE_SAME_USE 3600                  // Records this close to the last one add no use
+
+/**
+ * @brief True when download_cache_mb is set (cached .debs are kept and evicted by size)
+ */
+bool runepkg_cache_enabled(void);
+
+/**
+ * @brief Records a use of path if it is a file in download_dir
+ */
+void runepkg_cache_touch(const char *path);
+
+/**
+ * @brief Keeps other processes from evicting anything until this one exits
+ *
+ * Takes a shared flock on download_dir, waiting out an eviction already in
+ * progress. Repeated calls are no-ops. Not for long-running servers, whose
+ * own evictions it would block.
+ */
+void runepkg_cache_hold(void);
+
+/**
+ * @brief Evicts cached .debs until download_dir fits in budget_bytes
+ * @param removed Set to the number of files removed (may be NULL)
+ * @param freed Set to the bytes released (may be NULL)
+ * @return 0 on success (including when another process holds the download_dir flock), -1 on error
+ */
+int runepkg_cache_evict(uint64_t budget_bytes, int *removed, uint64_t *freed);
+
+/**
+ * @brief Runs eviction in a detached child if this process touched the cache
+ *
+ * Called once a command has finished so the caller never waits on it.
+ */
+void runepkg_cache_evict_in_background(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RUNEPKG_CACHE_H
@@ -32,6 +32,7 @@
 #include "runepkg_storage.h"
 #include "runepkg_util.h"
 #include "runepkg_handle.h"
+#include "runepkg_cache.h"
 
 #ifdef ENABLE_CPP_FFI
 #include "runepkg_cpp_ffi.h"
@@ -77,8 +78,14 @@ void usage(void) {
     printf("Advanced Repository Management (Network/FFI):\n");
     printf("  update                                  Sync metadata and check for upgradable packages.\n");
     printf("  upgrade                                 Download and install all available upgrades.\n");
-    printf("  search <pkg|pattern>                    Search repositories for packages or patterns.\n");
-    printf("                                          (Use \"quotes\" to search for multiple words).\n");
+    printf("  hold [pkg]                              Keep a package back during upgrade (no argument lists holds).\n");
+    printf("  unhold <pkg>                            Release a held package.\n");
+    printf("  search <pkg|pattern> [--all]            Search repositories, best matches first (top 20 unless --all).\n");
+    printf("                                          (Quote several words to require all of them).\n");
+    printf("  contents <path|file>                    Find repository packages shipping a file (needs fetch_contents).\n");
+    printf("  scan-repo <dir>                         Index the .debs under dir as a local repository (dists/local).\n");
+    printf("  serve [port]                            Share download_dir and lists over HTTP as a LAN mirror (default 3142).\n");
+    printf("  bootstrap <root> <pkg|deb>...           Install packages and their dependencies into an alternate root.\n");
     printf("  source <pkg>                            Download source package files into build_dir.\n");
     printf("  source-depends <pkg>                    Download source package and its runtime-dependencies.\n");
     printf("  source-build-depends <pkg>              Download source package and its build-dependencies.\n");
@@ -92,7 +99,14 @@ void usage(void) {
     printf("      --print-config-file                 Show the path to the runepkgconfig file in use.\n");
     printf("      --print-pkglist-file                Show paths to the autocomplete index files.\n");
     printf("      --print-autopool                    Print the contents of the consolidated autocomplete pool.\n");
-    printf("      --rebuild-autocomplete              Rebuild the local package name index.\n\n");
+    printf("      --rebuild-autocomplete              Rebuild the local package name index.\n");
+    printf("      --bench-prefix [lookups]            Benchmark prefix index search (binary search vs search tree).\n");
+    printf("  db export <file> [--files]              Write all package records to one checksummed snapshot ('-' = stdout).\n");
+    printf("  db import <file> [-f]                   Restore records from a snapshot and rebuild the indexes (-f replaces).\n");
+    printf("  db list <file>                          Print the name=version list recorded in a snapshot.\n");
+    printf("  db diff <a> <b|live> [--files]          Show packages added, removed or changed from a to b (exits 1 on drift).\n");
+    printf("  rollback [id]                           Undo the last install, upgrade or remove (with id: every run back to it).\n");
+    printf("  rollback list                           Show the transactions kept for rollback (see keep_transactions).\n\n");
 
     printf("Experimental/Future:\n");
     printf("  depends <pkg>                           Placeholder: Graphical dependency visualizer.\n");
@@ -433,22 +447,165 @@ int main(int argc, char *argv[]) {
             handle_print_autopool();
         } else if (strcmp(argv[i], "--rebuild-autocomplete") == 0) {
             handle_update_pkglist();
+        } else if (strcmp(argv[i], "--bench-prefix") == 0) {
+            int lookups = 0;
+            if (i + 1 < argc && argv[i+1][0] != '-') {
+                lookups = atoi(argv[i+1]);
+                i++;
+            }
+            if (runepkg_completion_bench_prefix(lookups) != 0) cli_failed = 1;
         } else if (strcmp(argv[i], "--print-config-file") == 0) {
             handle_print_config_file();
         } else if (strcmp(argv[i], "--print-pkglist-file") == 0) {
             handle_print_pkglist_file();
         } else if (strcmp(argv[i], "search") == 0) {
             if (i + 1 < argc && argv[i+1][0] != '-') {
+                const char *pattern = argv[i+1];
+                bool show_all = false;
+                i++;
+                if (i + 1 < argc && strcmp(argv[i+1], "--all") == 0) {
+                    show_all = true;
+                    i++;
+                }
 #ifdef ENABLE_CPP_FFI
-                runepkg_repo_search(argv[i+1]);
+                if (runepkg_repo_search(pattern, show_all) < 0) cli_failed = 1;
 #else
+                (void)pattern;
+                (void)show_all;
                 printf("Notice: Repository search requires a C++ build with networking enabled.\n");
                 printf("Rebuild with 'make all' to enable this feature.\n");
 #endif
-                i++;
             } else {
                 printf("Error: Search command requires a pattern (e.g., 'runepkg search <pattern>').\n");
             }
+        } else if (strcmp(argv[i], "contents") == 0) {
+            if (i + 1 < argc && argv[i+1][0] != '-') {
+#ifdef ENABLE_CPP_FFI
+                if (runepkg_repo_contents_search(argv[i+1]) < 0) {
+                    cli_failed = 1;
+                }
+#else
+                printf("Notice: Repository contents lookup requires a C++ build with networking enabled.\n");
+                printf("Rebuild with 'make all' to enable this feature.\n");
+#endif
+                i++;
+            } else {
+                printf("Error: contents command requires a file path (e.g., 'runepkg contents /usr/bin/ls').\n");
+            }
+        } else if (strcmp(argv[i], "scan-repo") == 0) {
+            if (i + 1 < argc && argv[i+1][0] != '-') {
+#ifdef ENABLE_CPP_FFI
+                if (runepkg_repo_scan(argv[i+1]) < 0) {
+                    cli_failed = 1;
+                }
+#else
+                printf("Notice: Repository scanning requires a C++ build with networking enabled.\n");
+                printf("Rebuild with 'make all' to enable this feature.\n");
+#endif
+                i++;
+            } else {
+                printf("Error: scan-repo command requires a directory (e.g., 'runepkg scan-repo ~/runepkg_dir/debs').\n");
+            }
+        } else if (strcmp(argv[i], "serve") == 0) {
+            int port = 0;
+            if (i + 1 < argc && argv[i+1][0] != '-') {
+                port = atoi(argv[i+1]);
+                i++;
+                if (port <= 0 || port > 65535) {
+                    printf("Error: serve port must be between 1 and 65535.\n");
+                    cli_failed = 1;
+                    continue;
+                }
+            }
+#ifdef ENABLE_CPP_FFI
+            if (runepkg_serve(port) < 0) {
+                cli_failed = 1;
+            }
+#else
+            (void)port;
+            printf("Notice: Serving a package cache requires a C++ build with networking enabled.\n");
+            printf("Rebuild with 'make all' to enable this feature.\n");
+#endif
+        } else if (strcmp(argv[i], "db") == 0) {
+            if (i + 2 < argc && argv[i+1][0] != '-' && (argv[i+2][0] != '-' || strcmp(argv[i+2], "-") == 0)) {
+                const char *action = argv[i+1];
+                const char *file = argv[i+2];
+                i += 2;
+                if (strcmp(action, "diff") == 0) {
+                    if (i + 1 < argc && (argv[i+1][0] != '-' || strcmp(argv[i+1], "-") == 0)) {
+                        const char *other = argv[++i];
+                        bool compare_files = false;
+                        if (i + 1 < argc && strcmp(argv[i+1], "--files") == 0) {
+                            compare_files = true;
+                            i++;
+                        }
+                        if (handle_db_diff(file, other, compare_files) != 0) cli_failed = 1;
+                    } else {
+                        printf("Error: db diff requires two snapshots (e.g., 'runepkg db diff golden.snap live').\n");
+                        cli_failed = 1;
+                    }
+                    continue;
+                }
+                bool hash_files = false;
+                while (i + 1 < argc) {
+                    if (strcmp(argv[i+1], "-f") == 0 || strcmp(argv[i+1], "--force") == 0) {
+                        g_force_mode = true;
+                    } else if (strcmp(argv[i+1], "--files") == 0) {
+                        hash_files = true;
+                    } else {
+                        break;
+                    }
+                    i++;
+                }
+                if (handle_db(action, file, hash_files) != 0) cli_failed = 1;
+            } else {
+                printf("Error: db command requires an action and a snapshot file (e.g., 'runepkg db export state.snap').\n");
+                if (i + 1 < argc && argv[i+1][0] != '-') i++;
+                cli_failed = 1;
+            }
+        } else if (strcmp(argv[i], "rollback") == 0) {
+            const char *id = NULL;
+            if (i + 1 < argc && argv[i+1][0] != '-') id = argv[++i];
+            if (handle_rollback(id) != 0) cli_failed = 1;
+        } else if (strcmp(argv[i], "bootstrap") == 0) {
+            if (i + 2 < argc && argv[i+1][0] != '-' && argv[i+2][0] != '-') {
+                const char *root = argv[i+1];
+                const char **names = malloc((size_t)argc * sizeof(char*));
+                int name_count = 0;
+                i++;
+                while (names && i + 1 < argc) {
+                    if (strcmp(argv[i+1], "-f") == 0 || strcmp(argv[i+1], "--force") == 0) {
+                        g_force_mode = true;
+                    } else if (argv[i+1][0] == '-') {
+                        break;
+                    } else {
+                        names[name_count++] = argv[i+1];
+                    }
+                    i++;
+                }
+#ifdef ENABLE_CPP_FFI
+                char **debs = names ? runepkg_repo_fetch_closure(names, name_count) : NULL;
+                if (debs) {
+                    int count = 0;
+                    while (debs[count]) count++;
+                    if (runepkg_install_bootstrap(root, debs, count) != 0) cli_failed = 1;
+                    for (int k = 0; k < count; k++) free(debs[k]);
+                    free(debs);
+                } else {
+                    cli_failed = 1;
+                }
+#else
+                (void)root;
+                (void)name_count;
+                printf("Notice: Bootstrapping a root requires a C++ build with networking enabled.\n");
+                printf("Rebuild with 'make all' to enable this feature.\n");
+#endif
+                free(names);
+            } else {
+                printf("Error: bootstrap command requires a root directory and packages (e.g., 'runepkg bootstrap /mnt/runar base-files busybox').\n");
+                if (i + 1 < argc && argv[i+1][0] != '-') i++;
+                cli_failed = 1;
+            }
         } else if (strcmp(argv[i], "-b") == 0 || strcmp(argv[i], "--build") == 0) {
             const char *src = NULL;
             const char *out = NULL;
@@ -551,6 +708,20 @@ int main(int argc, char *argv[]) {
             printf("Notice: Automatic upgrades require a C++ build with networking enabled.\n");
             printf("Rebuild with 'make all' to enable this feature.\n");
 #endif
+        } else if (strcmp(argv[i], "hold") == 0) {
+            if (i + 1 < argc && argv[i+1][0] != '-') {
+                if (handle_hold(argv[i+1], true) != 0) cli_failed = 1;
+                i++;
+            } else {
+                handle_hold(NULL, true);
+            }
+        } else if (strcmp(argv[i], "unhold") == 0) {
+            if (i + 1 < argc && argv[i+1][0] != '-') {
+                if (handle_hold(argv[i+1], false) != 0) cli_failed = 1;
+                i++;
+            } else {
+                printf("Error: unhold command requires a package name.\n");
+            }
         } else if (strcmp(argv[i], "source") == 0) {
             if (i + 1 < argc && argv[i+1][0] != '-') {
 #ifdef ENABLE_CPP_FFI
@@ -618,6 +789,7 @@ int main(int argc, char *argv[]) {
     }
 
     // handle_update_pkglist();  // Removed to avoid excessive updates
+    runepkg_cache_evict_in_background();
     runepkg_cleanup();
     return cli_failed ? EXIT_FAILURE : EXIT_SUCCESS;
 }
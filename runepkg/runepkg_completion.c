@@ -14,12 +14,15 @@
 #include <sys/statvfs.h>
 #include <errno.h>
 #include <ctype.h>
+#include <time.h>
 
 #include "runepkg_completion.h"
 #include "runepkg_handle.h"
 #include "runepkg_storage.h"
 #include "runepkg_config.h"
 #include "runepkg_util.h"
+#include "runepkg_stree.h"
+#include "runepkg_repo_index.h"
 
 int is_completion_trigger(char *argv[]) {
     (void)argv; /* suppressed unused warning; argc check is done by caller */
@@ -274,6 +277,53 @@ static void check_rebuild_autocomplete_index(void) {
     }
 }
 
+/* A mapped, sorted name index: either the autocomplete pool (offsets into a
+ * string blob) or a repo index (fixed-size entries), plus its search tree when
+ * one was written for exactly this index. */
+typedef struct {
+    const uint32_t *offsets;
+    const char *names;
+    const RepoIndexEntry *entries;
+    uint32_t count;
+    RunepkgSTree tree;
+    bool has_tree;
+} NameIndexView;
+
+static const char *name_index_at(const void *ctx, uint32_t i) {
+    const NameIndexView *view = (const NameIndexView *)ctx;
+    return view->entries ? view->entries[i].name : view->names + view->offsets[i];
+}
+
+static void name_index_open_tree(NameIndexView *view, const char *index_path, uint64_t index_size) {
+    char tree_path[PATH_MAX];
+    size_t len = strlen(index_path);
+    if (len < 4 || len + 2 >= sizeof(tree_path) || strcmp(index_path + len - 4, ".bin") != 0) return;
+    snprintf(tree_path, sizeof(tree_path), "%.*s.stree", (int)(len - 4), index_path);
+    view->has_tree = runepkg_stree_open(&view->tree, tree_path, view->count, index_size) == 0;
+}
+
+static void name_index_close_tree(NameIndexView *view) {
+    if (view->has_tree) runepkg_stree_close(&view->tree);
+    view->has_tree = false;
+}
+
+/* Plain binary search over the sorted names; the fallback when there is no tree. */
+static uint32_t name_index_lower_bound_binary(const NameIndexView *view, const char *query) {
+    uint32_t low = 0, high = view->count;
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        if (strcmp(name_index_at(view, mid), query) < 0) low = mid + 1;
+        else high = mid;
+    }
+    return low;
+}
+
+/* First position whose name is >= query. */
+static uint32_t name_index_lower_bound(const NameIndexView *view, const char *query) {
+    if (view->has_tree) return runepkg_stree_lower_bound(&view->tree, query, name_index_at, view);
+    return name_index_lower_bound_binary(view, query);
+}
+
 /* Search the binary autocomplete index for prefix matches and print them. */
 int prefix_search_and_print_ext(const char *prefix, const char *suffix_filter) {
     char index_path[PATH_MAX];
@@ -297,25 +347,11 @@ int prefix_search_and_print_ext(const char *prefix, const char *suffix_filter) {
     uint32_t *offsets = (uint32_t *)((char *)mapped + sizeof(AutocompleteHeader));
     char *names = (char *)mapped + sizeof(AutocompleteHeader) + hdr->entry_count * sizeof(uint32_t);
 
-    int low = 0, high = hdr->entry_count - 1;
+    NameIndexView view = { offsets, names, NULL, hdr->entry_count, {0}, false };
+    name_index_open_tree(&view, index_path, st.st_size);
+    uint32_t first = name_index_lower_bound(&view, prefix);
     int first_match = -1;
-    while (low <= high) {
-        int mid = low + (high - low) / 2;
-        char *current_name = names + offsets[mid];
-        int cmp = strcmp(prefix, current_name);
-        if (cmp == 0) {
-            first_match = mid; high = mid - 1;
-        } else if (cmp < 0) {
-            high = mid - 1;
-        } else {
-            low = mid + 1;
-        }
-    }
-
-    if (first_match == -1 && low < (int)hdr->entry_count) {
-        char *name = names + offsets[low];
-        if (strncmp(prefix, name, strlen(prefix)) == 0) first_match = low;
-    }
+    if (first < view.count && strncmp(prefix, names + offsets[first], strlen(prefix)) == 0) first_match = (int)first;
 
     int found = 0;
     char last_printed[PATH_MAX] = {0};
@@ -400,6 +436,7 @@ int prefix_search_and_print_ext(const char *prefix, const char *suffix_filter) {
         }
     }
 
+    name_index_close_tree(&view);
     munmap(mapped, st.st_size);
     close(fd);
     return found;
@@ -409,12 +446,6 @@ int prefix_search_and_print(const char *prefix) {
     return prefix_search_and_print_ext(prefix, NULL);
 }
 
-struct RepoIndexEntry {
-    char name[64];
-    uint32_t file_id;
-    uint32_t offset;
-};
-
 int repo_generic_prefix_search(const char *prefix, const char *index_filename) {
     char index_path[PATH_MAX];
     if (!g_runepkg_db_dir) return 0;
@@ -425,30 +456,21 @@ int repo_generic_prefix_search(const char *prefix, const char *index_filename) {
 
     struct stat st;
     if (fstat(fd, &st) < 0) { close(fd); return 0; }
-    if (st.st_size < (off_t)sizeof(uint32_t)) { close(fd); return 0; }
+    if (st.st_size < (off_t)sizeof(RepoIndexHeader)) { close(fd); return 0; }
 
     void *mapped = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
     if (mapped == MAP_FAILED) { close(fd); return 0; }
 
-    uint32_t count = *(uint32_t *)mapped;
-    struct RepoIndexEntry *entries = (struct RepoIndexEntry *)((char *)mapped + sizeof(uint32_t));
+    uint32_t count;
+    const RepoIndexEntry *entries = runepkg_repo_index_entries(mapped, st.st_size, &count);
+    if (!entries) { munmap(mapped, st.st_size); close(fd); return 0; }
 
-    int low = 0, high = (int)count - 1;
-    int first_match = -1;
+    NameIndexView view = { NULL, NULL, entries, count, {0}, false };
+    name_index_open_tree(&view, index_path, st.st_size);
     size_t prefix_len = strlen(prefix);
-
-    while (low <= high) {
-        int mid = low + (high - low) / 2;
-        int cmp = strncmp(prefix, entries[mid].name, prefix_len);
-        if (cmp == 0) {
-            first_match = mid;
-            high = mid - 1;
-        } else if (cmp < 0) {
-            high = mid - 1;
-        } else {
-            low = mid + 1;
-        }
-    }
+    uint32_t first = name_index_lower_bound(&view, prefix);
+    int first_match = -1;
+    if (first < count && strncmp(prefix, entries[first].name, prefix_len) == 0) first_match = (int)first;
 
     if (first_match != -1) {
         char last_printed[64] = {0};
@@ -461,11 +483,34 @@ int repo_generic_prefix_search(const char *prefix, const char *index_filename) {
         }
     }
 
+    name_index_close_tree(&view);
     munmap(mapped, st.st_size);
     close(fd);
     return (first_match != -1) ? 1 : 0;
 }
 
+/* Rows of repo_index.archs: 0 is the native architecture, 1 "all", then the foreign ones. */
+#define SUGGEST_MAX_ARCHS 16
+static int load_index_archs(char archs[][32]) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/repo_index.archs", g_runepkg_db_dir);
+    FILE *fp = fopen(path, "r");
+    int n = 0;
+    while (fp && n < SUGGEST_MAX_ARCHS && fgets(archs[n], 32, fp)) {
+        archs[n][strcspn(archs[n], "\r\n")] = '\0';
+        n++;
+    }
+    if (fp) fclose(fp);
+    return n;
+}
+
+/* A name's first row has its lowest arch row; a foreign one means the plain
+ * name does not install, so suggest it qualified. */
+static void copy_suggestion(char *out, const RepoIndexEntry *e, char archs[][32], int arch_count) {
+    if (e->arch > 1 && e->arch < arch_count) snprintf(out, PATH_MAX, "%.*s:%s", (int)sizeof(e->name), e->name, archs[e->arch]);
+    else snprintf(out, PATH_MAX, "%.*s", (int)sizeof(e->name), e->name);
+}
+
 int runepkg_completion_get_repo_suggestions(const char *search_name, char suggestions[][PATH_MAX], int max_suggestions) {
     if (!search_name || !suggestions || max_suggestions <= 0 || !g_runepkg_db_dir) return 0;
 
@@ -477,26 +522,31 @@ int runepkg_completion_get_repo_suggestions(const char *search_name, char sugges
 
     struct stat st;
     if (fstat(fd, &st) < 0) { close(fd); return 0; }
-    if (st.st_size < (off_t)sizeof(uint32_t)) { close(fd); return 0; }
+    if (st.st_size < (off_t)sizeof(RepoIndexHeader)) { close(fd); return 0; }
 
     void *mapped = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
     if (mapped == MAP_FAILED) { close(fd); return 0; }
 
-    uint32_t count = *(uint32_t *)mapped;
-    struct RepoIndexEntry *entries = (struct RepoIndexEntry *)((char *)mapped + sizeof(uint32_t));
+    uint32_t count;
+    const RepoIndexEntry *entries = runepkg_repo_index_entries(mapped, st.st_size, &count);
 
     int found = 0;
     char last_added[64] = {0};
-
-    /* Pass 1: Prefix matches (higher relevance) */
-    for (uint32_t i = 0; i < count && found < max_suggestions; i++) {
-        if (strncmp(entries[i].name, search_name, strlen(search_name)) == 0) {
-            if (strcmp(last_added, entries[i].name) != 0) {
-                strncpy(suggestions[found], entries[i].name, PATH_MAX - 1);
-                suggestions[found][PATH_MAX - 1] = '\0';
-                strncpy(last_added, entries[i].name, sizeof(last_added) - 1);
-                found++;
-            }
+    if (!entries) { munmap(mapped, st.st_size); close(fd); return 0; }
+    char archs[SUGGEST_MAX_ARCHS][32];
+    int arch_count = load_index_archs(archs);
+
+    /* Pass 1: Prefix matches (higher relevance), a contiguous run starting at the lower bound */
+    NameIndexView view = { NULL, NULL, entries, count, {0}, false };
+    name_index_open_tree(&view, index_path, st.st_size);
+    uint32_t first = name_index_lower_bound(&view, search_name);
+    name_index_close_tree(&view);
+    for (uint32_t i = first; i < count && found < max_suggestions; i++) {
+        if (strncmp(entries[i].name, search_name, strlen(search_name)) != 0) break;
+        if (strcmp(last_added, entries[i].name) != 0) {
+            copy_suggestion(suggestions[found], &entries[i], archs, arch_count);
+            strncpy(last_added, entries[i].name, sizeof(last_added) - 1);
+            found++;
         }
     }
 
@@ -515,8 +565,8 @@ int runepkg_completion_get_repo_suggestions(const char *search_name, char sugges
                     }
                     if (already) continue;
 
-                    strncpy(suggestions[found], entries[i].name, PATH_MAX - 1);
-                    suggestions[found][PATH_MAX - 1] = '\0';
+                    copy_suggestion(suggestions[found], &entries[i], archs, arch_count);
+                    strncpy(last_added, entries[i].name, sizeof(last_added) - 1);
                     found++;
                 }
             }
@@ -536,6 +586,91 @@ int repo_src_prefix_search_and_print(const char *prefix) {
     return repo_generic_prefix_search(prefix, "repo_src_index.bin");
 }
 
+static uint64_t bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* Times lower-bound lookups on one index with plain binary search and with its
+ * search tree, using the same query mix: prefixes of real names plus near misses. */
+static void bench_prefix_index(const char *index_filename, bool is_pool, int queries) {
+    char index_path[PATH_MAX];
+    snprintf(index_path, sizeof(index_path), "%s/%s", g_runepkg_db_dir, index_filename);
+    int fd = open(index_path, O_RDONLY);
+    if (fd < 0) { printf("  %-26s not found, skipped\n", index_filename); return; }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(uint32_t)) { close(fd); return; }
+    void *mapped = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) return;
+
+    NameIndexView view = { NULL, NULL, NULL, 0, {0}, false };
+    if (is_pool && (size_t)st.st_size >= sizeof(AutocompleteHeader)) {
+        AutocompleteHeader *hdr = (AutocompleteHeader *)mapped;
+        view.offsets = (const uint32_t *)((char *)mapped + sizeof(AutocompleteHeader));
+        view.names = (const char *)mapped + sizeof(AutocompleteHeader) + hdr->entry_count * sizeof(uint32_t);
+        view.count = hdr->magic == 0x52554E45 ? hdr->entry_count : 0;
+    } else if (!is_pool) {
+        view.entries = runepkg_repo_index_entries(mapped, st.st_size, &view.count);
+    }
+    name_index_open_tree(&view, index_path, st.st_size);
+    if (view.count == 0 || !view.has_tree) {
+        printf("  %-26s %s, skipped\n", index_filename, view.count ? "no search tree (rebuild the index)" : "empty");
+        name_index_close_tree(&view);
+        munmap(mapped, st.st_size);
+        return;
+    }
+
+    char (*query)[64] = malloc((size_t)queries * sizeof(*query));
+    uint32_t *expected = malloc((size_t)queries * sizeof(uint32_t));
+    if (!query || !expected) { free(query); free(expected); name_index_close_tree(&view); munmap(mapped, st.st_size); return; }
+    uint64_t rng = 0x9E3779B97F4A7C15ull;
+    for (int q = 0; q < queries; q++) {
+        rng ^= rng << 13; rng ^= rng >> 7; rng ^= rng << 17;
+        const char *name = name_index_at(&view, (uint32_t)(rng % view.count));
+        size_t len = strnlen(name, sizeof(query[q]) - 2);
+        size_t cut = len ? 1 + (size_t)((rng >> 32) % len) : 0;
+        memcpy(query[q], name, cut);
+        if ((q & 3) == 3) query[q][cut++] = (char)('a' + (rng >> 40) % 26); /* near miss */
+        query[q][cut] = '\0';
+    }
+
+    uint64_t sink = 0, t0 = bench_now_ns();
+    for (int q = 0; q < queries; q++) sink += expected[q] = name_index_lower_bound_binary(&view, query[q]);
+    uint64_t t1 = bench_now_ns();
+    int mismatches = 0;
+    for (int q = 0; q < queries; q++) {
+        uint32_t pos = runepkg_stree_lower_bound(&view.tree, query[q], name_index_at, &view);
+        sink += pos;
+        mismatches += pos != expected[q];
+    }
+    uint64_t t2 = bench_now_ns();
+
+    double binary_ns = (double)(t1 - t0) / queries, tree_ns = (double)(t2 - t1) / queries;
+    printf("  %-26s %8u names  binary search %7.1f ns  search tree %7.1f ns  (%.2fx)%s\n",
+           index_filename, view.count, binary_ns, tree_ns, tree_ns > 0 ? binary_ns / tree_ns : 0.0,
+           mismatches ? "  MISMATCH" : "");
+    if (mismatches) printf("    %d of %d lookups disagreed with binary search\n", mismatches, queries);
+    runepkg_log_verbose("bench checksum %llu\n", (unsigned long long)sink);
+
+    free(query);
+    free(expected);
+    name_index_close_tree(&view);
+    munmap(mapped, st.st_size);
+}
+
+int runepkg_completion_bench_prefix(int queries) {
+    if (!g_runepkg_db_dir) return -1;
+    if (queries <= 0) queries = 200000;
+    check_rebuild_autocomplete_index();
+    printf("Prefix index lower-bound benchmark: %d lookups per index (warm page cache)\n", queries);
+    bench_prefix_index("runepkg_autocomplete.bin", true, queries);
+    bench_prefix_index("repo_index.bin", false, queries);
+    bench_prefix_index("repo_src_index.bin", false, queries);
+    return 0;
+}
+
 void handle_binary_completion(const char *partial, const char *prev) {
     const char *comp_line = getenv("COMP_LINE");
     const char *comp_point_s = getenv("COMP_POINT");
@@ -735,8 +870,8 @@ void handle_binary_completion(const char *partial, const char *prev) {
             }
         } else {
             const char *sub_cmds[] = {
-                "install", "remove", "list", "status", "list-files", "search",
-                "download-only", "download-depends", "download-build-depends", "depends", "verify", "update", "upgrade", "source", "source-depends", "source-build-depends", "source-build"
+                "install", "remove", "list", "status", "list-files", "search", "contents",
+                "download-only", "download-depends", "download-build-depends", "depends", "verify", "update", "upgrade", "hold", "unhold", "source", "source-depends", "source-build-depends", "source-build"
             };
             int num_sub = sizeof(sub_cmds) / sizeof(sub_cmds[0]);
             for (int i = 0; i < num_sub; i++) {
@@ -772,6 +907,8 @@ void handle_binary_completion(const char *partial, const char *prev) {
         complete_file_paths_ext(partial, g_download_dir, ".deb");
     } else if (strcmp(prev, "remove") == 0 || strcmp(prev, "-r") == 0) {
         prefix_search_and_print_ext(partial, ":pkg");
+    } else if (strcmp(prev, "hold") == 0 || strcmp(prev, "unhold") == 0) {
+        prefix_search_and_print_ext(partial, ":pkg");
     } else if (strcmp(prev, "list") == 0 || strcmp(prev, "-l") == 0 || strcmp(prev, "-L") == 0) {
         prefix_search_and_print_ext(partial, ":pkg");
     } else if (strcmp(prev, "status") == 0 || strcmp(prev, "-s") == 0) {
@@ -23,6 +23,8 @@
 #include <ctype.h>
 #include <stdbool.h>
 #include <libgen.h>
+#include <fnmatch.h>
+#include <sys/utsname.h>
 
 #include "runepkg_util.h"
 
@@ -47,10 +49,23 @@ char *g_download_dir = NULL;
 char *g_build_dir = NULL;
 char *g_debs_dir = NULL;
 bool g_md5_checks = true;
+bool g_fetch_contents = false;
+unsigned long g_update_memory_mb = 0;
+unsigned long g_download_cache_mb = 0;
+char *g_package_store = NULL;
+bool g_store_hardlink = false;
+unsigned long g_keep_transactions = 3;
+char *g_transaction_dir = NULL;
+char **g_architectures = NULL;
+int g_architectures_count = 0;
 
 RuneSource **g_sources = NULL;
 int g_sources_count = 0;
 
+RunePathFilter *g_path_filters = NULL;
+int g_path_filters_count = 0;
+static char **g_tar_excludes = NULL;
+
 bool g_cleanup_extract_dirs = true;
 
 // --- External Global Variables ---
@@ -65,6 +80,59 @@ void runepkg_config_load_sources(const char *filepath);
 
 // --- Internal Configuration System Functions ---
 
+// Debian name of the machine runepkg runs on (uname -m), amd64 if unknown.
+static const char *detect_native_arch(void) {
+    static const struct { const char *machine, *arch; } map[] = {
+        {"x86_64", "amd64"}, {"aarch64", "arm64"}, {"i686", "i386"}, {"i586", "i386"},
+        {"i386", "i386"}, {"armv7l", "armhf"}, {"armv6l", "armel"}, {"ppc64le", "ppc64el"},
+        {"riscv64", "riscv64"}, {"s390x", "s390x"}, {"mips64", "mips64el"}, {"loongarch64", "loong64"},
+    };
+    struct utsname u;
+    if (uname(&u) == 0) {
+        for (size_t i = 0; i < sizeof(map) / sizeof(map[0]); i++) {
+            if (strcmp(u.machine, map[i].machine) == 0) return map[i].arch;
+        }
+    }
+    return "amd64";
+}
+
+static void free_architectures(void) {
+    for (int i = 0; i < g_architectures_count; i++) {
+        free(g_architectures[i]);
+    }
+    free(g_architectures);
+    g_architectures = NULL;
+    g_architectures_count = 0;
+}
+
+// Parses a space/comma separated architectures= value, dropping duplicates.
+// Without a usable native entry the running machine's is put first.
+static void set_architectures(const char *list) {
+    free_architectures();
+    char *copy = list ? strdup(list) : NULL;
+    char *save = NULL;
+    bool have_native = false;
+    for (char *tok = copy ? strtok_r(copy, " ,\t", &save) : NULL; tok; tok = strtok_r(NULL, " ,\t", &save)) {
+        bool dup = false;
+        for (int i = 0; i < g_architectures_count && !dup; i++) dup = strcmp(g_architectures[i], tok) == 0;
+        if (dup) continue;
+        char **grown = realloc(g_architectures, sizeof(char *) * (g_architectures_count + 2));
+        if (!grown) break;
+        g_architectures = grown;
+        g_architectures[g_architectures_count++] = strdup(tok);
+        if (strcmp(tok, "all") != 0) have_native = true;
+    }
+    free(copy);
+    if (!have_native) {
+        char **grown = realloc(g_architectures, sizeof(char *) * (g_architectures_count + 1));
+        if (!grown) return;
+        g_architectures = grown;
+        memmove(g_architectures + 1, g_architectures, sizeof(char *) * g_architectures_count);
+        g_architectures[0] = strdup(detect_native_arch());
+        g_architectures_count++;
+    }
+}
+
 // --- Helper function to find the correct configuration file path ---
 char *runepkg_get_config_file_path() {
     char *config_file_path = NULL;
@@ -178,6 +246,12 @@ int runepkg_config_load() {
         }
         g_md5_checks = true;
         g_cleanup_extract_dirs = true;
+        g_fetch_contents = false;
+        g_update_memory_mb = 0;
+        g_download_cache_mb = 0;
+        g_store_hardlink = false;
+        g_keep_transactions = 3;
+        set_architectures(NULL);
         /* Directories will be created by runepkg_init_paths() later.
          * Avoid creating them here to prevent duplicate verbose/debug logs. */
     } else {
@@ -302,6 +376,39 @@ int runepkg_config_load() {
         char *md5_checks_val = runepkg_util_get_config_value(config_file_path, "md5_checks", '=');
         g_md5_checks = runepkg_util_parse_yes_no(md5_checks_val, true);
         free(md5_checks_val);
+
+        char *contents_val = runepkg_util_get_config_value(config_file_path, "fetch_contents", '=');
+        g_fetch_contents = runepkg_util_parse_yes_no(contents_val, false);
+        free(contents_val);
+
+        char *memory_val = runepkg_util_get_config_value(config_file_path, "update_memory_mb", '=');
+        g_update_memory_mb = memory_val ? strtoul(memory_val, NULL, 10) : 0;
+        free(memory_val);
+
+        char *cache_val = runepkg_util_get_config_value(config_file_path, "download_cache_mb", '=');
+        g_download_cache_mb = cache_val ? strtoul(cache_val, NULL, 10) : 0;
+        free(cache_val);
+
+        g_package_store = runepkg_util_get_config_value(config_file_path, "package_store", '=');
+        if (g_package_store && !*g_package_store) runepkg_util_free_and_null(&g_package_store);
+
+        char *link_val = runepkg_util_get_config_value(config_file_path, "store_link_mode", '=');
+        g_store_hardlink = link_val && strcmp(link_val, "hardlink") == 0;
+        if (link_val && !g_store_hardlink && strcmp(link_val, "reflink") != 0) {
+            fprintf(stderr, "Warning: Unknown store_link_mode '%s' in config; using reflink.\n", link_val);
+        }
+        free(link_val);
+
+        char *keep_val = runepkg_util_get_config_value(config_file_path, "keep_transactions", '=');
+        g_keep_transactions = keep_val ? strtoul(keep_val, NULL, 10) : 3;
+        free(keep_val);
+
+        g_transaction_dir = runepkg_util_get_config_value(config_file_path, "transaction_dir", '=');
+        if (g_transaction_dir && !*g_transaction_dir) runepkg_util_free_and_null(&g_transaction_dir);
+
+        char *arch_val = runepkg_util_get_config_value(config_file_path, "architectures", '=');
+        set_architectures(arch_val);
+        free(arch_val);
     }
 
     /* Concise summary for verbose mode: one-line summary instead of
@@ -309,22 +416,40 @@ int runepkg_config_load() {
      * still enables internal verbose logs elsewhere. */
     if (g_verbose_mode) {
         if (config_file_path) {
-            runepkg_log_verbose("Configuration loaded from %s; base=%s, control=%s, db=%s, install=%s cleanup=%s md5_checks=%s\n",
+            runepkg_log_verbose("Configuration loaded from %s; base=%s, control=%s, db=%s, install=%s cleanup=%s md5_checks=%s fetch_contents=%s update_memory_mb=%lu download_cache_mb=%lu package_store=%s (%s) path_filters=%d keep_transactions=%lu native_arch=%s architectures=%d\n",
                                config_file_path,
                                g_runepkg_base_dir ? g_runepkg_base_dir : "(null)",
                                g_control_dir ? g_control_dir : "(null)",
                                g_runepkg_db_dir ? g_runepkg_db_dir : "(null)",
                                g_install_dir_internal ? g_install_dir_internal : "(null)",
                                g_cleanup_extract_dirs ? "yes" : "no",
-                               g_md5_checks ? "yes" : "no");
+                               g_md5_checks ? "yes" : "no",
+                               g_fetch_contents ? "yes" : "no",
+                               g_update_memory_mb,
+                               g_download_cache_mb,
+                               g_package_store ? g_package_store : "(off)",
+                               g_store_hardlink ? "hardlink" : "reflink",
+                               g_path_filters_count,
+                               g_keep_transactions,
+                               runepkg_config_native_arch(),
+                               g_architectures_count);
         } else {
-            runepkg_log_verbose("Configuration loaded using defaults; base=%s, control=%s, db=%s, install=%s cleanup=%s md5_checks=%s\n",
+            runepkg_log_verbose("Configuration loaded using defaults; base=%s, control=%s, db=%s, install=%s cleanup=%s md5_checks=%s fetch_contents=%s update_memory_mb=%lu download_cache_mb=%lu package_store=%s (%s) path_filters=%d keep_transactions=%lu native_arch=%s architectures=%d\n",
                                g_runepkg_base_dir ? g_runepkg_base_dir : "(null)",
                                g_control_dir ? g_control_dir : "(null)",
                                g_runepkg_db_dir ? g_runepkg_db_dir : "(null)",
                                g_install_dir_internal ? g_install_dir_internal : "(null)",
                                g_cleanup_extract_dirs ? "yes" : "no",
-                               g_md5_checks ? "yes" : "no");
+                               g_md5_checks ? "yes" : "no",
+                               g_fetch_contents ? "yes" : "no",
+                               g_update_memory_mb,
+                               g_download_cache_mb,
+                               g_package_store ? g_package_store : "(off)",
+                               g_store_hardlink ? "hardlink" : "reflink",
+                               g_path_filters_count,
+                               g_keep_transactions,
+                               runepkg_config_native_arch(),
+                               g_architectures_count);
         }
         runepkg_log_verbose("Autocomplete files: txt=%s bin=%s\n",
                            g_pkglist_txt_path ? g_pkglist_txt_path : "(null)",
@@ -349,6 +474,9 @@ void runepkg_config_cleanup() {
     runepkg_util_free_and_null(&g_download_dir);
     runepkg_util_free_and_null(&g_build_dir);
     runepkg_util_free_and_null(&g_debs_dir);
+    runepkg_util_free_and_null(&g_package_store);
+    runepkg_util_free_and_null(&g_transaction_dir);
+    free_architectures();
 
     if (g_sources) {
         for (int i = 0; i < g_sources_count; i++) {
@@ -364,6 +492,51 @@ void runepkg_config_cleanup() {
         g_sources = NULL;
         g_sources_count = 0;
     }
+
+    for (int i = 0; i < g_path_filters_count; i++) {
+        free(g_path_filters[i].pattern);
+    }
+    free(g_path_filters);
+    g_path_filters = NULL;
+    g_path_filters_count = 0;
+
+    if (g_tar_excludes) {
+        for (char **p = g_tar_excludes; *p; p++) free(*p);
+        free(g_tar_excludes);
+        g_tar_excludes = NULL;
+    }
+}
+
+/* Precompute tar --exclude arguments once at load so concurrent extractions
+ * (bootstrap) only ever read them. A rule qualifies when it ends in '*', so an
+ * excluded directory implies its whole subtree, and no path-include follows it. */
+static void build_tar_excludes(void) {
+    int last_include = -1;
+    for (int i = 0; i < g_path_filters_count; i++) {
+        if (g_path_filters[i].include) last_include = i;
+    }
+
+    int n = 0;
+    for (int i = last_include + 1; i < g_path_filters_count; i++) {
+        size_t len = strlen(g_path_filters[i].pattern);
+        if (len > 1 && g_path_filters[i].pattern[len - 1] == '*') n++;
+    }
+    if (n == 0) return;
+
+    g_tar_excludes = calloc((size_t)n * 2 + 1, sizeof(char *));
+    if (!g_tar_excludes) return;
+
+    int k = 0;
+    for (int i = last_include + 1; i < g_path_filters_count; i++) {
+        const char *pat = g_path_filters[i].pattern;
+        size_t len = strlen(pat);
+        if (len <= 1 || pat[len - 1] != '*') continue;
+        // data.tar members appear both as "./usr/..." and "usr/..."
+        if (asprintf(&g_tar_excludes[k], "--exclude=.%s", pat) >= 0) k++;
+        else g_tar_excludes[k] = NULL;
+        if (asprintf(&g_tar_excludes[k], "--exclude=%s", pat + 1) >= 0) k++;
+        else g_tar_excludes[k] = NULL;
+    }
 }
 
 void runepkg_config_load_sources(const char *filepath) {
@@ -401,9 +574,62 @@ void runepkg_config_load_sources(const char *filepath) {
             } else {
                 free(type); free(url); free(suite); free(components);
             }
+        } else if (strncmp(trimmed, "path-exclude", 12) == 0 || strncmp(trimmed, "path-include", 12) == 0) {
+            bool include = trimmed[5] == 'i';
+            char *pattern = runepkg_util_trim_whitespace(trimmed + 12);
+            if (*pattern == '=') pattern = runepkg_util_trim_whitespace(pattern + 1);
+            if (pattern[0] != '/') {
+                fprintf(stderr, "Warning: Ignoring %s rule '%s'; patterns must be absolute paths.\n",
+                        include ? "path-include" : "path-exclude", pattern);
+                continue;
+            }
+            RunePathFilter *grown = realloc(g_path_filters, sizeof(RunePathFilter) * (g_path_filters_count + 1));
+            if (!grown) break;
+            g_path_filters = grown;
+            g_path_filters[g_path_filters_count].include = include;
+            g_path_filters[g_path_filters_count].pattern = strdup(pattern);
+            if (g_path_filters[g_path_filters_count].pattern) g_path_filters_count++;
         }
     }
     fclose(file);
+
+    build_tar_excludes();
+}
+
+bool runepkg_config_path_excluded(const char *path) {
+    if (!path || g_path_filters_count == 0) return false;
+
+    char abs_path[PATH_MAX];
+    while (path[0] == '.' && path[1] == '/') path++;
+    snprintf(abs_path, sizeof(abs_path), "%s%s", path[0] == '/' ? "" : "/", path);
+
+    bool excluded = false;
+    for (int i = 0; i < g_path_filters_count; i++) {
+        if (fnmatch(g_path_filters[i].pattern, abs_path, 0) == 0) {
+            excluded = !g_path_filters[i].include;
+        }
+    }
+    return excluded;
+}
+
+const char *const *runepkg_config_tar_excludes() {
+    return (const char *const *)g_tar_excludes;
+}
+
+const char *runepkg_config_native_arch(void) {
+    for (int i = 0; i < g_architectures_count; i++) {
+        if (g_architectures[i] && strcmp(g_architectures[i], "all") != 0) return g_architectures[i];
+    }
+    return detect_native_arch();
+}
+
+bool runepkg_config_arch_enabled(const char *arch) {
+    if (!arch) return false;
+    if (strcmp(arch, "all") == 0) return g_architectures_count > 0;
+    for (int i = 0; i < g_architectures_count; i++) {
+        if (g_architectures[i] && strcmp(g_architectures[i], arch) == 0) return true;
+    }
+    return false;
 }
 
 void runepkg_init_paths() {
@@ -25,6 +25,10 @@
 #define PATH_MAX 4096
 #endif
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 // --- Global Path Variables Declarations ---
 extern char *g_runepkg_base_dir;
 extern char *g_control_dir;
@@ -39,6 +43,34 @@ extern char *g_build_dir;
 extern char *g_debs_dir;
 extern bool g_md5_checks;
 
+/* When true, 'runepkg update' also fetches Contents-<arch>.gz and builds the path->package index. */
+extern bool g_fetch_contents;
+
+/* Memory budget in MiB for building repository indexes during 'runepkg update';
+ * 0 (default) means unlimited. When set, large sorts spill to disk. */
+extern unsigned long g_update_memory_mb;
+
+/* Size budget in MiB for cached .debs in download_dir; 0 (default) disables the
+ * cache: downloads are deleted after install when cleanup is on. */
+extern unsigned long g_download_cache_mb;
+
+/* Content-addressed store installed files are linked or cloned from (NULL = off),
+ * and whether roots get hardlinks (read-only roots) instead of reflinks. */
+extern char *g_package_store;
+extern bool g_store_hardlink;
+
+/* Number of install/upgrade/remove transactions kept for 'runepkg rollback'
+ * (default 3, 0 disables), and where their backups live (NULL means
+ * <runepkg_dir>/transactions). Must share a filesystem with install_dir. */
+extern unsigned long g_keep_transactions;
+extern char *g_transaction_dir;
+
+/* Debian architectures update fetches and indexes (e.g. amd64 i386 all). The
+ * first one other than "all" is the native architecture; the default is the
+ * running machine's. */
+extern char **g_architectures;
+extern int g_architectures_count;
+
 /* When true (default), delete per-package extraction trees under control_dir after install/skip paths. */
 extern bool g_cleanup_extract_dirs;
 
@@ -66,6 +98,18 @@ typedef struct {
 extern RuneSource **g_sources;
 extern int g_sources_count;
 
+// --- Path Filters ---
+
+/* dpkg-style path-exclude=/path-include= rules, evaluated in order; the last
+ * matching rule decides whether a shipped file is written to disk. */
+typedef struct {
+    bool include;
+    char *pattern;    // fnmatch(3) glob against the absolute path, '*' spans '/'
+} RunePathFilter;
+
+extern RunePathFilter *g_path_filters;
+extern int g_path_filters_count;
+
 // --- Function Prototypes for Configuration Management ---
 
 /**
@@ -109,4 +153,37 @@ void runepkg_config_cleanup();
  */
 char *runepkg_get_config_file_path();
 
+/**
+ * @brief Checks a package path against the configured path-exclude/path-include rules.
+ *
+ * @param path File path relative to the install root, with or without a leading '/'.
+ * @return true if the file should not be installed, false otherwise.
+ */
+bool runepkg_config_path_excluded(const char *path);
+
+/**
+ * @brief Returns the tar --exclude arguments derived from the path filters.
+ *
+ * Only exclude rules that no later path-include rule can override are turned
+ * into tar patterns, so these can be dropped while streaming the data archive.
+ * The remaining rules are applied when the file list is collected.
+ *
+ * @return A NULL-terminated argument list owned by the config, or NULL if empty.
+ */
+const char *const *runepkg_config_tar_excludes();
+
+/**
+ * @brief Returns the native Debian architecture (first configured one that is not "all").
+ */
+const char *runepkg_config_native_arch(void);
+
+/**
+ * @brief True if arch is one of the configured architectures (or "all").
+ */
+bool runepkg_config_arch_enabled(const char *arch);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif // RUNEPKG_CONFIG_H
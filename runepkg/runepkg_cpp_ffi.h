@@ -15,8 +15,10 @@ extern "C" {
 
 int runepkg_cpp_ffi_available(void);
 int runepkg_update(void);
-int runepkg_repo_search(const char *query);
+int runepkg_repo_search(const char *query, bool show_all);
+int runepkg_repo_contents_search(const char *path);
 char* runepkg_repo_download(const char *pkg_name, bool recursive);
+char** runepkg_repo_fetch_closure(const char *const *pkg_names, int count);
 int runepkg_repo_build_depends_download(const char *pkg_name);
 int runepkg_upgrade(void);
 int runepkg_repo_source_download(const char *pkg_name);
@@ -24,6 +26,8 @@ int runepkg_repo_source_depends_download(const char *pkg_name);
 int runepkg_repo_source_build_depends_download(const char *pkg_name);
 int runepkg_source_unpack(const char *dsc_path);
 int runepkg_source_build(const char *dsc_path);
+int runepkg_repo_scan(const char *dir);
+int runepkg_serve(int port);
 
 #ifdef __cplusplus
 }
@@ -35,9 +35,11 @@
 #include "runepkg_config.h"
 #include "runepkg_pack.h"
 #include "runepkg_hash.h"
+#include "runepkg_intern.h"
 #include "runepkg_storage.h"
 #include "runepkg_util.h"
 #include "runepkg_md5sums.h"
+#include "runepkg_txn.h"
 #include "runepkg_cpp_ffi.h"
 #include <stdint.h>
 #include <sys/mman.h>
@@ -209,6 +211,7 @@ int runepkg_init(void) {
 
 void runepkg_cleanup(void) {
     runepkg_log_verbose("Cleaning up runepkg environment...\n");
+    runepkg_txn_commit();
     
     if (runepkg_main_hash_table) {
         runepkg_hash_destroy_table(runepkg_main_hash_table);
@@ -221,6 +224,7 @@ void runepkg_cleanup(void) {
     }
     /* One concise message for destroyed hash tables */
     runepkg_log_verbose("Hash tables destroyed and memory freed.\n");
+    runepkg_intern_reset();
 
     runepkg_config_cleanup();
 
@@ -394,7 +398,7 @@ int handle_remove(const char *package_name) {
             if (!rel || rel[0] == '\0') continue;
             char *dst = runepkg_util_concat_path(g_system_install_root, rel);
             if (!dst) continue;
-            if (unlink(dst) != 0) {
+            if (runepkg_txn_displace(dst) != 0 && unlink(dst) != 0) {
                 runepkg_log_verbose("Remove: failed to delete %s\n", dst);
             }
             runepkg_util_free_and_null(&dst);
@@ -406,7 +410,8 @@ int handle_remove(const char *package_name) {
 
     runepkg_pack_free_package_info(&pkg_info);
 
-    if (runepkg_storage_remove_package(pkg_name, pkg_version) != 0) {
+    if (runepkg_txn_save_record(pkg_name, pkg_version) != 0 &&
+        runepkg_storage_remove_package(pkg_name, pkg_version) != 0) {
         printf("Warning: failed to remove package metadata for %s-%s\n", pkg_name, pkg_version);
         runepkg_pack_free_package_info(&pkg_info);
         return -1;
@@ -516,6 +521,9 @@ int handle_status(const char *package_name) {
             printf("Priority: %s\n", pkg_info.priority ? pkg_info.priority : "(unknown)");
             printf("Homepage: %s\n", pkg_info.homepage ? pkg_info.homepage : "(unknown)");
             printf("Files installed: %d\n", pkg_info.file_count);
+            if (pkg_info.excluded_count > 0) {
+                printf("Files excluded: %d (path filters)\n", pkg_info.excluded_count);
+            }
             runepkg_pack_free_package_info(&pkg_info);
             return 0;
         } else {
@@ -732,6 +740,23 @@ void handle_print_config(void) {
     printf("  Cleanup: %s\n", g_cleanup_extract_dirs ? "yes" : "no");
     extern bool g_md5_checks;
     printf("  MD5 Checks: %s\n", g_md5_checks ? "yes" : "no");
+    printf("  Fetch Contents: %s\n", g_fetch_contents ? "yes" : "no");
+    if (g_update_memory_mb) printf("  Update Memory Budget: %lu MiB\n", g_update_memory_mb);
+    else printf("  Update Memory Budget: unlimited\n");
+    if (g_download_cache_mb) printf("  Download Cache: %lu MiB\n", g_download_cache_mb);
+    else printf("  Download Cache: off\n");
+    if (g_package_store) printf("  Package Store: %s (%s)\n", g_package_store, g_store_hardlink ? "hardlink" : "reflink");
+    else printf("  Package Store: off\n");
+    if (g_keep_transactions) printf("  Transactions Kept: %lu (%s)\n", g_keep_transactions, g_transaction_dir ? g_transaction_dir : "runepkg_dir/transactions");
+    else printf("  Transactions Kept: off\n");
+    printf("  Architectures: %s (native)", runepkg_config_native_arch());
+    for (int i = 0; i < g_architectures_count; i++) {
+        if (strcmp(g_architectures[i], runepkg_config_native_arch()) != 0) printf(" %s", g_architectures[i]);
+    }
+    printf("\n");
+    for (int i = 0; i < g_path_filters_count; i++) {
+        printf("  Path %s: %s\n", g_path_filters[i].include ? "Include" : "Exclude", g_path_filters[i].pattern);
+    }
 
     if (g_sources_count > 0 && g_sources) {
         printf("\nConfigured Sources:\n");
@@ -993,6 +1018,84 @@ int handle_source_build(const char *dsc_path) {
 #endif
 }
 
+int handle_hold(const char *package_name, bool hold) {
+    if (!package_name) {
+        int count = 0;
+        char **holds = runepkg_storage_load_holds(&count);
+        if (count == 0) printf("No packages are held.\n");
+        for (int i = 0; i < count; i++) printf("%s\n", holds[i]);
+        runepkg_storage_free_holds(holds, count);
+        return 0;
+    }
+
+    int ret = runepkg_storage_set_hold(package_name, hold);
+    if (ret < 0) {
+        runepkg_util_error("Failed to update hold list for %s.\n", package_name);
+        return -1;
+    }
+    if (ret == 1) {
+        printf("%s was already %s.\n", package_name, hold ? "held" : "not held");
+    } else {
+        printf("\033[1;32m[runepkg]\033[0m %s %s.\n", package_name, hold ? "set on hold; upgrade will keep it back" : "released from hold");
+    }
+    return 0;
+}
+
+int handle_db(const char *action, const char *snapshot_path, bool hash_files) {
+    if (strcmp(action, "export") == 0) {
+        int count = runepkg_storage_export_snapshot(snapshot_path, hash_files);
+        if (count < 0) return -1;
+        // Keep stdout clean when the snapshot itself is streamed there
+        FILE *out = strcmp(snapshot_path, "-") == 0 ? stderr : stdout;
+        fprintf(out, "\033[1;32m[db]\033[0m Exported %d package records to %s.\n", count, snapshot_path);
+        return 0;
+    }
+    if (strcmp(action, "import") == 0) {
+        int count = runepkg_storage_import_snapshot(snapshot_path, g_force_mode);
+        if (count < 0) return -1;
+        runepkg_storage_build_autocomplete_index();
+        handle_update_pkglist();
+        printf("\033[1;32m[db]\033[0m Imported %d package records into %s.\n", count, g_runepkg_db_dir);
+        if (strcmp(snapshot_path, "-") != 0) {
+            printf("Files are not part of a snapshot; 'runepkg db list %s' prints the versions to fetch.\n", snapshot_path);
+        }
+        return 0;
+    }
+    if (strcmp(action, "list") == 0) {
+        return runepkg_storage_list_snapshot(snapshot_path) < 0 ? -1 : 0;
+    }
+    printf("Error: Unknown db action '%s' (expected export, import, list or diff).\n", action);
+    return -1;
+}
+
+int handle_db_diff(const char *source_a, const char *source_b, bool compare_files) {
+    if (strcmp(source_a, "-") == 0 && strcmp(source_b, "-") == 0) {
+        printf("Error: Only one side of db diff can be read from stdin.\n");
+        return -1;
+    }
+    // Non-zero on drift, like diff(1), so fleet checks can branch on the exit code
+    return runepkg_storage_diff_snapshots(source_a, source_b, compare_files) == 0 ? 0 : -1;
+}
+
+int handle_rollback(const char *transaction_id) {
+    if (transaction_id && strcmp(transaction_id, "list") == 0) {
+        runepkg_txn_list();
+        return 0;
+    }
+    int undone = runepkg_txn_rollback(transaction_id);
+    if (undone > 0) {
+        runepkg_storage_build_autocomplete_index();
+        handle_update_pkglist();
+        printf("\033[1;32m[rollback]\033[0m Undid %d transaction%s; maintainer scripts were not re-run.\n",
+               undone, undone == 1 ? "" : "s");
+    }
+    return undone < 0 ? -1 : 0;
+}
+
+static int compare_path_strings(const void *a, const void *b) {
+    return strcmp(*(const char *const *)a, *(const char *const *)b);
+}
+
 int handle_md5_check(const char *package_name) {
     if (!package_name) return -1;
 
@@ -1060,12 +1163,23 @@ int handle_md5_check(const char *package_name) {
         return -1;
     }
 
+    // Files left off the disk by path-exclude rules at install time are not failures
+    if (pkg_info.excluded_count > 1) {
+        qsort(pkg_info.excluded_files, pkg_info.excluded_count, sizeof(char *), compare_path_strings);
+    }
+
     printf("\033[1;34m[integrity]\033[0m Verifying %s integrity...\n", found_pkg);
     char line[PATH_MAX + 64];
-    int total = 0, ok = 0, fail = 0;
+    int total = 0, ok = 0, fail = 0, skipped = 0;
     while (fgets(line, sizeof(line), f)) {
         char exp[33], rel[PATH_MAX];
         if (sscanf(line, "%32s  %s", exp, rel) != 2) continue;
+        const char *key = rel;
+        if (pkg_info.excluded_count > 0 &&
+            bsearch(&key, pkg_info.excluded_files, pkg_info.excluded_count, sizeof(char *), compare_path_strings)) {
+            skipped++;
+            continue;
+        }
         total++;
 
         char *full = runepkg_util_concat_path(g_system_install_root, rel);
@@ -1087,6 +1201,9 @@ int handle_md5_check(const char *package_name) {
     fclose(f);
     free(md5sums_path);
 
+    if (skipped > 0) {
+        printf("\033[1;34m[integrity]\033[0m Skipped %d files excluded by path filters.\n", skipped);
+    }
     if (fail == 0) {
         printf("\033[1;32m[integrity]\033[0m Verification complete: all %d files OK.\n", total);
     } else {
@@ -47,7 +47,11 @@ void handle_search(const char *query);
 int handle_unpack(const char *deb_path);
 int handle_build(const char *source_dir, const char *output_name);
 int handle_source_build(const char *dsc_path);
+int handle_hold(const char *package_name, bool hold);
 int handle_md5_check(const char *package_name);
+int handle_db(const char *action, const char *snapshot_path, bool hash_files);
+int handle_db_diff(const char *source_a, const char *source_b, bool compare_files);
+int handle_rollback(const char *transaction_id);
 void handle_print_config(void);
 void handle_print_config_file(void);
 void handle_print_pkglist_file(void);
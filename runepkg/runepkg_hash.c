@@ -59,23 +59,13 @@ static size_t find_next_prime(size_t num) {
 }
 
 /**
- * @brief Hash function using FNV-1a algorithm.
- * @param name The string to hash.
+ * @brief Maps an interned package name id to its bucket.
+ * @param id The package name's id. Ids are dense, so they spread evenly on their own.
  * @param table_size The size of the hash table.
- * @return The hash value.
+ * @return The bucket index.
  */
-static unsigned int hash_function(const char *name, size_t table_size) {
-    if (!name || table_size == 0) return 0;
-
-    const unsigned int FNV_PRIME_32 = 16777619U;
-    const unsigned int FNV_OFFSET_BASIS_32 = 2166136261U;
-
-    unsigned int hash = FNV_OFFSET_BASIS_32;
-    for (const char *p = name; *p != '\0'; p++) {
-        hash ^= (unsigned char)*p;
-        hash *= FNV_PRIME_32;
-    }
-    return hash % table_size;
+static size_t bucket_of(runepkg_name_id id, size_t table_size) {
+    return table_size ? id % table_size : 0;
 }
 
 // --- Memory Management Functions ---
@@ -114,6 +104,15 @@ void runepkg_hash_free_package_info(PkgInfo *pkg_info) {
         pkg_info->file_list = NULL;
     }
     pkg_info->file_count = 0;
+
+    if (pkg_info->excluded_files) {
+        for (int i = 0; i < pkg_info->excluded_count; i++) {
+            runepkg_util_free_and_null(&pkg_info->excluded_files[i]);
+        }
+        free(pkg_info->excluded_files);
+        pkg_info->excluded_files = NULL;
+    }
+    pkg_info->excluded_count = 0;
 }
 
 // --- Hash Table Core Functions ---
@@ -164,14 +163,23 @@ runepkg_hash_table_t* runepkg_hash_create_table(size_t initial_size) {
 PkgInfo* runepkg_hash_search(runepkg_hash_table_t *table, const char *name) {
     if (!table || !name || name[0] == '\0') return NULL;
 
-    unsigned int index = hash_function(name, table->size);
-    runepkg_hash_node_t *current = table->buckets[index];
+    // A name that was never interned cannot be in any table.
+    return runepkg_hash_search_id(table, runepkg_intern_find(name));
+}
+
+/**
+ * @brief Searches the hash table by interned package name id.
+ * @param table A pointer to the hash table.
+ * @param id The package name's id from runepkg_intern().
+ * @return A pointer to the package info, or NULL if not found.
+ */
+PkgInfo* runepkg_hash_search_id(runepkg_hash_table_t *table, runepkg_name_id id) {
+    if (!table || id == RUNEPKG_NAME_NONE) return NULL;
 
-    while (current) {
-        if (current->data.package_name && strcmp(current->data.package_name, name) == 0) {
+    for (runepkg_hash_node_t *current = table->buckets[bucket_of(id, table->size)]; current; current = current->next) {
+        if (current->name_id == id) {
             return &current->data;
         }
-        current = current->next;
     }
     return NULL;
 }
@@ -212,7 +220,7 @@ static int resize_hash_table(runepkg_hash_table_t *table, size_t new_size) {
         while (current) {
             runepkg_hash_node_t *next = current->next;
             
-            unsigned int new_index = hash_function(current->data.package_name, new_size);
+            size_t new_index = bucket_of(current->name_id, new_size);
             current->next = table->buckets[new_index];
             table->buckets[new_index] = current;
             table->count++;
@@ -237,8 +245,14 @@ int runepkg_hash_add_package(runepkg_hash_table_t *table, const PkgInfo *pkg_inf
         return -1;
     }
 
+    runepkg_name_id name_id = runepkg_intern(pkg_info->package_name);
+    if (name_id == RUNEPKG_NAME_NONE) {
+        runepkg_util_error("Failed to intern package name '%s'.\n", pkg_info->package_name);
+        return -1;
+    }
+
     // Check if package already exists
-    PkgInfo *existing = runepkg_hash_search(table, pkg_info->package_name);
+    PkgInfo *existing = runepkg_hash_search_id(table, name_id);
     if (existing) {
         runepkg_util_log_verbose("Package '%s' already exists in hash table, updating.\n", pkg_info->package_name);
         runepkg_hash_free_package_info(existing);
@@ -284,6 +298,18 @@ int runepkg_hash_add_package(runepkg_hash_table_t *table, const PkgInfo *pkg_inf
             existing->file_list = NULL;
             existing->file_count = 0;
         }
+
+        existing->excluded_files = NULL;
+        existing->excluded_count = 0;
+        if (pkg_info->excluded_files && pkg_info->excluded_count > 0) {
+            existing->excluded_files = runepkg_secure_malloc(pkg_info->excluded_count * sizeof(char*));
+            if (existing->excluded_files) {
+                existing->excluded_count = pkg_info->excluded_count;
+                for (int i = 0; i < pkg_info->excluded_count; i++) {
+                    existing->excluded_files[i] = pkg_info->excluded_files[i] ? runepkg_secure_strdup(pkg_info->excluded_files[i]) : NULL;
+                }
+            }
+        }
         
         return 0;
     }
@@ -302,6 +328,7 @@ int runepkg_hash_add_package(runepkg_hash_table_t *table, const PkgInfo *pkg_inf
     }
 
     memset(&new_node->data, 0, sizeof(PkgInfo));
+    new_node->name_id = name_id;
 
     new_node->data.package_name = pkg_info->package_name ? runepkg_secure_strdup(pkg_info->package_name) : NULL;
     new_node->data.version = pkg_info->version ? runepkg_secure_strdup(pkg_info->version) : NULL;
@@ -345,7 +372,19 @@ int runepkg_hash_add_package(runepkg_hash_table_t *table, const PkgInfo *pkg_inf
         new_node->data.file_count = 0;
     }
 
-    unsigned int index = hash_function(pkg_info->package_name, table->size);
+    new_node->data.excluded_files = NULL;
+    new_node->data.excluded_count = 0;
+    if (pkg_info->excluded_files && pkg_info->excluded_count > 0) {
+        new_node->data.excluded_files = runepkg_secure_malloc(pkg_info->excluded_count * sizeof(char*));
+        if (new_node->data.excluded_files) {
+            new_node->data.excluded_count = pkg_info->excluded_count;
+            for (int i = 0; i < pkg_info->excluded_count; i++) {
+                new_node->data.excluded_files[i] = pkg_info->excluded_files[i] ? runepkg_secure_strdup(pkg_info->excluded_files[i]) : NULL;
+            }
+        }
+    }
+
+    size_t index = bucket_of(name_id, table->size);
     new_node->next = table->buckets[index];
     table->buckets[index] = new_node;
     table->count++;
@@ -362,11 +401,14 @@ int runepkg_hash_add_package(runepkg_hash_table_t *table, const PkgInfo *pkg_inf
 void runepkg_hash_remove_package(runepkg_hash_table_t *table, const char *name) {
     if (!table || !name || name[0] == '\0') return;
 
-    unsigned int index = hash_function(name, table->size);
+    runepkg_name_id name_id = runepkg_intern_find(name);
+    if (name_id == RUNEPKG_NAME_NONE) return;
+
+    size_t index = bucket_of(name_id, table->size);
     runepkg_hash_node_t *current = table->buckets[index];
     runepkg_hash_node_t *prev = NULL;
 
-    while (current && strcmp(current->data.package_name, name) != 0) {
+    while (current && current->name_id != name_id) {
         prev = current;
         current = current->next;
     }
@@ -25,6 +25,7 @@
 
 #include <stddef.h>
 #include <stdbool.h>
+#include "runepkg_intern.h"
 
 // --- Hash Table Configuration ---
 #define INITIAL_HASH_TABLE_SIZE 2
@@ -56,6 +57,8 @@ typedef struct PkgInfo {
     bool md5_verified;
     char **file_list;
     int file_count;
+    char **excluded_files;  // Shipped paths skipped by path-exclude rules (not on disk)
+    int excluded_count;
     char *control_dir_path; // Re-added: Path to the extracted 'control' directory.
     char *data_dir_path;    // Re-added: Path to the extracted 'data' directory.
 } PkgInfo;
@@ -63,6 +66,7 @@ typedef struct PkgInfo {
 // --- Hash Table Node Structure ---
 typedef struct runepkg_hash_node {
     PkgInfo data; // Use the new PkgInfo struct
+    runepkg_name_id name_id; // Interned data.package_name; buckets and lookups go by id
     struct runepkg_hash_node *next;
 } runepkg_hash_node_t;
 
@@ -94,6 +98,14 @@ runepkg_hash_table_t* runepkg_hash_create_table(size_t initial_size);
  */
 PkgInfo* runepkg_hash_search(runepkg_hash_table_t *table, const char *name);
 
+/**
+ * @brief Searches the hash table by interned package name id.
+ * @param table A pointer to the hash table.
+ * @param id The package name's id from runepkg_intern().
+ * @return A pointer to the package info, or NULL if not found.
+ */
+PkgInfo* runepkg_hash_search_id(runepkg_hash_table_t *table, runepkg_name_id id);
+
 /**
  * @brief Adds a package to the hash table with deep copy.
  * @param table A pointer to the hash table.
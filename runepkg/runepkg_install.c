@@ -6,6 +6,9 @@
 #include "runepkg_storage.h"
 #include "runepkg_handle.h"
 #include "runepkg_md5sums.h"
+#include "runepkg_cache.h"
+#include "runepkg_store.h"
+#include "runepkg_txn.h"
 
 #ifdef ENABLE_CPP_FFI
 #include "runepkg_cpp_ffi.h"
@@ -20,6 +23,8 @@
 #include <libgen.h>
 #include <errno.h>
 #include <glob.h>
+#include <dirent.h>
+#include <ctype.h>
 #include <time.h>
 #include <limits.h>
 #include <sys/types.h>
@@ -98,6 +103,7 @@ int runepkg_install_verify_md5(const PkgInfo *pkg_info) {
         char expected_md5[33];
         char rel_path[PATH_MAX];
         if (sscanf(line, "%32s  %s", expected_md5, rel_path) != 2) continue;
+        if (runepkg_config_path_excluded(rel_path)) continue;
         total++;
 
         char *full_path = runepkg_util_concat_path(pkg_info->data_dir_path, rel_path);
@@ -168,11 +174,13 @@ static int perform_file_install(const char *src, const char *dst) {
                     fprintf(stderr, "\033[1;31m[file error]\033[0m Cannot overwrite directory with file: %s\n", dst);
                     return -1;
                 }
-            } else {
+            } else if (runepkg_txn_displace(dst) != 0) {
                 unlink(dst);
             }
+        } else {
+            runepkg_txn_note_created(dst);
         }
-        if (runepkg_util_copy_file(src, dst) != 0) {
+        if (runepkg_store_materialize(src, dst) != 0 && runepkg_util_copy_file(src, dst) != 0) {
             fprintf(stderr, "\033[1;31m[file error]\033[0m Failed to copy file: %s\n", dst);
             return -1;
         }
@@ -187,7 +195,11 @@ static int perform_file_install(const char *src, const char *dst) {
                 if (parent) runepkg_util_create_dir_recursive(parent, 0755);
                 free(dst_copy);
             }
-            unlink(dst);
+            // An empty directory in the way (e.g. from the FHS skeleton) gives way to the link
+            struct stat dst_st;
+            if (lstat(dst, &dst_st) != 0) runepkg_txn_note_created(dst);
+            else if (S_ISDIR(dst_st.st_mode)) rmdir(dst);
+            else if (runepkg_txn_displace(dst) != 0) unlink(dst);
             if (symlink(link_target, dst) != 0) {
                 fprintf(stderr, "\033[1;31m[file error]\033[0m Failed to create symlink: %s -> %s (%s)\n", dst, link_target, strerror(errno));
                 return -1;
@@ -220,6 +232,7 @@ void* install_single_file(void *arg) {
 }
 
 int handle_install(const char *deb_file_path) {
+    runepkg_cache_hold();
     int ret = handle_install_internal(deb_file_path, 1);
     g_auto_confirm_deps = false;
     g_auto_confirm_siblings = false;
@@ -646,7 +659,7 @@ static int handle_install_internal(const char *deb_file_path, int is_top_level)
                  */
                 char *old_ver = existing_inst->version ? strdup(existing_inst->version) : NULL;
                 runepkg_hash_remove_package(runepkg_main_hash_table, pkg_info.package_name);
-                if (old_ver) {
+                if (old_ver && runepkg_txn_save_record(pkg_info.package_name, old_ver) != 0) {
                     runepkg_storage_remove_package(pkg_info.package_name, old_ver);
                 }
                 /* Use saved `old_ver` for comparisons/printing instead of
@@ -986,6 +999,7 @@ else {
         if (pkg_info.package_name && pkg_info.version) {
             if (runepkg_storage_create_package_directory(pkg_info.package_name, pkg_info.version) == 0) {
                 if (runepkg_storage_write_package_info(pkg_info.package_name, pkg_info.version, &pkg_info) == 0) {
+                    runepkg_txn_note_record(pkg_info.package_name, pkg_info.version);
                     if (g_verbose_mode) {
                         printf("Package successfully added to persistent storage.\n");
                     }
@@ -1113,8 +1127,11 @@ else {
 
     runepkg_pack_free_package_info(&pkg_info);
 
-    /* Incremental cleanup: if cleanup is enabled and this file is in the download cache, remove it. */
-    if (g_cleanup_extract_dirs && g_download_dir && deb_file_path) {
+    /* With a sized download cache the file stays for reinstalls and is evicted later;
+     * otherwise, if cleanup is enabled and this file is in the download cache, remove it. */
+    if (runepkg_cache_enabled()) {
+        runepkg_cache_touch(deb_file_path);
+    } else if (g_cleanup_extract_dirs && g_download_dir && deb_file_path) {
         if (strncmp(deb_file_path, g_download_dir, strlen(g_download_dir)) == 0) {
             runepkg_log_verbose("Cleaning up downloaded cache file: %s\n", deb_file_path);
             unlink(deb_file_path);
@@ -1127,3 +1144,356 @@ else {
 
     return 0;
 }
+
+/* --- Rootfs bootstrap ---
+ * Installs a whole package set into an alternate root in one pass: every
+ * .deb is extracted in parallel, paths shipped by several packages are
+ * resolved up front (the package later in dependency order wins), symlinks
+ * are laid down in path order so directory links exist before anything is
+ * placed beneath them, and the remaining regular files are copied by a
+ * shared worker pool. Package records and the autocomplete index are
+ * written once at the end, and maintainer scripts run last. */
+
+typedef struct {
+    const char *deb_path;
+    PkgInfo info;
+    unsigned char *is_link;  // Per file_list entry, filled by the extract worker
+    int extracted;
+    int skip;                // 1: superseded later in the set, 2: version already recorded in the root
+} BootstrapPkg;
+
+typedef struct {
+    const char *rel;
+    int pkg;
+    int is_link;
+} BootstrapEntry;
+
+typedef struct {
+    BootstrapPkg *pkgs;
+    int count;
+    const BootstrapEntry *files;
+    size_t file_count;
+    size_t next;   // Next work item, claimed atomically
+    int errors;    // Updated atomically
+} BootstrapJob;
+
+/* Re-runs over an existing root: a pool-style name_version_arch.deb whose
+ * version is already recorded needs no unpacking at all. */
+static int bootstrap_already_recorded(BootstrapPkg *p) {
+    const char *slash = strrchr(p->deb_path, '/');
+    const char *base = slash ? slash + 1 : p->deb_path;
+    const char *u1 = strchr(base, '_');
+    const char *u2 = u1 ? strchr(u1 + 1, '_') : NULL;
+    if (!u1 || !u2 || u1 == base || u2 == u1 + 1) return 0;
+    char *name = strndup(base, (size_t)(u1 - base));
+    char *version = strndup(u1 + 1, (size_t)(u2 - u1 - 1));
+    if (name && version && runepkg_storage_package_exists(name, version) == 1) {
+        p->info.package_name = name;
+        p->info.version = version;
+        return 1;
+    }
+    free(name);
+    free(version);
+    return 0;
+}
+
+static void *bootstrap_extract_worker(void *arg) {
+    BootstrapJob *job = (BootstrapJob*)arg;
+    size_t i;
+    while ((i = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED)) < (size_t)job->count) {
+        BootstrapPkg *p = &job->pkgs[i];
+        if (!g_force_mode && bootstrap_already_recorded(p)) {
+            p->skip = 2;
+            continue;
+        }
+        if (runepkg_pack_extract_and_collect_info(p->deb_path, g_control_dir, &p->info) != 0 || !p->info.package_name || !p->info.version) {
+            runepkg_util_error("Failed to unpack %s\n", p->deb_path);
+            __atomic_fetch_add(&job->errors, 1, __ATOMIC_RELAXED);
+            continue;
+        }
+        if (g_md5_checks) {
+            if (runepkg_install_verify_md5(&p->info) != 0) {
+                __atomic_fetch_add(&job->errors, 1, __ATOMIC_RELAXED);
+                continue;
+            }
+            p->info.md5_verified = true;
+        }
+        p->is_link = calloc((size_t)p->info.file_count + 1, 1);
+        if (!p->is_link) {
+            __atomic_fetch_add(&job->errors, 1, __ATOMIC_RELAXED);
+            continue;
+        }
+        for (int f = 0; f < p->info.file_count; f++) {
+            char *src = runepkg_util_concat_path(p->info.data_dir_path, p->info.file_list[f]);
+            struct stat st;
+            if (src && lstat(src, &st) == 0 && S_ISLNK(st.st_mode)) p->is_link[f] = 1;
+            free(src);
+        }
+        p->extracted = 1;
+        printf("Unpacking %s (%s) ...\n", p->info.package_name, p->info.version);
+    }
+    return NULL;
+}
+
+static void *bootstrap_place_worker(void *arg) {
+    BootstrapJob *job = (BootstrapJob*)arg;
+    size_t i;
+    while ((i = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED)) < job->file_count) {
+        const BootstrapEntry *e = &job->files[i];
+        char *src = runepkg_util_concat_path(job->pkgs[e->pkg].info.data_dir_path, e->rel);
+        char *dst = runepkg_util_concat_path(g_system_install_root, e->rel);
+        if (!src || !dst || perform_file_install(src, dst) != 0) {
+            __atomic_fetch_add(&job->errors, 1, __ATOMIC_RELAXED);
+        }
+        free(src);
+        free(dst);
+    }
+    return NULL;
+}
+
+/* Runs fn on up to `threads` workers sharing job->next, then joins them. */
+static void bootstrap_run_pool(void *(*fn)(void *), BootstrapJob *job, int threads) {
+    pthread_t tids[32];
+    int started = 0;
+    if (threads > 32) threads = 32;
+    job->next = 0;
+    for (int t = 0; t < threads; t++) {
+        if (pthread_create(&tids[started], NULL, fn, job) == 0) started++;
+    }
+    if (started == 0) fn(job); // No threads available; do the work here
+    for (int t = 0; t < started; t++) pthread_join(tids[t], NULL);
+}
+
+static int bootstrap_entry_cmp(const void *a, const void *b) {
+    const BootstrapEntry *x = (const BootstrapEntry*)a;
+    const BootstrapEntry *y = (const BootstrapEntry*)b;
+    int c = strcmp(x->rel, y->rel);
+    if (c != 0) return c;
+    return x->pkg - y->pkg;
+}
+
+/* Drops records of other versions of pkg_name from the (target) database so a
+ * re-run over an existing root upgrades rather than duplicates. The directory
+ * name only narrows the candidates ("gcc-12-12.2.0" could be gcc or gcc-12);
+ * the name stored in the record decides. */
+static void bootstrap_drop_stale_records(const char *pkg_name, const char *keep_version) {
+    DIR *dir = opendir(g_runepkg_db_dir);
+    if (!dir) return;
+    size_t name_len = strlen(pkg_name);
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        const char *d = entry->d_name;
+        if (strncmp(d, pkg_name, name_len) != 0 || d[name_len] != '-' || !isdigit((unsigned char)d[name_len + 1])) continue;
+        char bin_path[PATH_MAX];
+        snprintf(bin_path, sizeof(bin_path), "%s/%s/%s", g_runepkg_db_dir, d, RUNEPKG_STORAGE_BINARY_FILE);
+        char *name = NULL, *version = NULL;
+        if (runepkg_storage_read_record_identity(bin_path, &name, &version) != 0) continue;
+        if (strcmp(name, pkg_name) == 0 && strcmp(version, keep_version) != 0) {
+            runepkg_storage_remove_package(name, version);
+        }
+        free(name);
+        free(version);
+    }
+    closedir(dir);
+}
+
+int runepkg_install_bootstrap(const char *root, char *const deb_paths[], int count) {
+    if (!root || !deb_paths || count <= 0) return -1;
+    runepkg_cache_hold();
+    if (!g_control_dir) {
+        runepkg_util_error("g_control_dir is NULL - configuration not loaded properly\n");
+        return -1;
+    }
+
+    struct timespec start_time, end_time;
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+
+    if (runepkg_util_create_dir_recursive(root, 0755) != 0) {
+        runepkg_util_error("Failed to create bootstrap root %s\n", root);
+        return -1;
+    }
+    char *root_real = realpath(root, NULL);
+    if (!root_real) {
+        runepkg_util_error("Cannot resolve bootstrap root %s: %s\n", root, strerror(errno));
+        return -1;
+    }
+
+    /* Bootstrapping the configured install_dir keeps using the configured
+     * database; any other root gets its own, at the stock runepkg_db location
+     * inside the image, so runepkg running there later sees what is installed. */
+    char *configured_real = g_system_install_root ? realpath(g_system_install_root, NULL) : NULL;
+    bool own_db = !configured_real || strcmp(configured_real, root_real) != 0;
+    free(configured_real);
+
+    char *saved_root = g_system_install_root;
+    char *saved_db = g_runepkg_db_dir;
+    char *saved_txt = g_pkglist_txt_path;
+    char *saved_bin = g_pkglist_bin_path;
+    g_system_install_root = root_real;
+    /* Bootstrap fills a root in one pass; it is not a rollback-able transaction. */
+    runepkg_txn_suspend(true);
+    if (own_db) {
+        g_runepkg_db_dir = runepkg_util_concat_path(root_real, "var/lib/runepkg_dir/runepkg_db");
+        g_pkglist_txt_path = runepkg_util_concat_path(g_runepkg_db_dir, "runepkg_autocomplete.txt");
+        g_pkglist_bin_path = runepkg_util_concat_path(g_runepkg_db_dir, "runepkg_autocomplete.bin");
+        if (!g_runepkg_db_dir || !g_pkglist_txt_path || !g_pkglist_bin_path ||
+            runepkg_util_create_dir_recursive(g_runepkg_db_dir, 0755) != 0) {
+            runepkg_util_error("Failed to create package database under %s\n", root_real);
+            count = 0;
+        }
+    }
+    if (strcmp(root_real, "/") != 0) runepkg_util_init_fhs(root_real);
+
+    BootstrapPkg *pkgs = count > 0 ? calloc((size_t)count, sizeof(BootstrapPkg)) : NULL;
+    BootstrapJob job;
+    memset(&job, 0, sizeof(job));
+    job.pkgs = pkgs;
+    job.count = pkgs ? count : 0;
+    int threads = calculate_optimal_threads();
+    int installed = 0, placed = 0, skipped = 0, failed = pkgs ? 0 : 1;
+
+    if (pkgs) {
+        for (int i = 0; i < count; i++) {
+            pkgs[i].deb_path = deb_paths[i];
+            runepkg_pack_init_package_info(&pkgs[i].info);
+        }
+        printf("\033[1;34m[bootstrap]\033[0m Unpacking %d packages into %s...\n", count, root_real);
+        bootstrap_run_pool(bootstrap_extract_worker, &job, threads < count ? threads : count);
+        failed = job.errors;
+    }
+
+    if (failed == 0) {
+        /* One entry per shipped path; a package appearing twice in the set
+         * (e.g. a local .deb overriding its repository version) keeps the last. */
+        size_t total = 0;
+        for (int i = 0; i < count; i++) {
+            if (pkgs[i].skip) {
+                skipped++;
+                continue;
+            }
+            for (int j = i + 1; j < count && !pkgs[i].skip; j++) {
+                if (strcmp(pkgs[i].info.package_name, pkgs[j].info.package_name) == 0) pkgs[i].skip = 1;
+            }
+            if (pkgs[i].skip) continue;
+            if (!g_force_mode && runepkg_storage_package_exists(pkgs[i].info.package_name, pkgs[i].info.version) == 1) {
+                runepkg_log_verbose("%s (%s) is already in %s, skipping.\n", pkgs[i].info.package_name, pkgs[i].info.version, root_real);
+                pkgs[i].skip = 2;
+                skipped++;
+                continue;
+            }
+            total += (size_t)pkgs[i].info.file_count;
+            installed++;
+        }
+
+        BootstrapEntry *entries = total ? malloc(total * sizeof(BootstrapEntry)) : NULL;
+        size_t n = 0;
+        if (total && !entries) failed = 1;
+        for (int i = 0; entries && i < count; i++) {
+            if (pkgs[i].skip) continue;
+            for (int f = 0; f < pkgs[i].info.file_count; f++) {
+                const char *rel = pkgs[i].info.file_list[f];
+                if (!rel || !rel[0]) continue;
+                entries[n].rel = rel;
+                entries[n].pkg = i;
+                entries[n].is_link = pkgs[i].is_link[f];
+                n++;
+            }
+        }
+        if (n > 1) qsort(entries, n, sizeof(BootstrapEntry), bootstrap_entry_cmp);
+
+        /* Keep the last owner of every path. Sorting puts a path before
+         * anything beneath it, so creating links in this order has each
+         * directory link in place before files are placed through it. */
+        size_t files = 0;
+        for (size_t k = 0; k < n; k++) {
+            if (k + 1 < n && strcmp(entries[k].rel, entries[k + 1].rel) == 0) continue;
+            if (entries[k].is_link) {
+                char *src = runepkg_util_concat_path(pkgs[entries[k].pkg].info.data_dir_path, entries[k].rel);
+                char *dst = runepkg_util_concat_path(root_real, entries[k].rel);
+                if (!src || !dst || perform_file_install(src, dst) != 0) job.errors++;
+                free(src);
+                free(dst);
+            } else {
+                entries[files++] = entries[k];
+            }
+        }
+        job.files = entries;
+        job.file_count = files;
+        if (files > 0) bootstrap_run_pool(bootstrap_place_worker, &job, threads);
+        placed = (int)files;
+        free(entries);
+        if (job.errors > 0) printf("Bootstrap completed with %d file errors.\n", job.errors);
+
+        /* Write every package record, then the name indexes once. */
+        for (int i = 0; i < count; i++) {
+            if (pkgs[i].skip) continue;
+            PkgInfo *info = &pkgs[i].info;
+            bootstrap_drop_stale_records(info->package_name, info->version);
+            if (runepkg_storage_create_package_directory(info->package_name, info->version) != 0 ||
+                runepkg_storage_write_package_info(info->package_name, info->version, info) != 0) {
+                printf("Warning: Failed to record %s (%s) in the package database.\n", info->package_name, info->version);
+            }
+        }
+        runepkg_storage_build_autocomplete_index();
+        handle_update_pkglist();
+
+        /* Maintainer scripts only run against the live system; for an image
+         * root they are left to the first boot, so report them once here
+         * instead of warning for every package. */
+        int deferred = 0;
+        for (int i = 0; i < count; i++) {
+            if (pkgs[i].skip) continue;
+            PkgInfo *info = &pkgs[i].info;
+            if (strcmp(root_real, "/") == 0) {
+                runepkg_execute_maintainer_script(info->preinst, info, "install");
+                runepkg_execute_maintainer_script(info->postinst, info, "configure");
+            } else {
+                if (info->preinst && runepkg_util_file_exists(info->preinst)) deferred++;
+                if (info->postinst && runepkg_util_file_exists(info->postinst)) deferred++;
+            }
+        }
+        if (deferred > 0) {
+            printf("\033[1;33m[warning]\033[0m (non-root install) skipped %d maintainer scripts\n", deferred);
+        }
+    }
+
+    for (int i = 0; pkgs && i < count; i++) {
+        runepkg_pack_cleanup_extraction_workspace(&pkgs[i].info);
+        runepkg_pack_free_package_info(&pkgs[i].info);
+        free(pkgs[i].is_link);
+        if (failed) continue;
+        if (runepkg_cache_enabled()) {
+            runepkg_cache_touch(pkgs[i].deb_path);
+        } else if (g_cleanup_extract_dirs && g_download_dir &&
+                   strncmp(pkgs[i].deb_path, g_download_dir, strlen(g_download_dir)) == 0) {
+            unlink(pkgs[i].deb_path);
+        }
+    }
+    free(pkgs);
+
+    if (own_db) {
+        runepkg_util_free_and_null(&g_runepkg_db_dir);
+        runepkg_util_free_and_null(&g_pkglist_txt_path);
+        runepkg_util_free_and_null(&g_pkglist_bin_path);
+        g_runepkg_db_dir = saved_db;
+        g_pkglist_txt_path = saved_txt;
+        g_pkglist_bin_path = saved_bin;
+    }
+    g_system_install_root = saved_root;
+    runepkg_txn_suspend(false);
+
+    if (failed) {
+        runepkg_util_error("Bootstrap of %s aborted; nothing was installed.\n", root_real);
+        free(root_real);
+        return -1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end_time);
+    double elapsed = (end_time.tv_sec - start_time.tv_sec) + (end_time.tv_nsec - start_time.tv_nsec) / 1000000000.0;
+    printf("\033[1;32m[bootstrap]\033[0m %d packages (%d files) installed into %s in %.2fs",
+           installed, placed, root_real, elapsed);
+    if (skipped > 0) printf(", %d already present", skipped);
+    printf(".\n");
+    free(root_real);
+    return job.errors > 0 ? -1 : 0;
+}
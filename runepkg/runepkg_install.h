@@ -25,4 +25,16 @@ int clandestine_handle_install(const char *pkg_name, const char *origin_deb_path
 
 int calculate_optimal_threads(void);
 
+/**
+ * @brief Installs a package set into an alternate root in one pass.
+ * All packages are unpacked and placed concurrently, package records are
+ * written once, and maintainer scripts are deferred until everything is on
+ * disk (and only run when root is "/").
+ * @param root Target root directory; created (with an FHS skeleton) if needed.
+ * @param deb_paths .deb files in dependency order; on path conflicts the later one wins.
+ * @param count Number of entries in deb_paths.
+ * @return 0 on success, -1 on failure.
+ */
+int runepkg_install_bootstrap(const char *root, char *const deb_paths[], int count);
+
 #endif /* RUNEPKG_INSTALL_H */
@@ -0,0 +1,170 @@
+/******************************************************************************
+ * Filename:    runepkg_intern.c
+ * Author:      <michkochris@gmail.com>
+ * Date:        started 01-03-2025
+ * Description: Process-wide package name interner (name <-> dense integer id)
+ *
+ * Copyright (c) 2025 runepkg (Runar Linux) All rights reserved.
+ * GPLV3
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <https://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "runepkg_intern.h"
+
+// Names are packed into arena chunks of this size; a longer name gets a chunk of its own.
+#define INTERN_CHUNK_SIZE 65536
+#define INTERN_MIN_SLOTS 1024
+
+// By-id arrays (index 0 unused) plus an open-addressed table of ids.
+static const char **g_names = NULL;
+static uint32_t *g_lens = NULL;
+static uint32_t *g_hashes = NULL;
+static uint32_t g_count = 0, g_capacity = 0;
+
+static runepkg_name_id *g_slots = NULL;
+static uint32_t g_slot_mask = 0;
+
+static char **g_chunks = NULL;
+static size_t g_chunk_count = 0, g_chunk_used = 0, g_chunk_size = 0;
+
+static uint32_t intern_hash(const char *name, size_t len) {
+    uint32_t hash = 2166136261U; // FNV-1a, as in runepkg_hash.c
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)name[i];
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+static runepkg_name_id lookup(const char *name, size_t len, uint32_t hash, uint32_t *slot_out) {
+    if (!g_slots) return RUNEPKG_NAME_NONE;
+    uint32_t slot = hash & g_slot_mask;
+    for (;;) {
+        runepkg_name_id id = g_slots[slot];
+        if (id == RUNEPKG_NAME_NONE) break;
+        if (g_hashes[id] == hash && g_lens[id] == len && memcmp(g_names[id], name, len) == 0) return id;
+        slot = (slot + 1) & g_slot_mask;
+    }
+    if (slot_out) *slot_out = slot;
+    return RUNEPKG_NAME_NONE;
+}
+
+// Keeps the table at most half full; ids stay where they are, only slots move.
+static int grow_slots(void) {
+    uint32_t size = g_slots ? (g_slot_mask + 1) * 2 : INTERN_MIN_SLOTS;
+    runepkg_name_id *slots = calloc(size, sizeof(*slots));
+    if (!slots) return -1;
+    for (runepkg_name_id id = 1; id <= g_count; id++) {
+        uint32_t slot = g_hashes[id] & (size - 1);
+        while (slots[slot] != RUNEPKG_NAME_NONE) slot = (slot + 1) & (size - 1);
+        slots[slot] = id;
+    }
+    free(g_slots);
+    g_slots = slots;
+    g_slot_mask = size - 1;
+    return 0;
+}
+
+static int grow_ids(void) {
+    uint32_t capacity = g_capacity ? g_capacity * 2 : INTERN_MIN_SLOTS;
+    const char **names = realloc(g_names, capacity * sizeof(*names));
+    if (!names) return -1;
+    g_names = names;
+    uint32_t *lens = realloc(g_lens, capacity * sizeof(*lens));
+    if (!lens) return -1;
+    g_lens = lens;
+    uint32_t *hashes = realloc(g_hashes, capacity * sizeof(*hashes));
+    if (!hashes) return -1;
+    g_hashes = hashes;
+    g_capacity = capacity;
+    return 0;
+}
+
+static char *arena_copy(const char *name, size_t len) {
+    if (!g_chunks || g_chunk_size - g_chunk_used < len + 1) {
+        size_t size = len + 1 > INTERN_CHUNK_SIZE ? len + 1 : INTERN_CHUNK_SIZE;
+        char **chunks = realloc(g_chunks, (g_chunk_count + 1) * sizeof(*chunks));
+        if (!chunks) return NULL;
+        g_chunks = chunks;
+        char *chunk = malloc(size);
+        if (!chunk) return NULL;
+        g_chunks[g_chunk_count++] = chunk;
+        g_chunk_used = 0;
+        g_chunk_size = size;
+    }
+    char *copy = g_chunks[g_chunk_count - 1] + g_chunk_used;
+    memcpy(copy, name, len);
+    copy[len] = '\0';
+    g_chunk_used += len + 1;
+    return copy;
+}
+
+runepkg_name_id runepkg_intern_len(const char *name, size_t len) {
+    if (!name || len == 0 || len > UINT32_MAX) return RUNEPKG_NAME_NONE;
+    uint32_t hash = intern_hash(name, len), slot = 0;
+    runepkg_name_id id = lookup(name, len, hash, &slot);
+    if (id != RUNEPKG_NAME_NONE) return id;
+
+    if (!g_slots || (size_t)(g_count + 1) * 2 > (size_t)g_slot_mask + 1) {
+        if (grow_slots() != 0) return RUNEPKG_NAME_NONE;
+        lookup(name, len, hash, &slot);
+    }
+    if (g_count + 1 >= g_capacity && grow_ids() != 0) return RUNEPKG_NAME_NONE;
+    char *copy = arena_copy(name, len);
+    if (!copy) return RUNEPKG_NAME_NONE;
+
+    id = ++g_count;
+    g_names[id] = copy;
+    g_lens[id] = (uint32_t)len;
+    g_hashes[id] = hash;
+    g_slots[slot] = id;
+    return id;
+}
+
+runepkg_name_id runepkg_intern(const char *name) {
+    return name ? runepkg_intern_len(name, strlen(name)) : RUNEPKG_NAME_NONE;
+}
+
+runepkg_name_id runepkg_intern_find(const char *name) {
+    if (!name || !*name) return RUNEPKG_NAME_NONE;
+    size_t len = strlen(name);
+    return lookup(name, len, intern_hash(name, len), NULL);
+}
+
+const char *runepkg_intern_name(runepkg_name_id id) {
+    return (id != RUNEPKG_NAME_NONE && id <= g_count) ? g_names[id] : "";
+}
+
+uint32_t runepkg_intern_count(void) {
+    return g_count;
+}
+
+void runepkg_intern_reset(void) {
+    for (size_t i = 0; i < g_chunk_count; i++) free(g_chunks[i]);
+    free(g_chunks);
+    free(g_slots);
+    free(g_names);
+    free(g_lens);
+    free(g_hashes);
+    g_chunks = NULL;
+    g_chunk_count = g_chunk_used = g_chunk_size = 0;
+    g_slots = NULL;
+    g_slot_mask = 0;
+    g_names = NULL;
+    g_lens = g_hashes = NULL;
+    g_count = g_capacity = 0;
+}
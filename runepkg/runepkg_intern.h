@@ -0,0 +1,95 @@
+/******************************************************************************
+ * Filename:    runepkg_intern.h
+ * Author:      <michkochris@gmail.com>
+ * Date:        started 01-03-2025
+ * Description: Process-wide package name interner (name <-> dense integer id)
+ *
+ * Copyright (c) 2025 runepkg (Runar Linux) All rights reserved.
+ * GPLV3
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <https://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#ifndef RUNEPKG_INTERN_H
+#define RUNEPKG_INTERN_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Every package name the process handles is interned once and from then on
+ * travels as a small integer: ids are dense (1, 2, 3, ... in first-seen
+ * order), so the installed catalog compares ids instead of strings and the
+ * resolver keeps its visited/resolved sets as bitsets and arrays indexed by
+ * id. Id 0 is never assigned and means "no such name".
+ *
+ * Names are stored once in an append-only arena, so the pointer returned by
+ * runepkg_intern_name() stays valid until runepkg_intern_reset(). Ids are
+ * per process and never written to disk.
+ *
+ * Like runepkg_main_hash_table, the interner belongs to the main thread;
+ * install/bootstrap worker threads never see package names.
+ */
+
+typedef uint32_t runepkg_name_id;
+
+#define RUNEPKG_NAME_NONE ((runepkg_name_id)0)
+
+/**
+ * @brief Returns the id of name, assigning the next free one on first sight.
+ * @param name NUL-terminated package name.
+ * @return The name's id, or RUNEPKG_NAME_NONE for NULL/empty names or when out of memory.
+ */
+runepkg_name_id runepkg_intern(const char *name);
+
+/**
+ * @brief Like runepkg_intern() for a name that is not NUL-terminated.
+ * @param name Start of the name.
+ * @param len Length of the name in bytes.
+ * @return The name's id, or RUNEPKG_NAME_NONE.
+ */
+runepkg_name_id runepkg_intern_len(const char *name, size_t len);
+
+/**
+ * @brief Looks a name up without interning it.
+ * @param name NUL-terminated package name.
+ * @return The name's id, or RUNEPKG_NAME_NONE if it was never interned.
+ */
+runepkg_name_id runepkg_intern_find(const char *name);
+
+/**
+ * @brief Returns the interned spelling of an id.
+ * @param id An id returned by runepkg_intern().
+ * @return The name, or "" for RUNEPKG_NAME_NONE and unknown ids.
+ */
+const char *runepkg_intern_name(runepkg_name_id id);
+
+/**
+ * @brief Number of names interned so far; every valid id is <= this.
+ */
+uint32_t runepkg_intern_count(void);
+
+/**
+ * @brief Forgets every name and frees the interner's memory.
+ */
+void runepkg_intern_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RUNEPKG_INTERN_H
@@ -18,18 +18,49 @@
 #include <iomanip>
 #include <chrono>
 #include <mutex>
+#include <queue>
+#include <cmath>
+#include <string_view>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/wait.h>
+#include <sys/file.h>
+#include <sys/ioctl.h>
+#ifdef __linux__
+#include <linux/fs.h>
+#endif
+#include <limits>
+#include <atomic>
+#include <thread>
+#include <set>
+#include <csignal>
+#include <ctime>
+#include <climits>
+#include <sys/socket.h>
+#include <sys/sendfile.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <cerrno>
+#include <openssl/evp.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 extern "C" {
     #include "runepkg_util.h"
     #include "runepkg_hash.h"
+    #include "runepkg_intern.h"
     #include "runepkg_handle.h"
     #include "runepkg_install.h"
     #include "runepkg_storage.h"
+    #include "runepkg_stree.h"
+    #include "runepkg_cache.h"
+    #include "runepkg_repo_index.h"
 }
 
-// Architecture - default to amd64 for now
-const char* G_ARCH = "amd64";
-
 // Global state for parallel progress tracking
 std::mutex g_progress_mutex;
 std::map<std::string, double> g_active_downloads;
@@ -135,16 +166,113 @@ int curl_progress_cb(void *clientp, curl_off_t dltotal, curl_off_t dlnow, curl_o
     return 0;
 }
 
-bool download_file(const std::string& url, const std::string& dest_path, size_t expected_size = 0, std::string pkg_name = "") {
-    if (runepkg_util_file_exists(dest_path.c_str())) {
-        {
-            std::lock_guard<std::mutex> lock(g_progress_mutex);
-            if (g_completed_names.find(pkg_name) == g_completed_names.end()) {
-                g_completed_names.insert(pkg_name);
-                g_finished_count++;
-                print_multi_progress();
+// Filesystem path behind a file:// URL or a source given as a plain absolute
+// path (a local or NFS-mounted mirror); empty for anything fetched by curl.
+static std::string local_url_path(const std::string& url) {
+    std::string path;
+    if (url.compare(0, 7, "file://") == 0) path = url.substr(7);
+    else if (!url.empty() && url[0] == '/') return url;
+    else return "";
+    if (path.compare(0, 9, "localhost") == 0) path = path.substr(9);
+    if (path.empty() || path[0] != '/') return "";
+    std::string decoded;
+    for (size_t i = 0; i < path.size(); i++) {
+        if (path[i] == '%' && i + 2 < path.size() && isxdigit((unsigned char)path[i + 1]) && isxdigit((unsigned char)path[i + 2])) {
+            decoded += (char)std::stoi(path.substr(i + 1, 2), nullptr, 16);
+            i += 2;
+        } else {
+            decoded += path[i];
+        }
+    }
+    return decoded;
+}
+
+// Makes dest_path a copy of a local file with as little I/O as the filesystems
+// allow: a hard link (mirror files are never modified in place, and dest is
+// only ever replaced or unlinked), else a reflink, else copy_file_range, which
+// NFS 4.2 and some other filesystems turn into a server-side copy.
+static bool link_local_file(const std::string& src, const std::string& dest_path) {
+    if (link(src.c_str(), dest_path.c_str()) == 0) return true;
+    int in = open(src.c_str(), O_RDONLY);
+    if (in < 0) return false;
+    int out = open(dest_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out < 0) { close(in); return false; }
+    bool ok = false;
+#ifdef FICLONE
+    ok = ioctl(out, FICLONE, in) == 0;
+#endif
+    if (!ok) {
+        ok = true;
+        char buf[65536];
+        while (true) {
+            ssize_t n = copy_file_range(in, nullptr, out, nullptr, 1 << 30, 0);
+            if (n == 0) break;
+            if (n > 0) continue;
+            if (errno == EINTR) continue;
+            if (errno != EXDEV && errno != ENOSYS && errno != EOPNOTSUPP && errno != EINVAL) { ok = false; break; }
+            // No in-kernel copy between these filesystems; fall back to read/write.
+            while ((n = read(in, buf, sizeof(buf))) != 0) {
+                if (n < 0) { if (errno == EINTR) continue; ok = false; break; }
+                if (write(out, buf, n) != n) { ok = false; break; }
+            }
+            break;
+        }
+    }
+    close(in);
+    if (close(out) != 0) ok = false;
+    if (!ok) unlink(dest_path.c_str());
+    return ok;
+}
+
+// Holds <dest>.lock while a file is downloaded, so that other runepkg
+// processes (and other hosts sharing the directory over NFS, where flock is
+// carried by byte-range locks) wait for the transfer and reuse its result
+// instead of writing the same path at once. The holder removes the lock file
+// when it is done; a waiter that then wins a lock on the removed file retries
+// on the current one.
+class DownloadLock {
+public:
+    explicit DownloadLock(const std::string& dest_path) : path_(dest_path + ".lock") {
+        while (true) {
+            fd_ = open(path_.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+            if (fd_ < 0) return; // Directory without lock support: download unlocked as before
+            if (flock(fd_, LOCK_EX | LOCK_NB) != 0) {
+                waited_ = true;
+                int ret;
+                while ((ret = flock(fd_, LOCK_EX)) != 0 && errno == EINTR) {}
+                if (ret != 0) { close(fd_); fd_ = -1; return; }
             }
+            struct stat held, current;
+            if (fstat(fd_, &held) == 0 && stat(path_.c_str(), &current) == 0 && held.st_dev == current.st_dev && held.st_ino == current.st_ino) return;
+            close(fd_);
         }
+    }
+    ~DownloadLock() {
+        if (fd_ < 0) return;
+        unlink(path_.c_str());
+        close(fd_);
+    }
+    DownloadLock(const DownloadLock&) = delete;
+    DownloadLock& operator=(const DownloadLock&) = delete;
+    bool waited() const { return waited_; }
+private:
+    std::string path_;
+    int fd_ = -1;
+    bool waited_ = false;
+};
+
+static void mark_download_reused(const std::string& pkg_name) {
+    std::lock_guard<std::mutex> lock(g_progress_mutex);
+    if (g_completed_names.find(pkg_name) == g_completed_names.end()) {
+        g_completed_names.insert(pkg_name);
+        g_finished_count++;
+        print_multi_progress();
+    }
+}
+
+bool download_file(const std::string& url, const std::string& dest_path, size_t expected_size = 0, std::string pkg_name = "", double *speed_out = nullptr) {
+    if (runepkg_util_file_exists(dest_path.c_str())) {
+        mark_download_reused(pkg_name);
         return true;
     }
 
@@ -152,12 +280,34 @@ bool download_file(const std::string& url, const std::string& dest_path, size_t
         pkg_name = url.substr(url.find_last_of('/') + 1);
     }
 
+    DownloadLock dest_lock(dest_path);
+    if (dest_lock.waited() && runepkg_util_file_exists(dest_path.c_str())) {
+        // Another process fetched it while this one waited.
+        mark_download_reused(pkg_name);
+        return true;
+    }
+
     update_progress(pkg_name, 0.0);
 
+    // Written beside dest and renamed over it, so dest is only ever complete.
+    std::string part_path = dest_path + ".dl";
+    unlink(part_path.c_str());
+
+    std::string local_path = local_url_path(url);
+    if (!local_path.empty()) {
+        struct stat st;
+        if (stat(local_path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) return false;
+        if (expected_size > 0 && (size_t)st.st_size != expected_size) return false;
+        if (!link_local_file(local_path, part_path)) return false;
+        if (rename(part_path.c_str(), dest_path.c_str()) != 0) { unlink(part_path.c_str()); return false; }
+        update_progress(pkg_name, 1.0);
+        return true;
+    }
+
     CURL *curl = curl_easy_init();
     if (!curl) return false;
 
-    FILE *fp = fopen(dest_path.c_str(), "wb");
+    FILE *fp = fopen(part_path.c_str(), "wb");
     if (!fp) {
         curl_easy_cleanup(curl);
         return false;
@@ -175,57 +325,42 @@ bool download_file(const std::string& url, const std::string& dest_path, size_t
 
     CURLcode res = curl_easy_perform(curl);
     fclose(fp);
+    curl_off_t speed = 0;
+    if (speed_out && res == CURLE_OK && curl_easy_getinfo(curl, CURLINFO_SPEED_DOWNLOAD_T, &speed) == CURLE_OK) *speed_out = speed;
     curl_easy_cleanup(curl);
 
     if (res == CURLE_OK) {
         if (expected_size > 0) {
             struct stat st;
-            if (stat(dest_path.c_str(), &st) == 0 && (size_t)st.st_size != expected_size) {
-                unlink(dest_path.c_str());
+            if (stat(part_path.c_str(), &st) == 0 && (size_t)st.st_size != expected_size) {
+                unlink(part_path.c_str());
                 return false;
             }
         }
+        if (rename(part_path.c_str(), dest_path.c_str()) != 0) {
+            unlink(part_path.c_str());
+            return false;
+        }
         update_progress(pkg_name, 1.0);
         return true;
     }
 
-    unlink(dest_path.c_str());
+    unlink(part_path.c_str());
     return false;
 }
 
-bool decompress_gz(const std::string& src, const std::string& dest) {
-    gzFile src_file = gzopen(src.c_str(), "rb");
-    if (!src_file) return false;
-
-    std::ofstream dest_file(dest, std::ios::binary);
-    if (!dest_file.is_open()) {
-        gzclose(src_file);
-        return false;
-    }
-
-    char buffer[8192];
-    int bytes_read;
-    while ((bytes_read = gzread(src_file, buffer, sizeof(buffer))) > 0) {
-        dest_file.write(buffer, bytes_read);
-    }
+// Index and shard records share the C layout in runepkg_repo_index.h; arch is
+// the row of the index's .archs table, see index_archs().
+typedef RepoIndexEntry IndexEntry;
 
-    gzclose(src_file);
-    dest_file.close();
-    return bytes_read == 0;
+static bool operator<(const IndexEntry& a, const IndexEntry& b) {
+    int c = std::strcmp(a.name, b.name);
+    return c < 0 || (c == 0 && a.arch < b.arch);
 }
 
-struct IndexEntry {
-    char name[64];
-    uint32_t file_id;
-    uint32_t offset;
-
-    bool operator<(const IndexEntry& other) const {
-        return std::strcmp(name, other.name) < 0;
-    }
-};
-
 struct PkgMetadata {
     std::string name;
+    std::string arch;
     std::string url;
     std::string depends;
     std::string filename;
@@ -249,33 +384,366 @@ extern "C" int runepkg_cpp_ffi_available(void) {
     return 1;
 }
 
-std::unordered_map<std::string, std::string> get_latest_versions() {
-    std::unordered_map<std::string, std::string> latest_versions;
-    std::string file_list_path = std::string(g_runepkg_db_dir) + "/repo_files.txt";
-    std::ifstream flist(file_list_path);
-    if (!flist.is_open()) return latest_versions;
+// --- Bounded-memory sorting for update (update_memory_mb) ---
+static size_t update_memory_budget() { return (size_t)g_update_memory_mb << 20; }
 
-    std::vector<std::string> pkg_files;
-    std::string line;
-    while (std::getline(flist, line)) {
-        if (!line.empty()) pkg_files.push_back(line);
+// Temporary files go to the database directory, or TMPDIR when that is read-only.
+static std::string scratch_dir() {
+    if (g_runepkg_db_dir && access(g_runepkg_db_dir, W_OK) == 0) return g_runepkg_db_dir;
+    const char *tmp = getenv("TMPDIR");
+    return tmp && *tmp ? tmp : "/tmp";
+}
+
+static FILE *open_scratch_file(std::string& path) {
+    std::string templ = scratch_dir() + "/.runepkg-scratch.XXXXXX";
+    std::vector<char> buf(templ.begin(), templ.end()); buf.push_back('\0');
+    int fd = mkstemp(buf.data());
+    if (fd < 0) return nullptr;
+    path = buf.data();
+    FILE *fp = fdopen(fd, "w+b");
+    if (!fp) { close(fd); unlink(path.c_str()); }
+    return fp;
+}
+
+// Appends everything written so far to a scratch file onto out.
+static bool copy_scratch(FILE *from, std::ofstream& out) {
+    if (fflush(from) != 0 || fseek(from, 0, SEEK_SET) != 0) return false;
+    char buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), from)) > 0) out.write(buf, n);
+    return !ferror(from) && (bool)out;
+}
+
+// Sorts variable-length byte records. Without a budget it is an in-memory stable
+// sort. With one, records are buffered until the budget is reached, then sorted
+// and spilled to a run file, and finish() k-way merges the runs with a heap,
+// reading each through a buffer of its share of the budget. Either way records
+// that compare equal come out in insertion order.
+class ExternalSorter {
+public:
+    typedef bool (*Less)(std::string_view a, std::string_view b);
+    ExternalSorter(Less less, size_t budget) : less_(less), budget_(budget) {}
+    ~ExternalSorter() { drop_runs(); }
+
+    bool add(std::string_view rec) {
+        if (budget_ && !recs_.empty() && arena_.size() + rec.size() + (recs_.size() + 1) * sizeof(Rec) > budget_ && !spill()) return false;
+        recs_.push_back({arena_.size(), (uint32_t)rec.size()});
+        arena_.append(rec.data(), rec.size());
+        count_++;
+        return true;
     }
-    flist.close();
+    uint64_t count() const { return count_; }
+    size_t spills() const { return spills_; }
 
-    for (const auto& filename : pkg_files) {
-        std::ifstream infile(filename, std::ios::binary);
+    // Calls sink(std::string_view) once per record in sorted order.
+    template <typename Sink>
+    bool finish(Sink sink) {
+        if (runs_.empty()) {
+            sort_buffer();
+            for (const Rec& r : recs_) sink(std::string_view(arena_.data() + r.off, r.len));
+            return true;
+        }
+        if (!recs_.empty() && !spill()) return false;
+        std::string().swap(arena_); std::vector<Rec>().swap(recs_);
+        struct Cursor { FILE *fp; std::string cur; };
+        std::vector<Cursor> cursors;
+        size_t share = std::max<size_t>(16384, budget_ / (runs_.size() + 1));
+        std::vector<std::vector<char>> bufs(runs_.size(), std::vector<char>(share));
+        for (size_t i = 0; i < runs_.size(); i++) {
+            FILE *fp = fopen(runs_[i].c_str(), "rb");
+            if (!fp) { for (auto& c : cursors) fclose(c.fp); return false; }
+            setvbuf(fp, bufs[i].data(), _IOFBF, share);
+            cursors.push_back({fp, std::string()});
+        }
+        auto next = [&cursors](size_t i) {
+            uint32_t len;
+            if (fread(&len, sizeof(len), 1, cursors[i].fp) != 1) return false;
+            cursors[i].cur.resize(len);
+            return len == 0 || fread(&cursors[i].cur[0], 1, len, cursors[i].fp) == len;
+        };
+        // Top of the heap is the smallest record, the earliest run winning ties.
+        auto after = [this, &cursors](size_t a, size_t b) {
+            if (less_(cursors[b].cur, cursors[a].cur)) return true;
+            return !less_(cursors[a].cur, cursors[b].cur) && b < a;
+        };
+        std::priority_queue<size_t, std::vector<size_t>, decltype(after)> heap(after);
+        for (size_t i = 0; i < cursors.size(); i++) if (next(i)) heap.push(i);
+        while (!heap.empty()) {
+            size_t i = heap.top(); heap.pop();
+            sink(std::string_view(cursors[i].cur));
+            if (next(i)) heap.push(i);
+        }
+        for (auto& c : cursors) fclose(c.fp);
+        drop_runs();
+        return true;
+    }
+
+private:
+    struct Rec { size_t off; uint32_t len; };
+
+    void sort_buffer() {
+        const char *base = arena_.data();
+        std::stable_sort(recs_.begin(), recs_.end(), [this, base](const Rec& a, const Rec& b) {
+            return less_(std::string_view(base + a.off, a.len), std::string_view(base + b.off, b.len));
+        });
+    }
+    bool spill() {
+        sort_buffer();
+        std::string path;
+        FILE *fp = open_scratch_file(path);
+        if (!fp) return false;
+        runs_.push_back(path);
+        spills_++;
+        bool ok = true;
+        for (const Rec& r : recs_) {
+            ok = ok && fwrite(&r.len, sizeof(r.len), 1, fp) == 1 && fwrite(arena_.data() + r.off, 1, r.len, fp) == r.len;
+        }
+        if (fclose(fp) != 0) ok = false;
+        arena_.clear(); recs_.clear();
+        return ok;
+    }
+    void drop_runs() {
+        for (const auto& r : runs_) unlink(r.c_str());
+        runs_.clear();
+    }
+
+    Less less_;
+    size_t budget_;
+    std::string arena_;
+    std::vector<Rec> recs_;
+    std::vector<std::string> runs_;
+    uint64_t count_ = 0;
+    size_t spills_ = 0;
+};
+
+struct MappedText {
+    const char *data = nullptr; size_t size = 0;
+    bool open(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) < 0 || st.st_size == 0) { close(fd); return false; }
+        void *m = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0); close(fd);
+        if (m == MAP_FAILED) return false;
+        madvise(m, st.st_size, MADV_SEQUENTIAL);
+        data = (const char*)m; size = st.st_size;
+        return true;
+    }
+    ~MappedText() { if (data) munmap((void*)data, size); }
+};
+
+// --- Compressed list storage ---
+// Lists stay in the gzip form they were downloaded in. Side files for a list
+// live in db/shards/ under the list's file name: <list>.shard and <list>.zidx.
+static std::string list_side_path(const std::string& list_path, const char *ext) {
+    size_t slash = list_path.find_last_of('/');
+    return std::string(g_runepkg_db_dir) + "/shards/" + (slash == std::string::npos ? list_path : list_path.substr(slash + 1)) + ext;
+}
+
+// Sequential line reader over a list. gzread passes uncompressed files through,
+// so lists recorded by older versions (already unpacked) read the same way.
+class ListReader {
+public:
+    explicit ListReader(const std::string& path) : file_(gzopen(path.c_str(), "rb")) { if (file_) gzbuffer(file_, 131072); }
+    ~ListReader() { if (file_) gzclose(file_); }
+    ListReader(const ListReader&) = delete;
+    ListReader& operator=(const ListReader&) = delete;
+    bool is_open() const { return file_ != nullptr; }
+    bool seek(uint64_t offset) { return file_ && gzseek(file_, (z_off_t)offset, SEEK_SET) == (z_off_t)offset; }
+    // Same contract as std::getline: strips the '\n' (a trailing '\r' stays).
+    bool getline(std::string& line) {
+        line.clear();
+        if (!file_) return false;
+        char buf[4096];
+        while (gzgets(file_, buf, sizeof(buf))) {
+            size_t n = strlen(buf);
+            if (n && buf[n - 1] == '\n') { line.append(buf, n - 1); return true; }
+            line.append(buf, n);
+        }
+        return !line.empty();
+    }
+private:
+    gzFile file_;
+};
+
+// zran-style checkpoints for random access into a gzip list (after zlib's
+// examples/zran.c). Roughly every ZRAN_SPAN bytes of output, at a deflate block
+// boundary, the builder records the compressed offset, the bit offset into the
+// preceding byte and the 32 KiB of output the next block may refer back to
+// (stored deflated). A stanza read primes a raw inflater from the nearest
+// checkpoint, so it decompresses at most one span before reaching the stanza.
+// Like a shard, the index is stamped with the size and mtime of the .gz it was
+// built from, and a read of any other file falls back to a scan.
+static const uint32_t ZRAN_MAGIC = 0x4E41525A; // "ZRAN"
+static const uint32_t ZRAN_VERSION = 2;
+static const uint64_t ZRAN_SPAN = 256 * 1024;
+static const uint32_t ZRAN_WINDOW = 32768;
+struct ZranHeader { uint32_t magic, version, count, windows_size; uint64_t list_size, origin_size, origin_mtime_ns; };
+
+static uint64_t stat_mtime_ns(const struct stat& st) { return (uint64_t)st.st_mtim.tv_sec * 1000000000ull + st.st_mtim.tv_nsec; }
+struct ZranPoint { uint64_t out, in; uint32_t bits, window_off, window_len, reserved; };
+
+// Writes the checkpoints for gz_path. Multi-member gzip files are not indexed
+// (reads of them fall back to a scan).
+static bool build_zran_index(const std::string& gz_path, const std::string& zidx_path) {
+    FILE *in = fopen(gz_path.c_str(), "rb");
+    if (!in) return false;
+    struct stat origin;
+    if (fstat(fileno(in), &origin) != 0) { fclose(in); return false; }
+    z_stream strm;
+    std::memset(&strm, 0, sizeof(strm));
+    if (inflateInit2(&strm, 47) != Z_OK) { fclose(in); return false; } // 15-bit window, gzip or zlib header
+    std::vector<ZranPoint> points;
+    std::string windows;
+    std::vector<unsigned char> input(65536), window(ZRAN_WINDOW, 0), ordered(ZRAN_WINDOW);
+    uint64_t totin = 0, totout = 0, last = 0;
+    int ret = Z_OK;
+    strm.avail_out = 0;
+    do {
+        strm.avail_in = fread(input.data(), 1, input.size(), in);
+        if (ferror(in) || strm.avail_in == 0) { ret = Z_DATA_ERROR; break; }
+        strm.next_in = input.data();
+        do {
+            if (strm.avail_out == 0) { strm.avail_out = ZRAN_WINDOW; strm.next_out = window.data(); }
+            totin += strm.avail_in; totout += strm.avail_out;
+            ret = inflate(&strm, Z_BLOCK);
+            totin -= strm.avail_in; totout -= strm.avail_out;
+            if (ret == Z_NEED_DICT || ret == Z_MEM_ERROR || ret == Z_DATA_ERROR) { ret = Z_DATA_ERROR; break; }
+            if (ret == Z_STREAM_END) break;
+            // Bit 7 of data_type: at a block boundary; bit 6: after the last block.
+            if ((strm.data_type & 128) && !(strm.data_type & 64) && (totout == 0 || totout - last > ZRAN_SPAN)) {
+                // The window buffer is circular; unroll it so the oldest byte comes first.
+                size_t left = strm.avail_out;
+                std::memcpy(ordered.data(), window.data() + ZRAN_WINDOW - left, left);
+                std::memcpy(ordered.data() + left, window.data(), ZRAN_WINDOW - left);
+                ZranPoint p = {totout, totin, (uint32_t)(strm.data_type & 7), (uint32_t)windows.size(), 0, 0};
+                if (totout > 0) {
+                    uLongf len = compressBound(ZRAN_WINDOW);
+                    std::string packed(len, '\0');
+                    if (compress2(reinterpret_cast<Bytef*>(&packed[0]), &len, ordered.data(), ZRAN_WINDOW, 6) != Z_OK) { ret = Z_DATA_ERROR; break; }
+                    windows.append(packed.data(), len);
+                    p.window_len = len;
+                }
+                points.push_back(p);
+                last = totout;
+            }
+        } while (strm.avail_in != 0);
+    } while (ret == Z_OK || ret == Z_BUF_ERROR);
+    bool single_member = ret == Z_STREAM_END && strm.avail_in == 0 && fgetc(in) == EOF;
+    inflateEnd(&strm);
+    fclose(in);
+    if (!single_member) { unlink(zidx_path.c_str()); return false; }
+
+    ZranHeader hdr = {ZRAN_MAGIC, ZRAN_VERSION, (uint32_t)points.size(), (uint32_t)windows.size(), totout, (uint64_t)origin.st_size, stat_mtime_ns(origin)};
+    std::string tmp_path = zidx_path + ".tmp";
+    std::ofstream out(tmp_path, std::ios::binary);
+    if (!out.is_open()) return false;
+    out.write(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+    out.write(reinterpret_cast<const char*>(points.data()), points.size() * sizeof(ZranPoint));
+    out.write(windows.data(), windows.size());
+    out.close();
+    if (!out || rename(tmp_path.c_str(), zidx_path.c_str()) != 0) { unlink(tmp_path.c_str()); return false; }
+    return true;
+}
+
+// Appends decompressed text from offset onward to stanza until it holds a whole
+// stanza (a blank line follows) or the list ends.
+static bool zran_read_stanza(const std::string& gz_path, uint64_t offset, std::string& stanza) {
+    MappedText idx;
+    if (!idx.open(list_side_path(gz_path, ".zidx")) || idx.size < sizeof(ZranHeader)) return false;
+    const ZranHeader *hdr = reinterpret_cast<const ZranHeader*>(idx.data);
+    size_t windows_off = sizeof(ZranHeader) + (size_t)hdr->count * sizeof(ZranPoint);
+    if (hdr->magic != ZRAN_MAGIC || hdr->version != ZRAN_VERSION || hdr->count == 0 ||
+        windows_off + hdr->windows_size != idx.size || offset >= hdr->list_size) return false;
+    const ZranPoint *points = reinterpret_cast<const ZranPoint*>(idx.data + sizeof(ZranHeader));
+    const ZranPoint *p = std::upper_bound(points, points + hdr->count, offset, [](uint64_t off, const ZranPoint& pt) { return off < pt.out; });
+    if (p == points) return false;
+    --p;
+    if ((uint64_t)p->window_off + p->window_len > hdr->windows_size) return false;
+
+    FILE *in = fopen(gz_path.c_str(), "rb");
+    if (!in) return false;
+    struct stat origin;
+    if (fstat(fileno(in), &origin) != 0 || (uint64_t)origin.st_size != hdr->origin_size || stat_mtime_ns(origin) != hdr->origin_mtime_ns) { fclose(in); return false; }
+    z_stream strm;
+    std::memset(&strm, 0, sizeof(strm));
+    if (inflateInit2(&strm, -15) != Z_OK) { fclose(in); return false; } // raw deflate
+    bool ok = fseeko(in, (off_t)(p->in - (p->bits ? 1 : 0)), SEEK_SET) == 0;
+    if (ok && p->bits) {
+        int c = getc(in);
+        ok = c != EOF && inflatePrime(&strm, p->bits, c >> (8 - p->bits)) == Z_OK;
+    }
+    if (ok && p->window_len) {
+        std::vector<unsigned char> dict(ZRAN_WINDOW);
+        uLongf dict_len = ZRAN_WINDOW;
+        ok = uncompress(dict.data(), &dict_len, reinterpret_cast<const Bytef*>(idx.data + windows_off + p->window_off), p->window_len) == Z_OK &&
+             dict_len == ZRAN_WINDOW && inflateSetDictionary(&strm, dict.data(), ZRAN_WINDOW) == Z_OK;
+    }
+    uint64_t skip = offset - p->out;
+    size_t start = stanza.size();
+    std::vector<unsigned char> input(16384), output(65536);
+    int ret = Z_OK;
+    while (ok && ret != Z_STREAM_END) {
+        if (strm.avail_in == 0) {
+            strm.avail_in = fread(input.data(), 1, input.size(), in);
+            if (strm.avail_in == 0) break;
+            strm.next_in = input.data();
+        }
+        strm.avail_out = output.size();
+        strm.next_out = output.data();
+        ret = inflate(&strm, Z_NO_FLUSH);
+        if (ret != Z_OK && ret != Z_STREAM_END) { ok = false; break; }
+        size_t have = output.size() - strm.avail_out, from = 0;
+        if (skip) { from = std::min<uint64_t>(skip, have); skip -= from; }
+        if (from == have) continue;
+        size_t scan = std::max(stanza.size(), start + 2) - 2;
+        stanza.append(reinterpret_cast<const char*>(output.data()) + from, have - from);
+        size_t blank = std::min(stanza.find("\n\n", scan), stanza.find("\n\r\n", scan));
+        if (blank != std::string::npos) { stanza.resize(blank + 1); break; }
+    }
+    inflateEnd(&strm);
+    fclose(in);
+    return ok && stanza.size() > start;
+}
+
+// The stanza starting at offset in a list, read through its checkpoints when it
+// has them and by a sequential scan otherwise.
+static std::string read_list_stanza(const std::string& list_path, uint64_t offset) {
+    std::string stanza;
+    if (zran_read_stanza(list_path, offset, stanza)) return stanza;
+    stanza.clear();
+    ListReader reader(list_path);
+    if (!reader.seek(offset)) return stanza;
+    std::string line;
+    while (reader.getline(line) && !line.empty() && line != "\r") stanza.append(line).push_back('\n');
+    return stanza;
+}
+
+// Records whose first field is a NUL-terminated name, ordered by that name.
+static bool name_record_less(std::string_view a, std::string_view b) { return strcmp(a.data(), b.data()) < 0; }
+
+// Collects the Package:/Version: pairs of every stanza in the lists named by a
+// repo_*files.txt, as "name\0version\0" records. Foreign-arch stanzas are left
+// out: upgrades compare against what the native architecture can install.
+static bool collect_name_versions(const std::string& file_list_path, ExternalSorter& sorter) {
+    std::ifstream flist(file_list_path);
+    if (!flist.is_open()) return false;
+    std::string filename, line, rec;
+    while (std::getline(flist, filename)) {
+        if (filename.empty()) continue;
+        ListReader infile(filename);
         if (!infile.is_open()) continue;
         std::string pkg_name, pkg_version;
-        while (std::getline(infile, line)) {
-            if (line.empty() || line == "\r") {
-                if (!pkg_name.empty()) {
-                    if (latest_versions.find(pkg_name) == latest_versions.end() ||
-                        runepkg_util_compare_versions(pkg_version.c_str(), latest_versions[pkg_name].c_str()) > 0) {
-                        latest_versions[pkg_name] = pkg_version;
-                    }
-                    pkg_name.clear();
-                    pkg_version.clear();
+        bool foreign = false, more = true;
+        while (more) {
+            more = infile.getline(line);
+            if (!more || line.empty() || line == "\r") {
+                if (!pkg_name.empty() && !foreign) {
+                    rec.assign(pkg_name).push_back('\0');
+                    rec.append(pkg_version).push_back('\0');
+                    if (!sorter.add(rec)) return false;
                 }
+                pkg_name.clear(); pkg_version.clear(); foreign = false;
                 continue;
             }
             if (line.compare(0, 9, "Package: ") == 0) {
@@ -284,265 +752,1854 @@ std::unordered_map<std::string, std::string> get_latest_versions() {
             } else if (line.compare(0, 9, "Version: ") == 0) {
                 pkg_version = line.substr(9);
                 if (!pkg_version.empty() && pkg_version.back() == '\r') pkg_version.pop_back();
+            } else if (line.compare(0, 14, "Architecture: ") == 0) {
+                std::string_view a(line); a.remove_prefix(14); if (!a.empty() && a.back() == '\r') a.remove_suffix(1);
+                foreign = a != "all" && a != runepkg_config_native_arch();
             }
         }
-        if (!pkg_name.empty()) {
-            if (latest_versions.find(pkg_name) == latest_versions.end() ||
-                runepkg_util_compare_versions(pkg_version.c_str(), latest_versions[pkg_name].c_str()) > 0) {
-                latest_versions[pkg_name] = pkg_version;
+    }
+    return true;
+}
+
+// Split-block Bloom filter written next to each repo index (repo_index.bloom,
+// repo_src_index.bloom). Every name sets one bit in each of the eight words of a
+// single 32-byte block, so a lookup reads one cache line and a definite miss
+// (virtual names, other-arch packages, typos) never touches the index itself.
+static const uint32_t BLOOM_MAGIC = 0x4D4F4C42; // "BLOM"
+static const uint32_t BLOOM_VERSION = 1;
+static const uint32_t BLOOM_BITS_PER_KEY = 16;
+static const uint32_t BLOOM_SALT[8] = {0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU, 0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U};
+struct BloomHeader { uint32_t magic, version, block_count, key_count; };
+struct BloomBlock { uint32_t words[8]; };
+
+static inline uint64_t mix64(uint64_t h) {
+    h ^= h >> 33; h *= 0xff51afd7ed558ccdULL; h ^= h >> 33; h *= 0xc4ceb9fe1a85ec53ULL; h ^= h >> 33;
+    return h;
+}
+
+// Hashes the name as stored in IndexEntry (at most 63 bytes).
+static uint64_t index_name_hash(const char *name) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < sizeof(IndexEntry::name) - 1 && name[i]; i++) { h ^= (unsigned char)name[i]; h *= 0x100000001b3ULL; }
+    return mix64(h);
+}
+static inline uint32_t bloom_block_of(uint64_t h, uint32_t block_count) { return (uint32_t)(((h >> 32) * block_count) >> 32); }
+static inline uint32_t bloom_bit(uint64_t h, int word) { return 1u << (((uint32_t)h * BLOOM_SALT[word]) >> 27); }
+
+// Side files share the index's base name: repo_index.bin -> repo_index.bloom, .mph, .stree
+static std::string index_side_path(const std::string& index_bin_path, const char *ext) {
+    size_t dot = index_bin_path.rfind(".bin");
+    return (dot == std::string::npos ? index_bin_path : index_bin_path.substr(0, dot)) + ext;
+}
+
+static void write_bloom_filter(const IndexEntry *sorted_index, size_t count, const std::string& path) {
+    uint32_t keys = 0;
+    for (size_t i = 0; i < count; i++) if (i == 0 || std::strcmp(sorted_index[i].name, sorted_index[i - 1].name) != 0) keys++;
+    uint32_t block_count = std::max<uint32_t>(1, (uint32_t)(((uint64_t)keys * BLOOM_BITS_PER_KEY + 255) / 256));
+    std::vector<BloomBlock> blocks(block_count, BloomBlock{});
+    for (size_t i = 0; i < count; i++) {
+        uint64_t h = index_name_hash(sorted_index[i].name); BloomBlock& b = blocks[bloom_block_of(h, block_count)];
+        for (int w = 0; w < 8; w++) b.words[w] |= bloom_bit(h, w);
+    }
+    BloomHeader hdr = {BLOOM_MAGIC, BLOOM_VERSION, block_count, keys};
+    unlink(path.c_str());
+    std::string tmp_path = path + ".tmp";
+    std::ofstream out(tmp_path, std::ios::binary);
+    if (!out.is_open()) return;
+    out.write(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+    out.write(reinterpret_cast<const char*>(blocks.data()), blocks.size() * sizeof(BloomBlock));
+    out.close();
+    if (!out || rename(tmp_path.c_str(), path.c_str()) != 0) unlink(tmp_path.c_str());
+}
+
+struct BloomFilterMap {
+    void *map = MAP_FAILED; size_t map_size = 0;
+    const BloomBlock *blocks = nullptr; uint32_t block_count = 0;
+
+    BloomFilterMap() = default;
+    BloomFilterMap(const BloomFilterMap&) = delete;
+    BloomFilterMap& operator=(const BloomFilterMap&) = delete;
+    ~BloomFilterMap() { if (map != MAP_FAILED) munmap(map, map_size); }
+
+    bool open(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(BloomHeader)) { close(fd); return false; }
+        map_size = st.st_size;
+        map = mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (map == MAP_FAILED) return false;
+        const BloomHeader *hdr = static_cast<const BloomHeader*>(map);
+        if (hdr->magic != BLOOM_MAGIC || hdr->version != BLOOM_VERSION || hdr->block_count == 0 ||
+            sizeof(BloomHeader) + (size_t)hdr->block_count * sizeof(BloomBlock) != map_size) return false;
+        blocks = reinterpret_cast<const BloomBlock*>(static_cast<const char*>(map) + sizeof(BloomHeader));
+        block_count = hdr->block_count;
+        return true;
+    }
+    // False only when the name is definitely absent; a missing filter answers true.
+    bool may_contain(const char *name) const {
+        if (!blocks) return true;
+        uint64_t h = index_name_hash(name); const BloomBlock& b = blocks[bloom_block_of(h, block_count)];
+        for (int w = 0; w < 8; w++) if (!(b.words[w] & bloom_bit(h, w))) return false;
+        return true;
+    }
+};
+
+// Minimal perfect hash (PTHash style) over every distinct index name, written as
+// repo_index.mph / repo_src_index.mph. Names are split into buckets; each bucket
+// stores a pilot chosen at build time so that (hash ^ mix(pilot)) % n sends its
+// names to free slots, filling all n slots exactly once. A slot holds the record
+// id of the name's first entry in the sorted index plus a 32-bit fingerprint, so
+// an exact lookup reads one pilot and one slot instead of ~17 binary-search probes.
+static const uint32_t MPH_MAGIC = 0x4850504D; // "MPPH"
+static const uint32_t MPH_VERSION = 1;
+static const uint32_t MPH_NONE = 0xFFFFFFFFu;
+struct MphHeader { uint32_t magic, version, key_count, bucket_count; uint64_t seed; };
+struct MphSlot { uint32_t record, fingerprint; };
+
+static inline uint64_t mph_key(uint64_t name_hash, uint64_t seed) { return mix64(name_hash ^ seed); }
+static inline uint32_t mph_bucket_of(uint64_t k, uint32_t bucket_count) { return (uint32_t)(((k >> 32) * bucket_count) >> 32); }
+static inline uint32_t mph_slot_of(uint64_t k, uint32_t pilot, uint32_t n) { return (uint32_t)((k ^ mix64((uint64_t)pilot + 1)) % n); }
+static inline uint32_t mph_fingerprint(uint64_t name_hash) { return (uint32_t)mix64(name_hash ^ 0x9e3779b97f4a7c15ULL); }
+
+static void write_perfect_hash(const IndexEntry *sorted_index, size_t count, const std::string& path) {
+    std::vector<std::pair<uint64_t, uint32_t>> keys; // (name hash, first record id)
+    for (size_t i = 0; i < count; i++) {
+        if (i == 0 || std::strcmp(sorted_index[i].name, sorted_index[i - 1].name) != 0) keys.push_back({index_name_hash(sorted_index[i].name), (uint32_t)i});
+    }
+    unlink(path.c_str());
+    uint32_t n = keys.size();
+    if (n == 0) return;
+    uint32_t log2n = 1; while ((1ull << log2n) < n) log2n++;
+    uint32_t bucket_count = std::max<uint32_t>(1, (uint32_t)((5ull * n + log2n - 1) / log2n));
+    uint64_t max_tries = std::min<uint64_t>(0xFFFFFFFEull, std::max<uint64_t>(1u << 20, 64ull * n));
+
+    std::vector<uint32_t> pilots(bucket_count), bucket_start(bucket_count + 1), order(n), by_size(bucket_count);
+    std::vector<uint64_t> khash(n);
+    std::vector<uint8_t> taken(n);
+    std::vector<uint32_t> slots;
+    for (uint32_t attempt = 0; attempt < 8; attempt++) {
+        uint64_t seed = mix64(0x52554E45ull + attempt);
+        // Group keys by bucket, then place the largest buckets first while the table is empty.
+        std::fill(bucket_start.begin(), bucket_start.end(), 0);
+        for (uint32_t i = 0; i < n; i++) { khash[i] = mph_key(keys[i].first, seed); bucket_start[mph_bucket_of(khash[i], bucket_count) + 1]++; }
+        for (uint32_t b = 0; b < bucket_count; b++) bucket_start[b + 1] += bucket_start[b];
+        std::vector<uint32_t> fill(bucket_start.begin(), bucket_start.end() - 1);
+        for (uint32_t i = 0; i < n; i++) order[fill[mph_bucket_of(khash[i], bucket_count)]++] = i;
+        for (uint32_t b = 0; b < bucket_count; b++) by_size[b] = b;
+        std::stable_sort(by_size.begin(), by_size.end(), [&](uint32_t a, uint32_t b) { return bucket_start[a + 1] - bucket_start[a] > bucket_start[b + 1] - bucket_start[b]; });
+        std::fill(taken.begin(), taken.end(), 0);
+        bool placed_all = true;
+        for (uint32_t b : by_size) {
+            uint32_t begin = bucket_start[b], end = bucket_start[b + 1];
+            if (begin == end) break;
+            bool placed = false;
+            for (uint64_t pilot = 0; pilot < max_tries && !placed; pilot++) {
+                slots.clear();
+                bool ok = true;
+                for (uint32_t j = begin; j < end && ok; j++) {
+                    uint32_t s = mph_slot_of(khash[order[j]], (uint32_t)pilot, n);
+                    if (taken[s] || std::find(slots.begin(), slots.end(), s) != slots.end()) ok = false;
+                    else slots.push_back(s);
+                }
+                if (!ok) continue;
+                for (uint32_t s : slots) taken[s] = 1;
+                pilots[b] = (uint32_t)pilot;
+                placed = true;
             }
+            if (!placed) { placed_all = false; break; }
+        }
+        if (!placed_all) continue;
+
+        std::vector<MphSlot> table(n);
+        for (uint32_t i = 0; i < n; i++) {
+            uint32_t s = mph_slot_of(khash[i], pilots[mph_bucket_of(khash[i], bucket_count)], n);
+            table[s] = {keys[i].second, mph_fingerprint(keys[i].first)};
         }
+        MphHeader hdr = {MPH_MAGIC, MPH_VERSION, n, bucket_count, seed};
+        std::string tmp_path = path + ".tmp";
+        std::ofstream out(tmp_path, std::ios::binary);
+        if (!out.is_open()) return;
+        out.write(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+        out.write(reinterpret_cast<const char*>(pilots.data()), pilots.size() * sizeof(uint32_t));
+        out.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(MphSlot));
+        out.close();
+        if (!out || rename(tmp_path.c_str(), path.c_str()) != 0) unlink(tmp_path.c_str());
+        return;
     }
-    return latest_versions;
+    // No seed worked (only possible with colliding 64-bit name hashes): lookups fall back to binary search.
 }
 
-void build_index(const std::vector<std::string>& pkg_files, const std::string& index_bin_path, const std::string& file_list_path) {
-    std::vector<IndexEntry> index;
-    std::vector<std::string> file_list;
-    for (size_t f_idx = 0; f_idx < pkg_files.size(); f_idx++) {
-        std::ifstream infile(pkg_files[f_idx], std::ios::binary);
-        if (!infile.is_open()) continue;
-        file_list.push_back(pkg_files[f_idx]);
-        uint32_t current_file_id = file_list.size() - 1;
-        std::string line;
-        uint32_t current_offset = 0, stanza_offset = 0;
-        std::string pkg_name, provides_list;
-        while (std::getline(infile, line)) {
-            size_t len = line.length() + 1;
-            if (line.empty() || line == "\r") {
-                if (!pkg_name.empty()) {
-                    IndexEntry entry;
-                    std::strncpy(entry.name, pkg_name.c_str(), 63);
-                    entry.name[63] = '\0';
-                    entry.file_id = current_file_id;
-                    entry.offset = stanza_offset;
-                    index.push_back(entry);
-                    if (!provides_list.empty()) {
-                        std::stringstream ss(provides_list);
-                        std::string virt_pkg;
-                        while (std::getline(ss, virt_pkg, ',')) {
-                            virt_pkg.erase(0, virt_pkg.find_first_not_of(" \t"));
-                            virt_pkg.erase(virt_pkg.find_last_not_of(" \t") + 1);
-                            if (!virt_pkg.empty()) {
-                                IndexEntry v_entry;
-                                std::strncpy(v_entry.name, virt_pkg.c_str(), 63);
-                                v_entry.name[63] = '\0';
-                                v_entry.file_id = current_file_id;
-                                v_entry.offset = stanza_offset;
-                                index.push_back(v_entry);
-                            }
-                        }
+struct PerfectHashMap {
+    void *map = MAP_FAILED; size_t map_size = 0;
+    const MphHeader *hdr = nullptr; const uint32_t *pilots = nullptr; const MphSlot *slots = nullptr;
+
+    PerfectHashMap() = default;
+    PerfectHashMap(const PerfectHashMap&) = delete;
+    PerfectHashMap& operator=(const PerfectHashMap&) = delete;
+    ~PerfectHashMap() { if (map != MAP_FAILED) munmap(map, map_size); }
+
+    bool open(const std::string& path, uint32_t record_count) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(MphHeader)) { close(fd); return false; }
+        map_size = st.st_size;
+        map = mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (map == MAP_FAILED) return false;
+        const MphHeader *h = static_cast<const MphHeader*>(map);
+        if (h->magic != MPH_MAGIC || h->version != MPH_VERSION || h->key_count == 0 || h->key_count > record_count || h->bucket_count == 0 ||
+            sizeof(MphHeader) + (size_t)h->bucket_count * sizeof(uint32_t) + (size_t)h->key_count * sizeof(MphSlot) != map_size) return false;
+        pilots = reinterpret_cast<const uint32_t*>(static_cast<const char*>(map) + sizeof(MphHeader));
+        slots = reinterpret_cast<const MphSlot*>(pilots + h->bucket_count);
+        hdr = h;
+        return true;
+    }
+    // Record id of the name's first index entry, or MPH_NONE when the fingerprint rules it out.
+    uint32_t lookup(uint64_t name_hash) const {
+        uint64_t k = mph_key(name_hash, hdr->seed);
+        const MphSlot& slot = slots[mph_slot_of(k, pilots[mph_bucket_of(k, hdr->bucket_count)], hdr->key_count)];
+        return slot.fingerprint == mph_fingerprint(name_hash) ? slot.record : MPH_NONE;
+    }
+};
+
+// The arch column of both repo indexes: row 0 is the native architecture, row 1
+// "all", then the other configured ones. Entries of one name sort by it, so a
+// plain-name lookup lands on the native (or arch-independent) package and a
+// qualified one scans only that name's few rows. Stanzas of any other
+// Architecture (Sources' "any", "linux-any", ...) are filed as "all".
+static const uint16_t INDEX_ARCH_ALL = 1;
+
+static const std::vector<std::string>& index_archs() {
+    static const std::vector<std::string> table = [] {
+        std::vector<std::string> t = {runepkg_config_native_arch(), "all"};
+        for (int i = 0; i < g_architectures_count; i++)
+            if (std::find(t.begin(), t.end(), g_architectures[i]) == t.end()) t.push_back(g_architectures[i]);
+        return t;
+    }();
+    return table;
+}
+
+static uint16_t index_arch_id(std::string_view arch) {
+    const std::vector<std::string>& t = index_archs();
+    for (size_t i = 0; i < t.size(); i++) if (t[i] == arch) return (uint16_t)i;
+    return INDEX_ARCH_ALL;
+}
+
+// Shards record which table their ids refer to, so changing architectures= rebuilds them.
+static uint32_t index_archs_stamp() {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (const auto& a : index_archs()) { for (unsigned char c : a) { h ^= c; h *= 0x100000001b3ULL; } h ^= ' '; h *= 0x100000001b3ULL; }
+    return (uint32_t)(h ^ (h >> 32));
+}
+
+// Shard records are IndexEntry images ordered by (name, arch).
+static bool index_record_less(std::string_view a, std::string_view b) {
+    int c = strcmp(a.data(), b.data());
+    if (c != 0) return c < 0;
+    uint16_t arch_a, arch_b;
+    std::memcpy(&arch_a, a.data() + offsetof(IndexEntry, arch), sizeof(arch_a));
+    std::memcpy(&arch_b, b.data() + offsetof(IndexEntry, arch), sizeof(arch_b));
+    return arch_a < arch_b;
+}
+
+// A mapped repo index together with its file list, arch table, Bloom filter and perfect hash.
+// Views are opened once per process; update drops them after rebuilding.
+struct RepoIndexView {
+    void *map = MAP_FAILED; size_t map_size = 0;
+    const IndexEntry *entries = nullptr; uint32_t count = 0;
+    std::vector<std::string> files, archs;
+    BloomFilterMap bloom;
+    PerfectHashMap mph;
+
+    RepoIndexView() = default;
+    RepoIndexView(const RepoIndexView&) = delete;
+    RepoIndexView& operator=(const RepoIndexView&) = delete;
+    ~RepoIndexView() { if (map != MAP_FAILED) munmap(map, map_size); }
+
+    bool open(const std::string& index_path, const std::string& file_list_path) {
+        int fd = ::open(index_path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(uint32_t)) { close(fd); return false; }
+        map_size = st.st_size;
+        map = mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (map == MAP_FAILED) return false;
+        entries = runepkg_repo_index_entries(map, map_size, &count);
+        if (!entries) return false;
+        std::ifstream flist(file_list_path); std::string line;
+        while (std::getline(flist, line)) files.push_back(line);
+        std::ifstream alist(index_side_path(index_path, ".archs"));
+        while (std::getline(alist, line)) archs.push_back(line);
+        bloom.open(index_side_path(index_path, ".bloom"));
+        mph.open(index_side_path(index_path, ".mph"), count);
+        return true;
+    }
+    // The name's first entry, of whatever architecture (its rows sort native, all, foreign).
+    const IndexEntry *find(const char *name) const {
+        if (!entries || !bloom.may_contain(name)) return nullptr;
+        if (mph.hdr) {
+            uint32_t record = mph.lookup(index_name_hash(name));
+            return (record != MPH_NONE && std::strcmp(entries[record].name, name) == 0) ? &entries[record] : nullptr;
+        }
+        IndexEntry target; std::memset(&target, 0, sizeof(target)); std::strncpy(target.name, name, sizeof(target.name) - 1);
+        const IndexEntry *it = std::lower_bound(entries, entries + count, target);
+        return (it != entries + count && std::strcmp(it->name, name) == 0) ? it : nullptr;
+    }
+    // The entry of (name, arch), else the name's arch-independent one.
+    const IndexEntry *find(const char *name, const std::string& arch) const {
+        const IndexEntry *it = find(name), *fallback = nullptr;
+        for (; it && it != entries + count && std::strcmp(it->name, name) == 0; it++) {
+            if (it->arch < archs.size() && archs[it->arch] == arch) return it;
+            if (!fallback && it->arch == INDEX_ARCH_ALL) fallback = it;
+        }
+        return fallback;
+    }
+    // What a plain name means: the native package, else the arch-independent
+    // one. A name that only exists for a foreign arch needs "name:arch".
+    const IndexEntry *find_native(const char *name) const {
+        const IndexEntry *it = find(name);
+        return it && it->arch <= INDEX_ARCH_ALL ? it : nullptr;
+    }
+    const char *arch_of(const IndexEntry *e) const { return e->arch < archs.size() ? archs[e->arch].c_str() : ""; }
+};
+
+static std::mutex g_repo_views_mutex;
+static std::map<std::string, RepoIndexView> g_repo_views;
+
+static const RepoIndexView& repo_index_view(bool is_source) {
+    std::string index_path = std::string(g_runepkg_db_dir) + (is_source ? "/repo_src_index.bin" : "/repo_index.bin");
+    std::lock_guard<std::mutex> lock(g_repo_views_mutex);
+    auto it = g_repo_views.find(index_path);
+    if (it == g_repo_views.end()) {
+        it = g_repo_views.try_emplace(index_path).first;
+        it->second.open(index_path, std::string(g_runepkg_db_dir) + (is_source ? "/repo_src_files.txt" : "/repo_files.txt"));
+    }
+    return it->second;
+}
+
+static void drop_repo_views() {
+    std::lock_guard<std::mutex> lock(g_repo_views_mutex);
+    g_repo_views.clear();
+}
+
+static const char *index_entry_name(const void *ctx, uint32_t i) { return static_cast<const IndexEntry*>(ctx)[i].name; }
+
+// --- Per-list index shards ---
+// Every Packages/Sources list gets its own sorted shard in db/shards/, named
+// after the list. A shard is stamped with the size and mtime of the downloaded
+// file it came from, so update only reparses lists that actually changed; its
+// entry offsets are positions in the uncompressed text. repo_index.bin stays
+// the merged top-level directory, produced by a k-way merge of the shards, so
+// readers are unchanged.
+static const uint32_t SHARD_MAGIC = 0x44524853; // "SHRD"
+static const uint32_t SHARD_VERSION = 4; // 4: reparse once so every .zidx is rebuilt stamped
+struct ShardHeader { uint32_t magic, version, count, arch_stamp; uint64_t origin_size, origin_mtime_ns, list_size; };
+
+static std::string index_shard_path(const std::string& list_path) { return list_side_path(list_path, ".shard"); }
+
+static bool shard_stamp(const std::string& list_path, ShardHeader& stamp) {
+    struct stat origin;
+    if (stat(list_path.c_str(), &origin) != 0) return false;
+    std::memset(&stamp, 0, sizeof(stamp));
+    stamp.magic = SHARD_MAGIC;
+    stamp.version = SHARD_VERSION;
+    stamp.arch_stamp = index_archs_stamp();
+    stamp.origin_size = origin.st_size;
+    stamp.origin_mtime_ns = stat_mtime_ns(origin);
+    return true;
+}
+
+// True when the list's shard was built from exactly this download.
+static bool index_shard_current(const std::string& list_path) {
+    ShardHeader want, have;
+    if (!shard_stamp(list_path, want)) return false;
+    std::ifstream in(index_shard_path(list_path), std::ios::binary);
+    if (!in.read(reinterpret_cast<char*>(&have), sizeof(have))) return false;
+    in.seekg(0, std::ios::end);
+    return have.magic == want.magic && have.version == want.version && have.arch_stamp == want.arch_stamp && have.origin_size == want.origin_size &&
+           have.origin_mtime_ns == want.origin_mtime_ns &&
+           (uint64_t)in.tellg() == sizeof(ShardHeader) + (uint64_t)have.count * sizeof(IndexEntry);
+}
+
+// Parses one list into a sorted shard (file ids are left 0; the merge assigns
+// them) and, for a gzip list, writes its random-access checkpoints.
+static bool build_index_shard(const std::string& list_path) {
+    ListReader infile(list_path);
+    ShardHeader hdr;
+    if (!infile.is_open() || !shard_stamp(list_path, hdr)) return false;
+    ExternalSorter sorter(index_record_less, update_memory_budget());
+    bool ok = true;
+    uint16_t arch = INDEX_ARCH_ALL;
+    auto add_entry = [&sorter, &ok, &arch](const std::string& name, uint32_t offset) {
+        IndexEntry entry;
+        std::memset(&entry, 0, sizeof(entry));
+        std::strncpy(entry.name, name.c_str(), 63);
+        entry.offset = offset;
+        entry.arch = arch;
+        ok = sorter.add(std::string_view(reinterpret_cast<const char*>(&entry), sizeof(entry))) && ok;
+    };
+    std::string line;
+    uint32_t current_offset = 0, stanza_offset = 0;
+    std::string pkg_name, provides_list;
+    while (infile.getline(line)) {
+        size_t len = line.length() + 1;
+        if (line.empty() || line == "\r") {
+            if (!pkg_name.empty()) {
+                add_entry(pkg_name, stanza_offset);
+                if (!provides_list.empty()) {
+                    std::stringstream ss(provides_list);
+                    std::string virt_pkg;
+                    while (std::getline(ss, virt_pkg, ',')) {
+                        virt_pkg.erase(0, virt_pkg.find_first_not_of(" \t"));
+                        virt_pkg.erase(virt_pkg.find_last_not_of(" \t") + 1);
+                        if (!virt_pkg.empty()) add_entry(virt_pkg, stanza_offset);
                     }
-                    pkg_name.clear(); provides_list.clear();
                 }
-                stanza_offset = current_offset + len;
-            } else if (line.compare(0, 9, "Package: ") == 0) {
-                pkg_name = line.substr(9); if (!pkg_name.empty() && pkg_name.back() == '\r') pkg_name.pop_back();
-            } else if (line.compare(0, 10, "Provides: ") == 0) {
-                provides_list = line.substr(10); if (!provides_list.empty() && provides_list.back() == '\r') provides_list.pop_back();
+                pkg_name.clear(); provides_list.clear();
             }
-            current_offset += len;
+            arch = INDEX_ARCH_ALL;
+            stanza_offset = current_offset + len;
+        } else if (line.compare(0, 9, "Package: ") == 0) {
+            pkg_name = line.substr(9); if (!pkg_name.empty() && pkg_name.back() == '\r') pkg_name.pop_back();
+        } else if (line.compare(0, 10, "Provides: ") == 0) {
+            provides_list = line.substr(10); if (!provides_list.empty() && provides_list.back() == '\r') provides_list.pop_back();
+        } else if (line.compare(0, 14, "Architecture: ") == 0) {
+            std::string_view a(line); a.remove_prefix(14); if (!a.empty() && a.back() == '\r') a.remove_suffix(1);
+            arch = index_arch_id(a);
         }
-        if (!pkg_name.empty()) {
-            IndexEntry entry;
-            std::strncpy(entry.name, pkg_name.c_str(), 63);
-            entry.name[63] = '\0';
-            entry.file_id = current_file_id;
-            entry.offset = stanza_offset;
-            index.push_back(entry);
+        current_offset += len;
+    }
+    if (!pkg_name.empty()) add_entry(pkg_name, stanza_offset);
+    hdr.list_size = current_offset;
+
+    if (list_path.size() > 3 && list_path.compare(list_path.size() - 3, 3, ".gz") == 0 && !build_zran_index(list_path, list_side_path(list_path, ".zidx")))
+        std::cerr << "Warning: No random-access checkpoints for " << list_path << "; lookups will scan it." << std::endl;
+
+    std::string shard_path = index_shard_path(list_path), tmp_path = shard_path + ".tmp";
+    std::ofstream out(tmp_path, std::ios::binary);
+    if (!out.is_open()) return false;
+    hdr.count = sorter.count();
+    out.write(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+    ok = sorter.finish([&out](std::string_view rec) { out.write(rec.data(), rec.size()); }) && ok;
+    out.close();
+    if (!ok || !out || rename(tmp_path.c_str(), shard_path.c_str()) != 0) { unlink(tmp_path.c_str()); return false; }
+    if (g_verbose_mode && sorter.spills()) std::cout << "  " << shard_path << ": merged " << sorter.count() << " entries from " << sorter.spills() << " sorted runs" << std::endl;
+    return true;
+}
+
+// Removes shards whose list is no longer configured.
+static void prune_index_shards(const std::unordered_set<std::string>& live) {
+    std::string dir = std::string(g_runepkg_db_dir) + "/shards";
+    DIR *d = opendir(dir.c_str());
+    if (!d) return;
+    while (struct dirent *e = readdir(d)) {
+        std::string path = dir + "/" + e->d_name;
+        if (e->d_name[0] != '.' && live.find(path) == live.end()) unlink(path.c_str());
+    }
+    closedir(d);
+}
+
+// True when index_bin_path exists with the current header and layout, so an
+// index written by an older runepkg is rebuilt even if no list changed.
+static bool repo_index_readable(const std::string& index_bin_path) {
+    MappedText index; uint32_t count;
+    return index.open(index_bin_path) && runepkg_repo_index_entries(index.data, index.size, &count) != nullptr;
+}
+
+// Brings every shard up to date, then merges them into index_bin_path (file ids
+// become each list's line in file_list_path) and rebuilds the side files. Shards
+// still current are reused, and when none changed and the file list is the same
+// the existing top-level index is kept as is. Returns true if it was rewritten.
+bool build_index(const std::vector<std::string>& lists, const std::string& index_bin_path, const std::string& file_list_path,
+                 std::unordered_set<std::string>& live_shards) {
+    runepkg_util_create_dir_recursive((std::string(g_runepkg_db_dir) + "/shards").c_str(), 0755);
+    std::vector<std::string> file_list;
+    size_t rebuilt = 0;
+    for (const auto& list : lists) {
+        if (!index_shard_current(list)) {
+            if (!build_index_shard(list)) { std::cerr << "Warning: Failed to index " << list << std::endl; continue; }
+            rebuilt++;
         }
+        file_list.push_back(list);
+        live_shards.insert(index_shard_path(list));
+        live_shards.insert(list_side_path(list, ".zidx"));
     }
-    std::sort(index.begin(), index.end());
-    std::ofstream out_index(index_bin_path, std::ios::binary);
-    if (out_index.is_open()) {
-        uint32_t count = index.size();
-        out_index.write(reinterpret_cast<const char*>(&count), sizeof(count));
-        out_index.write(reinterpret_cast<const char*>(index.data()), index.size() * sizeof(IndexEntry));
-        out_index.close();
+    if (g_verbose_mode) std::cout << "  " << index_bin_path << ": " << rebuilt << " shard(s) rebuilt, " << file_list.size() - rebuilt << " reused" << std::endl;
+
+    std::vector<std::string> previous;
+    std::ifstream prev_files(file_list_path);
+    for (std::string line; std::getline(prev_files, line);) if (!line.empty()) previous.push_back(line);
+    if (rebuilt == 0 && previous == file_list && repo_index_readable(index_bin_path)) return false;
+
+    std::vector<MappedText> shards(file_list.size());
+    std::vector<const IndexEntry*> pos(file_list.size()), end(file_list.size());
+    uint64_t total = 0;
+    for (size_t i = 0; i < file_list.size(); i++) {
+        if (!shards[i].open(index_shard_path(file_list[i])) || shards[i].size < sizeof(ShardHeader)) continue;
+        const ShardHeader *hdr = reinterpret_cast<const ShardHeader*>(shards[i].data);
+        if (sizeof(ShardHeader) + (uint64_t)hdr->count * sizeof(IndexEntry) != shards[i].size) continue;
+        pos[i] = reinterpret_cast<const IndexEntry*>(shards[i].data + sizeof(ShardHeader));
+        end[i] = pos[i] + hdr->count;
+        total += hdr->count;
+    }
+    // Within a name the arch column orders entries; earlier lists win the
+    // remaining ties, matching a stable sort over the lists in order.
+    auto after = [&pos](size_t a, size_t b) {
+        int c = std::strcmp(pos[a]->name, pos[b]->name);
+        if (c == 0 && pos[a]->arch != pos[b]->arch) return pos[a]->arch > pos[b]->arch;
+        return c > 0 || (c == 0 && a > b);
+    };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(after)> heap(after);
+    for (size_t i = 0; i < file_list.size(); i++) if (pos[i] != end[i]) heap.push(i);
+    std::string tmp_path = index_bin_path + ".tmp";
+    std::ofstream out_index(tmp_path, std::ios::binary);
+    uint32_t count = total;
+    RepoIndexHeader index_hdr{RUNEPKG_REPO_INDEX_MAGIC, RUNEPKG_REPO_INDEX_VERSION, sizeof(IndexEntry), count};
+    out_index.write(reinterpret_cast<const char*>(&index_hdr), sizeof(index_hdr));
+    std::vector<IndexEntry> chunk;
+    chunk.reserve(4096);
+    while (!heap.empty()) {
+        size_t i = heap.top(); heap.pop();
+        IndexEntry e = *pos[i]++;
+        e.file_id = i;
+        chunk.push_back(e);
+        if (chunk.size() == chunk.capacity()) { out_index.write(reinterpret_cast<const char*>(chunk.data()), chunk.size() * sizeof(IndexEntry)); chunk.clear(); }
+        if (pos[i] != end[i]) heap.push(i);
+    }
+    out_index.write(reinterpret_cast<const char*>(chunk.data()), chunk.size() * sizeof(IndexEntry));
+    out_index.close();
+    // A filter left over from the previous index would answer "absent" for new
+    // names, so drop both before the new index goes live; the writers below
+    // recreate them, and readers treat a missing one as "may contain".
+    unlink(index_side_path(index_bin_path, ".bloom").c_str());
+    unlink(index_side_path(index_bin_path, ".mph").c_str());
+    if (!out_index || rename(tmp_path.c_str(), index_bin_path.c_str()) != 0) {
+        unlink(tmp_path.c_str());
+        std::cerr << "Warning: Failed to write " << index_bin_path << std::endl;
+        return false;
     }
     std::ofstream out_files(file_list_path);
-    if (out_files.is_open()) {
-        for (const auto& f : file_list) out_files << f << "\n";
-        out_files.close();
+    for (const auto& f : file_list) out_files << f << "\n";
+    out_files.close();
+    std::ofstream out_archs(index_side_path(index_bin_path, ".archs"));
+    for (const auto& a : index_archs()) out_archs << a << "\n";
+    out_archs.close();
+
+    // The side files are built from the written index through a read-only mapping,
+    // so the entries are never held in anonymous memory.
+    MappedText index;
+    uint32_t mapped_count = 0;
+    const IndexEntry *entries = index.open(index_bin_path) ? runepkg_repo_index_entries(index.data, index.size, &mapped_count) : nullptr;
+    if (!entries || mapped_count != count) return true;
+    write_bloom_filter(entries, count, index_side_path(index_bin_path, ".bloom"));
+    write_perfect_hash(entries, count, index_side_path(index_bin_path, ".mph"));
+    if (runepkg_stree_write(index_side_path(index_bin_path, ".stree").c_str(), index_entry_name, entries, count, index.size) != 0)
+        std::cerr << "Warning: Failed to write prefix search tree for " << index_bin_path << std::endl;
+    return true;
+}
+
+// --- Contents index (path -> package) ---
+// Layout of repo_contents.bin: header, package name table (sorted, offsets + blob),
+// then two front-coded sections. The forward section holds the sorted paths with
+// their package ids; the reverse section holds the byte-reversed paths with the
+// forward path id so that "ends with" lookups become prefix scans. Every
+// CONTENTS_BLOCK entries a block restarts with a full key, and a block offset
+// table lets lookups binary-search block heads and decode at most one block.
+const uint32_t CONTENTS_MAGIC = 0x544E4352; // "RCNT"
+const uint32_t CONTENTS_VERSION = 1;
+const uint32_t CONTENTS_BLOCK = 16;
+
+struct ContentsHeader {
+    uint32_t magic, version, path_count, pkg_count, block_size, fwd_blocks, rev_blocks, reserved;
+    uint64_t pkg_table_off, fwd_table_off, fwd_data_off, rev_table_off, rev_data_off, file_size;
+};
+
+static void put_varint(std::string& out, uint64_t v) {
+    while (v >= 0x80) { out.push_back((char)((v & 0x7F) | 0x80)); v >>= 7; }
+    out.push_back((char)v);
+}
+
+static uint64_t get_varint(const unsigned char *&p, const unsigned char *end) {
+    uint64_t v = 0; int shift = 0;
+    while (p < end && shift < 64) { unsigned char b = *p++; v |= (uint64_t)(b & 0x7F) << shift; if (!(b & 0x80)) break; shift += 7; }
+    return v;
+}
+
+// Front-codes keys fed in sorted order into CONTENTS_BLOCK-entry blocks. The
+// encoded bytes are staged in a scratch file, so only the block offset table
+// stays in memory.
+struct FrontCoder {
+    FILE *fp = nullptr; std::string path, buf, prev; uint64_t written = 0, n = 0; std::vector<uint64_t> blocks; bool ok = true;
+
+    FrontCoder() = default;
+    FrontCoder(const FrontCoder&) = delete;
+    FrontCoder& operator=(const FrontCoder&) = delete;
+    ~FrontCoder() { if (fp) { fclose(fp); unlink(path.c_str()); } }
+
+    bool open() { fp = open_scratch_file(path); return fp != nullptr; }
+    // payload is the per-entry column that follows the key.
+    void add(std::string_view k, std::string_view payload) {
+        if (n++ % CONTENTS_BLOCK == 0) { blocks.push_back(written + buf.size()); put_varint(buf, k.size()); buf.append(k.data(), k.size()); }
+        else {
+            size_t shared = 0, lim = std::min(prev.size(), k.size());
+            while (shared < lim && prev[shared] == k[shared]) shared++;
+            put_varint(buf, shared); put_varint(buf, k.size() - shared); buf.append(k.data() + shared, k.size() - shared);
+        }
+        buf.append(payload.data(), payload.size()); prev.assign(k.data(), k.size());
+        if (buf.size() >= 65536) flush();
+    }
+    bool flush() {
+        if (!buf.empty()) { ok = ok && fwrite(buf.data(), 1, buf.size(), fp) == buf.size(); written += buf.size(); buf.clear(); }
+        return ok;
+    }
+    uint64_t size() const { return written + buf.size(); }
+};
+
+// Free-text preamble of legacy Contents files is at most this many lines long.
+static const size_t CONTENTS_PREAMBLE_MAX = 256;
+
+// Every (path, package) pair goes through an ExternalSorter as "path\0" plus a
+// 32-bit package id, and the byte-reversed paths through a second one, each with
+// half of update_memory_mb. Both front-coded sections are staged in scratch
+// files, so only the package name table and the block offsets stay resident.
+bool build_contents_index(const std::vector<std::string>& contents_files, const std::string& index_path) {
+    size_t budget = update_memory_budget() / 2;
+    ExternalSorter paths(name_record_less, budget), reversed(name_record_less, budget);
+    std::unordered_map<std::string, uint32_t> pkg_ids; std::vector<std::string> pkg_names;
+    std::string rec;
+    auto add_line = [&](const std::string& line) {
+        size_t sep = line.find_last_of(" \t");
+        if (sep == std::string::npos) return true;
+        size_t path_end = line.find_last_not_of(" \t", sep);
+        if (path_end == std::string::npos) return true;
+        size_t path_start = (line[0] == '/') ? 1 : 0;
+        rec.assign(line, path_start, path_end + 1 - path_start).push_back('\0');
+        size_t key_len = rec.size(), pos = sep + 1;
+        while (pos <= line.size()) {
+            size_t comma = line.find(',', pos); if (comma == std::string::npos) comma = line.size();
+            std::string loc = line.substr(pos, comma - pos); size_t slash = loc.find_last_of('/');
+            std::string name = (slash == std::string::npos) ? loc : loc.substr(slash + 1);
+            if (!name.empty()) {
+                auto it = pkg_ids.find(name);
+                uint32_t id = (it != pkg_ids.end()) ? it->second : (pkg_ids[name] = pkg_names.size(), pkg_names.push_back(name), (uint32_t)pkg_names.size() - 1);
+                rec.resize(key_len); rec.append(reinterpret_cast<const char*>(&id), sizeof(id));
+                if (!paths.add(rec)) return false;
+            }
+            pos = comma + 1;
+        }
+        return true;
+    };
+    for (const auto& file : contents_files) {
+        gzFile gz = gzopen(file.c_str(), "rb");
+        if (!gz) continue;
+        gzbuffer(gz, 1 << 17);
+        // Lines are held back until the file shows whether it opens with a preamble.
+        std::vector<std::string> pending; bool ok = true;
+        char buf[8192]; std::string line;
+        while (ok && gzgets(gz, buf, sizeof(buf))) {
+            line += buf;
+            if (line.empty() || line.back() != '\n') continue;
+            line.pop_back(); if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (pending.size() < CONTENTS_PREAMBLE_MAX) {
+                // Legacy Contents files carry a free-text preamble ending in a "FILE  LOCATION" header.
+                if (line.compare(0, 4, "FILE") == 0 && line.find("LOCATION") != std::string::npos) pending.assign(CONTENTS_PREAMBLE_MAX, std::string());
+                else pending.push_back(line);
+                line.clear();
+                continue;
+            }
+            ok = add_line(line); line.clear();
+        }
+        gzclose(gz);
+        for (size_t i = 0; ok && i < pending.size(); i++) ok = pending[i].empty() || add_line(pending[i]);
+        if (!ok) return false;
     }
+    if (paths.count() == 0) return false;
+
+    // Package table is sorted by name; remap the provisional ids assigned while parsing.
+    std::vector<uint32_t> order(pkg_names.size()), remap(pkg_names.size());
+    for (uint32_t i = 0; i < order.size(); i++) order[i] = i;
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return pkg_names[a] < pkg_names[b]; });
+    for (uint32_t i = 0; i < order.size(); i++) remap[order[i]] = i;
+
+    // Duplicate paths from several components (or packages) merge into one entry.
+    FrontCoder fwd, rev;
+    if (!fwd.open() || !rev.open()) return false;
+    uint32_t path_count = 0; bool ok = true;
+    std::string cur, payload; std::vector<uint32_t> ids;
+    auto emit = [&]() {
+        std::sort(ids.begin(), ids.end()); ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+        payload.clear(); put_varint(payload, ids.size()); for (uint32_t id : ids) put_varint(payload, id);
+        fwd.add(cur, payload);
+        rec.assign(cur.rbegin(), cur.rend()).push_back('\0');
+        rec.append(reinterpret_cast<const char*>(&path_count), sizeof(path_count));
+        ok = ok && reversed.add(rec);
+        path_count++;
+    };
+    ok = paths.finish([&](std::string_view r) {
+        size_t len = strlen(r.data()); uint32_t id; std::memcpy(&id, r.data() + len + 1, sizeof(id));
+        if (!ids.empty() && cur.size() == len && std::memcmp(cur.data(), r.data(), len) == 0) { ids.push_back(remap[id]); return; }
+        if (!ids.empty()) emit();
+        cur.assign(r.data(), len); ids.assign(1, remap[id]);
+    }) && ok;
+    if (ok && !ids.empty()) emit();
+    ok = ok && reversed.finish([&](std::string_view r) {
+        size_t len = strlen(r.data()); uint32_t id; std::memcpy(&id, r.data() + len + 1, sizeof(id));
+        payload.clear(); put_varint(payload, id);
+        rev.add(std::string_view(r.data(), len), payload);
+    });
+    if (!ok || !fwd.flush() || !rev.flush()) return false;
+
+    std::string pkg_blob; std::vector<uint32_t> pkg_offsets;
+    for (uint32_t idx : order) { pkg_offsets.push_back(pkg_blob.size()); pkg_blob += pkg_names[idx]; pkg_blob.push_back('\0'); }
+
+    ContentsHeader hdr{};
+    hdr.magic = CONTENTS_MAGIC; hdr.version = CONTENTS_VERSION; hdr.path_count = path_count; hdr.pkg_count = pkg_names.size();
+    hdr.block_size = CONTENTS_BLOCK; hdr.fwd_blocks = fwd.blocks.size(); hdr.rev_blocks = rev.blocks.size();
+    hdr.pkg_table_off = sizeof(hdr);
+    hdr.fwd_table_off = hdr.pkg_table_off + pkg_offsets.size() * sizeof(uint32_t) + pkg_blob.size();
+    hdr.fwd_table_off = (hdr.fwd_table_off + 7) & ~(uint64_t)7;
+    hdr.fwd_data_off = hdr.fwd_table_off + fwd.blocks.size() * sizeof(uint64_t);
+    hdr.rev_table_off = (hdr.fwd_data_off + fwd.size() + 7) & ~(uint64_t)7;
+    hdr.rev_data_off = hdr.rev_table_off + rev.blocks.size() * sizeof(uint64_t);
+    hdr.file_size = hdr.rev_data_off + rev.size();
+
+    std::string tmp_path = index_path + ".tmp";
+    std::ofstream out(tmp_path, std::ios::binary);
+    if (!out.is_open()) return false;
+    auto pad_to = [&out](uint64_t off) { while ((uint64_t)out.tellp() < off) out.put('\0'); };
+    out.write(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+    out.write(reinterpret_cast<const char*>(pkg_offsets.data()), pkg_offsets.size() * sizeof(uint32_t));
+    out.write(pkg_blob.data(), pkg_blob.size());
+    pad_to(hdr.fwd_table_off);
+    out.write(reinterpret_cast<const char*>(fwd.blocks.data()), fwd.blocks.size() * sizeof(uint64_t));
+    ok = copy_scratch(fwd.fp, out);
+    pad_to(hdr.rev_table_off);
+    out.write(reinterpret_cast<const char*>(rev.blocks.data()), rev.blocks.size() * sizeof(uint64_t));
+    ok = ok && copy_scratch(rev.fp, out);
+    out.close();
+    if (!ok || !out || rename(tmp_path.c_str(), index_path.c_str()) != 0) { unlink(tmp_path.c_str()); return false; }
+    std::cout << "  Contents index: " << hdr.path_count << " paths, " << hdr.pkg_count << " packages." << std::endl;
+    return true;
+}
+
+// repo_versions.bin: the newest repo version of every package, sorted by name.
+// Layout is a small header, a fixed-size entry array and a NUL-terminated string
+// blob, so upgrade planning can mmap it and walk it in order without rescanning
+// the Packages lists.
+static const uint32_t REPO_VERSIONS_MAGIC = 0x52455652; // "RVER"
+struct RepoVersionsHeader { uint32_t magic, count, strings_size, reserved; };
+struct RepoVersionEntry { uint32_t name_off, ver_off; };
+
+// Derives the table from the binary lists named in repo_files.txt, keeping the
+// newest version of every name. The (name, version) pairs go through an
+// ExternalSorter and the string blob is staged in a scratch file, so only the
+// fixed-size entry array is held in memory. Returns the number of packages
+// written, or -1 on failure.
+static long build_repo_versions(const std::string& path) {
+    ExternalSorter sorter(name_record_less, update_memory_budget());
+    if (!collect_name_versions(std::string(g_runepkg_db_dir) + "/repo_files.txt", sorter)) return -1;
+    std::string strings_path;
+    FILE *strings = open_scratch_file(strings_path);
+    if (!strings) return -1;
+    std::vector<RepoVersionEntry> entries;
+    uint32_t strings_size = 0;
+    std::string name, best;
+    auto put = [&](const std::string& s) { uint32_t off = strings_size; fwrite(s.c_str(), 1, s.size() + 1, strings); strings_size += s.size() + 1; return off; };
+    auto emit = [&]() { RepoVersionEntry e; e.name_off = put(name); e.ver_off = put(best); entries.push_back(e); };
+    bool ok = sorter.finish([&](std::string_view rec) {
+        const char *n = rec.data(), *v = n + strlen(n) + 1;
+        if (!name.empty() && name == n) {
+            if (runepkg_util_compare_versions(v, best.c_str()) > 0) best = v;
+            return;
+        }
+        if (!name.empty()) emit();
+        name = n; best = v;
+    });
+    if (ok && !name.empty()) emit();
+
+    RepoVersionsHeader hdr = {REPO_VERSIONS_MAGIC, (uint32_t)entries.size(), strings_size, 0};
+    std::string tmp_path = path + ".tmp";
+    std::ofstream out(tmp_path, std::ios::binary);
+    if (ok && out.is_open()) {
+        out.write(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+        out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(RepoVersionEntry));
+        ok = copy_scratch(strings, out);
+        out.close();
+    } else {
+        ok = false;
+    }
+    fclose(strings);
+    unlink(strings_path.c_str());
+    if (!ok || !out || rename(tmp_path.c_str(), path.c_str()) != 0) { unlink(tmp_path.c_str()); return -1; }
+    return (long)entries.size();
+}
+
+struct RepoVersionTable {
+    void *map = MAP_FAILED; size_t map_size = 0;
+    const RepoVersionEntry *entries = nullptr; const char *strings = nullptr; uint32_t count = 0;
+
+    bool open(const std::string& path) {
+        if (map != MAP_FAILED) { munmap(map, map_size); map = MAP_FAILED; count = 0; }
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(RepoVersionsHeader)) { close(fd); return false; }
+        map_size = st.st_size;
+        map = mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (map == MAP_FAILED) return false;
+        const RepoVersionsHeader *hdr = static_cast<const RepoVersionsHeader*>(map);
+        size_t strings_off = sizeof(RepoVersionsHeader) + (size_t)hdr->count * sizeof(RepoVersionEntry);
+        if (hdr->magic != REPO_VERSIONS_MAGIC || strings_off + hdr->strings_size != map_size ||
+            (hdr->strings_size > 0 && static_cast<const char*>(map)[map_size - 1] != '\0')) return false;
+        entries = reinterpret_cast<const RepoVersionEntry*>(static_cast<const char*>(map) + sizeof(RepoVersionsHeader));
+        strings = static_cast<const char*>(map) + strings_off;
+        for (uint32_t i = 0; i < hdr->count; i++) {
+            if (entries[i].name_off >= hdr->strings_size || entries[i].ver_off >= hdr->strings_size) return false;
+        }
+        count = hdr->count;
+        return true;
+    }
+    const char *name(uint32_t i) const { return strings + entries[i].name_off; }
+    const char *version(uint32_t i) const { return strings + entries[i].ver_off; }
+    ~RepoVersionTable() { if (map != MAP_FAILED) munmap(map, map_size); }
+};
+
+// Opens repo_versions.bin, deriving it once from the Packages lists when the
+// indexes predate it. Fails when no repository data is available at all.
+static bool load_repo_versions(RepoVersionTable& table) {
+    std::string path = std::string(g_runepkg_db_dir) + "/repo_versions.bin";
+    if (table.open(path)) return true;
+    return build_repo_versions(path) > 0 && table.open(path);
+}
+
+struct PlanEntry { const char *name, *installed, *candidate; };
+struct UpgradePlan { std::vector<PlanEntry> upgradable, held, downgradable, obsolete; };
+
+// Merge-joins the installed packages (sorted by name), the repo version table and
+// the hold list in one linear pass. Entries point into the hash table and the
+// mapped table, so both must outlive the plan.
+static void plan_upgrades(const RepoVersionTable& repo, UpgradePlan& plan) {
+    std::vector<const PkgInfo*> installed;
+    if (runepkg_main_hash_table) {
+        installed.reserve(runepkg_main_hash_table->count);
+        for (size_t i = 0; i < runepkg_main_hash_table->size; i++) {
+            for (runepkg_hash_node_t *node = runepkg_main_hash_table->buckets[i]; node; node = node->next) {
+                if (node->data.package_name && node->data.version) installed.push_back(&node->data);
+            }
+        }
+    }
+    std::sort(installed.begin(), installed.end(), [](const PkgInfo *a, const PkgInfo *b) { return strcmp(a->package_name, b->package_name) < 0; });
+    int hold_count = 0;
+    char **holds = runepkg_storage_load_holds(&hold_count);
+    for (auto *set : {&plan.upgradable, &plan.held, &plan.downgradable, &plan.obsolete}) { set->clear(); set->reserve(installed.size()); }
+
+    uint32_t r = 0; int h = 0;
+    for (const PkgInfo *pkg : installed) {
+        const char *name = pkg->package_name;
+        while (r < repo.count && strcmp(repo.name(r), name) < 0) r++;
+        while (h < hold_count && strcmp(holds[h], name) < 0) h++;
+        if (r == repo.count || strcmp(repo.name(r), name) != 0) { plan.obsolete.push_back({name, pkg->version, nullptr}); continue; }
+        int cmp = runepkg_util_compare_versions(repo.version(r), pkg->version);
+        if (cmp == 0) continue;
+        PlanEntry e = {name, pkg->version, repo.version(r)};
+        if (h < hold_count && strcmp(holds[h], name) == 0) plan.held.push_back(e);
+        else if (cmp > 0) plan.upgradable.push_back(e);
+        else plan.downgradable.push_back(e);
+    }
+    runepkg_storage_free_holds(holds, hold_count);
+}
+
+// Case-insensitive substring search over raw Packages text. The needle is lowered
+// once and the haystack is read in place, never copied or folded. Sixteen start
+// positions are filtered at a time by comparing the needle's first and last bytes
+// at their offsets (with ASCII case folded by OR-ing 0x20); only positions where
+// both agree are verified byte by byte.
+static inline unsigned char ascii_lower(unsigned char c) { return (c >= 'A' && c <= 'Z') ? (unsigned char)(c | 0x20) : c; }
+
+static inline bool ci_equal(const char *hay, const char *needle_lower, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (ascii_lower((unsigned char)hay[i]) != (unsigned char)needle_lower[i]) return false;
+    }
+    return true;
+}
+
+static const char *ci_find(const char *hay, size_t n, const std::string& needle_lower) {
+    const char *nd = needle_lower.data();
+    size_t m = needle_lower.size();
+    if (m == 0) return hay;
+    if (m > n) return nullptr;
+    size_t i = 0;
+    // OR-ing 0x20 also merges a few non-letters ('@' with '`', '[' with '{'); the
+    // exact check below rejects those, the filter only has to never miss.
+#if defined(__SSE2__)
+    const __m128i fold = _mm_set1_epi8(0x20);
+    const __m128i first = _mm_set1_epi8((char)(nd[0] | 0x20));
+    const __m128i last = _mm_set1_epi8((char)(nd[m - 1] | 0x20));
+    for (; i + m - 1 + 16 <= n; i += 16) {
+        __m128i a = _mm_or_si128(_mm_loadu_si128((const __m128i*)(hay + i)), fold);
+        __m128i b = _mm_or_si128(_mm_loadu_si128((const __m128i*)(hay + i + m - 1)), fold);
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+        while (mask) {
+            size_t j = i + __builtin_ctz(mask);
+            if (ci_equal(hay + j, nd, m)) return hay + j;
+            mask &= mask - 1;
+        }
+    }
+#elif defined(__ARM_NEON)
+    const uint8x16_t fold = vdupq_n_u8(0x20);
+    const uint8x16_t first = vdupq_n_u8((uint8_t)(nd[0] | 0x20));
+    const uint8x16_t last = vdupq_n_u8((uint8_t)(nd[m - 1] | 0x20));
+    for (; i + m - 1 + 16 <= n; i += 16) {
+        uint8x16_t a = vorrq_u8(vld1q_u8((const uint8_t*)(hay + i)), fold);
+        uint8x16_t b = vorrq_u8(vld1q_u8((const uint8_t*)(hay + i + m - 1)), fold);
+        uint8x16_t eq = vandq_u8(vceqq_u8(a, first), vceqq_u8(b, last));
+        // Narrow each byte lane to a nibble so the 16 results fit one 64-bit mask.
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+        while (mask) {
+            int bit = __builtin_ctzll(mask);
+            size_t j = i + (bit >> 2);
+            if (ci_equal(hay + j, nd, m)) return hay + j;
+            mask &= ~(0xFULL << (bit & ~3));
+        }
+    }
+#endif
+    for (; i + m <= n; i++) {
+        if (ci_equal(hay + i, nd, m)) return hay + i;
+    }
+    return nullptr;
+}
+
+// desc is the synopsis (first Description line); long_desc spans its
+// continuation lines, raw, including the " ." paragraph separators.
+struct StanzaFields { std::string_view name, version, arch, desc, provides, long_desc; };
+
+static void parse_stanza(const char *s, const char *e, StanzaFields& f) {
+    bool in_desc = false;
+    while (s < e) {
+        const char *nl = (const char*)memchr(s, '\n', e - s);
+        std::string_view line(s, (nl ? nl : e) - s);
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        s = nl ? nl + 1 : e;
+        if (in_desc && !line.empty() && (line[0] == ' ' || line[0] == '\t')) {
+            // Continuation lines are contiguous in the buffer, so one view covers them all.
+            const char *from = f.long_desc.empty() ? line.data() : f.long_desc.data();
+            f.long_desc = std::string_view(from, line.data() + line.size() - from);
+            continue;
+        }
+        in_desc = false;
+        if (line.compare(0, 9, "Package: ") == 0) f.name = line.substr(9);
+        else if (line.compare(0, 9, "Version: ") == 0) f.version = line.substr(9);
+        else if (line.compare(0, 14, "Architecture: ") == 0) f.arch = line.substr(14);
+        else if (line.compare(0, 13, "Description: ") == 0) { f.desc = line.substr(13); in_desc = true; }
+        else if (line.compare(0, 10, "Provides: ") == 0) f.provides = line.substr(10);
+    }
+}
+
+// Search tokens are maximal runs of ASCII letters and digits, lower-cased, so
+// "libfoo-dev" yields "libfoo" and "dev".
+template <typename Fn>
+static void for_each_token(std::string_view text, Fn fn) {
+    std::string tok;
+    for (size_t i = 0; i <= text.size(); i++) {
+        if (i < text.size() && isalnum((unsigned char)text[i])) { tok += (char)ascii_lower((unsigned char)text[i]); continue; }
+        if (!tok.empty()) { fn(tok); tok.clear(); }
+    }
+}
+
+// repo_search.bin: an inverted index over the newest stanza of every binary
+// package. A document has two fields: the short one (name, synopsis, Provides)
+// and the extended description. The term dictionary is sorted so a query word
+// expands to every token it prefixes. Each posting list is a run of varints, a
+// doc id gap followed by (long tf << 3 | short tf, capped at 7), which keeps
+// typical postings at two bytes. Layout: header, document table, term table,
+// postings blob, then a NUL-terminated string blob.
+static const uint32_t SEARCH_MAGIC = 0x48435253; // "SRCH"
+static const uint32_t SEARCH_VERSION = 2;
+static const uint32_t SEARCH_SHORT_TF_MAX = 7;
+// A short-field occurrence counts this many times an extended-description one,
+// in term frequencies and in document lengths alike.
+static const uint32_t SEARCH_SHORT_WEIGHT = 3;
+struct SearchHeader { uint32_t magic, version, doc_count, term_count, postings_size, strings_size, short_weight, reserved; uint64_t total_length; };
+struct SearchDoc { uint32_t name_off, version_off, arch_off, desc_off, length; };
+struct SearchTerm { uint32_t text_off, postings_off, doc_freq; };
+
+// Builds the index in two external sorts so the memory budget holds: stanzas
+// sorted by name (keeping the newest version of each) become documents in name
+// order, and their (term, doc, tf) records sorted by term become the posting
+// lists. Strings and postings are staged in scratch files; only the fixed-size
+// document and term tables stay in memory.
+static bool build_search_index(const std::vector<std::string>& pkg_files, const std::string& path) {
+    size_t budget = update_memory_budget();
+    ExternalSorter stanzas(name_record_less, budget);
+    std::string rec;
+    bool ok = true;
+    std::string stanza, line;
+    for (const auto& filename : pkg_files) {
+        ListReader reader(filename);
+        if (!reader.is_open()) continue;
+        bool more = true;
+        while (more && ok) {
+            more = reader.getline(line);
+            if (more && !line.empty() && line != "\r") { stanza.append(line).push_back('\n'); continue; }
+            if (stanza.empty()) continue;
+            StanzaFields f;
+            parse_stanza(stanza.data(), stanza.data() + stanza.size(), f);
+            if (!f.name.empty()) {
+                rec.clear();
+                for (std::string_view field : {f.name, f.version, f.arch, f.desc, f.provides, f.long_desc}) rec.append(field.data(), field.size()).push_back('\0');
+                ok = stanzas.add(rec);
+            }
+            stanza.clear();
+        }
+    }
+
+    std::string strings_path, postings_path;
+    FILE *strings = open_scratch_file(strings_path);
+    FILE *postings = strings ? open_scratch_file(postings_path) : nullptr;
+    if (!strings || !postings) {
+        if (strings) { fclose(strings); unlink(strings_path.c_str()); }
+        return false;
+    }
+    uint32_t strings_size = 0;
+    auto add_string = [&](std::string_view s) { uint32_t off = strings_size; fwrite(s.data(), 1, s.size(), strings); fputc('\0', strings); strings_size += s.size() + 1; return off; };
+
+    std::vector<SearchDoc> docs;
+    ExternalSorter term_records(name_record_less, budget);
+    uint64_t total_length = 0;
+    std::vector<std::pair<std::string, bool>> toks; // (token, from the extended description)
+    auto emit_doc = [&](const std::string& r) {
+        std::string_view field[6];
+        const char *p = r.data();
+        for (auto& v : field) { v = std::string_view(p); p += v.size() + 1; }
+        uint32_t doc_id = docs.size();
+        SearchDoc d;
+        d.name_off = add_string(field[0]);
+        d.version_off = add_string(field[1]);
+        d.arch_off = add_string(field[2]);
+        d.desc_off = add_string(field[3]);
+        toks.clear();
+        for (int i : {0, 3, 4}) for_each_token(field[i], [&toks](const std::string& t) { toks.emplace_back(t, false); });
+        size_t short_count = toks.size();
+        for_each_token(field[5], [&toks](const std::string& t) { toks.emplace_back(t, true); });
+        d.length = SEARCH_SHORT_WEIGHT * short_count + (toks.size() - short_count);
+        total_length += d.length;
+        docs.push_back(d);
+        std::sort(toks.begin(), toks.end());
+        std::string term_rec;
+        for (size_t i = 0; i < toks.size();) {
+            size_t j = i;
+            uint32_t tf_short = 0, tf_long = 0;
+            for (; j < toks.size() && toks[j].first == toks[i].first; j++) (toks[j].second ? tf_long : tf_short)++;
+            uint32_t packed = tf_long << 3 | std::min(tf_short, SEARCH_SHORT_TF_MAX);
+            term_rec.assign(toks[i].first).push_back('\0');
+            term_rec.append(reinterpret_cast<const char*>(&doc_id), sizeof(doc_id));
+            term_rec.append(reinterpret_cast<const char*>(&packed), sizeof(packed));
+            ok = term_records.add(term_rec) && ok;
+            i = j;
+        }
+    };
+    std::string best;
+    ok = stanzas.finish([&](std::string_view r) {
+        const char *version = r.data() + strlen(r.data()) + 1;
+        if (!best.empty() && strcmp(best.c_str(), r.data()) == 0) {
+            if (runepkg_util_compare_versions(version, best.c_str() + strlen(best.c_str()) + 1) > 0) best.assign(r.data(), r.size());
+            return;
+        }
+        if (!best.empty()) emit_doc(best);
+        best.assign(r.data(), r.size());
+    }) && ok;
+    if (!best.empty()) emit_doc(best);
+
+    // Records arrive grouped by term and, the sort being stable, in doc order.
+    std::vector<SearchTerm> terms;
+    std::string term, bytes;
+    uint32_t postings_size = 0, last_doc = 0, doc_freq = 0;
+    auto flush_term = [&]() {
+        if (term.empty()) return;
+        terms.push_back({add_string(term), postings_size, doc_freq});
+        fwrite(bytes.data(), 1, bytes.size(), postings);
+        postings_size += bytes.size();
+    };
+    ok = term_records.finish([&](std::string_view r) {
+        uint32_t doc, packed;
+        size_t len = strlen(r.data());
+        memcpy(&doc, r.data() + len + 1, sizeof(doc));
+        memcpy(&packed, r.data() + len + 1 + sizeof(doc), sizeof(packed));
+        if (term.compare(0, std::string::npos, r.data(), len) != 0) {
+            flush_term();
+            term.assign(r.data(), len); bytes.clear(); last_doc = 0; doc_freq = 0;
+        }
+        put_varint(bytes, doc - last_doc);
+        put_varint(bytes, packed);
+        last_doc = doc;
+        doc_freq++;
+    }) && ok;
+    flush_term();
+
+    SearchHeader hdr = {SEARCH_MAGIC, SEARCH_VERSION, (uint32_t)docs.size(), (uint32_t)terms.size(), postings_size, strings_size, SEARCH_SHORT_WEIGHT, 0, total_length};
+    std::string tmp_path = path + ".tmp";
+    std::ofstream out(tmp_path, std::ios::binary);
+    if (ok && out.is_open()) {
+        out.write(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+        out.write(reinterpret_cast<const char*>(docs.data()), docs.size() * sizeof(SearchDoc));
+        out.write(reinterpret_cast<const char*>(terms.data()), terms.size() * sizeof(SearchTerm));
+        ok = copy_scratch(postings, out) && copy_scratch(strings, out);
+        out.close();
+    } else {
+        ok = false;
+    }
+    fclose(strings); unlink(strings_path.c_str());
+    fclose(postings); unlink(postings_path.c_str());
+    if (!ok || !out || rename(tmp_path.c_str(), path.c_str()) != 0) { unlink(tmp_path.c_str()); return false; }
+    return true;
+}
+
+struct SearchIndex {
+    void *map = MAP_FAILED; size_t map_size = 0;
+    const SearchHeader *hdr = nullptr; const SearchDoc *docs = nullptr; const SearchTerm *terms = nullptr;
+    const unsigned char *postings = nullptr; const char *strings = nullptr;
+
+    bool attach(const char *base, size_t size) {
+        if (size < sizeof(SearchHeader)) return false;
+        const SearchHeader *h = reinterpret_cast<const SearchHeader*>(base);
+        size_t docs_off = sizeof(SearchHeader);
+        size_t terms_off = docs_off + (size_t)h->doc_count * sizeof(SearchDoc);
+        size_t postings_off = terms_off + (size_t)h->term_count * sizeof(SearchTerm);
+        size_t strings_off = postings_off + h->postings_size;
+        if (h->magic != SEARCH_MAGIC || h->version != SEARCH_VERSION || strings_off + h->strings_size != size ||
+            (h->strings_size > 0 && base[size - 1] != '\0')) return false;
+        const SearchDoc *d = reinterpret_cast<const SearchDoc*>(base + docs_off);
+        const SearchTerm *t = reinterpret_cast<const SearchTerm*>(base + terms_off);
+        for (uint32_t i = 0; i < h->doc_count; i++) {
+            if (d[i].name_off >= h->strings_size || d[i].version_off >= h->strings_size ||
+                d[i].arch_off >= h->strings_size || d[i].desc_off >= h->strings_size) return false;
+        }
+        for (uint32_t i = 0; i < h->term_count; i++) {
+            if (t[i].text_off >= h->strings_size || t[i].postings_off > h->postings_size) return false;
+        }
+        hdr = h; docs = d; terms = t;
+        postings = reinterpret_cast<const unsigned char*>(base + postings_off);
+        strings = base + strings_off;
+        return true;
+    }
+    bool open(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(SearchHeader)) { close(fd); return false; }
+        map_size = st.st_size;
+        map = mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (map == MAP_FAILED) return false;
+        if (attach(static_cast<const char*>(map), map_size)) return true;
+        munmap(map, map_size); map = MAP_FAILED;
+        return false;
+    }
+    const char *str(uint32_t off) const { return strings + off; }
+    ~SearchIndex() { if (map != MAP_FAILED) munmap(map, map_size); }
+};
+
+// Opens repo_search.bin, deriving it from the cached Packages lists when the
+// indexes predate it. If the database directory is not writable the index is
+// built in the scratch directory for this run only (the mapping outlives the
+// unlinked file).
+static bool load_search_index(SearchIndex& idx) {
+    std::string path = std::string(g_runepkg_db_dir) + "/repo_search.bin";
+    if (idx.open(path)) return true;
+    std::ifstream flist(std::string(g_runepkg_db_dir) + "/repo_files.txt");
+    if (!flist.is_open()) return false;
+    std::vector<std::string> pkg_files; std::string line;
+    while (std::getline(flist, line)) {
+        if (!line.empty()) pkg_files.push_back(line);
+    }
+    if (access(g_runepkg_db_dir, W_OK) == 0) return build_search_index(pkg_files, path) && idx.open(path);
+    path = scratch_dir() + "/.runepkg-search." + std::to_string(getpid());
+    bool ok = build_search_index(pkg_files, path) && idx.open(path);
+    unlink(path.c_str());
+    return ok;
+}
+
+// --- Release files and list variants ---
+// update first reads each suite's InRelease (or Release) to learn which
+// compressed variants of every list the mirror publishes, with their SHA256 and
+// size. Per list it then fetches the variant that should be ready soonest at the
+// measured link speed: .xz is smaller but has to be unpacked and deflated again
+// (lists are kept as gzip for random access), so it only pays off on slow links.
+// When the Release sets Acquire-By-Hash the file comes from by-hash/SHA256/<hash>,
+// a URL proxies can cache indefinitely and that cannot change while the mirror
+// syncs. Every fetched file is checked against its Release hash, and the hash is
+// kept in <list>.sha256 so an unchanged list is not fetched again.
+static const double XZ_DECODE_RATE = 80e6;  // Unpacked bytes per second through xz -d
+static const double GZ_ENCODE_RATE = 40e6;  // Unpacked bytes per second through gzwrite
+static const uint64_t LINK_SAMPLE_MIN = 64 * 1024; // Smaller transfers mostly measure latency
+
+struct ReleaseFile { std::string sha256; uint64_t size = 0; };
+struct ReleaseInfo {
+    bool by_hash = false;
+    double probe_speed = 0; // Bytes per second seen fetching the Release itself
+    std::unordered_map<std::string, ReleaseFile> files; // Keyed by path under dists/<suite>/
+};
+
+// One list to fetch: task downloads into task.dest_path, which is list_path
+// itself when the list is current or a .part file to check (and transcode).
+struct ListFetch {
+    DownloadTask task;
+    std::string list_path;
+    std::string source_url;
+    std::string sha256;
+    bool transcode = false;
+    double speed = 0;
+};
+
+static std::string list_cache_path(const std::string& url) {
+    std::string safe_url = url;
+    std::replace(safe_url.begin(), safe_url.end(), '/', '_');
+    std::replace(safe_url.begin(), safe_url.end(), ':', '_');
+    return std::string(g_runepkg_lists_dir) + "/" + safe_url;
+}
+
+static bool parse_release(const std::string& path, ReleaseInfo& info) {
+    std::ifstream in(path);
+    if (!in.is_open()) return false;
+    std::string line;
+    bool in_sha256 = false;
+    while (std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.compare(0, 29, "-----BEGIN PGP SIGNATURE-----") == 0) break;
+        if (!line.empty() && line[0] == ' ') {
+            std::istringstream ss(line);
+            ReleaseFile f; std::string name;
+            if (in_sha256 && ss >> f.sha256 >> f.size >> name && f.sha256.size() == 64) info.files[name] = f;
+            continue;
+        }
+        in_sha256 = line == "SHA256:";
+        if (line.compare(0, 16, "Acquire-By-Hash:") == 0) info.by_hash = line.find("yes") != std::string::npos;
+    }
+    return !info.files.empty();
+}
+
+// Fetches InRelease, or Release when there is none, for every dists/<suite> URL.
+static std::map<std::string, ReleaseInfo> fetch_release_files(const std::vector<std::string>& dists_urls) {
+    { std::lock_guard<std::mutex> lock(g_progress_mutex); g_finished_count = 0; g_completed_names.clear(); g_active_downloads.clear(); g_total_to_download = dists_urls.size(); }
+    std::vector<std::future<ReleaseInfo>> futures;
+    for (const auto& dists_url : dists_urls) {
+        futures.push_back(std::async(std::launch::async, [dists_url]() {
+            ReleaseInfo info;
+            std::string display_name = dists_url.substr(dists_url.find("/dists/") + 7) + "/Release";
+            for (const char *name : {"/InRelease", "/Release"}) {
+                std::string dest = list_cache_path(dists_url + name);
+                unlink(dest.c_str()); // Always refreshed; it decides what else is
+                info = ReleaseInfo();
+                if (download_file(dists_url + name, dest, 0, display_name, &info.probe_speed) && parse_release(dest, info)) return info;
+            }
+            return ReleaseInfo();
+        }));
+    }
+    std::map<std::string, ReleaseInfo> releases;
+    for (size_t i = 0; i < dists_urls.size(); i++) {
+        ReleaseInfo info = futures[i].get();
+        if (!info.files.empty()) releases[dists_urls[i]] = std::move(info);
+    }
+    return releases;
+}
+
+static std::string link_speeds_path() { return std::string(g_runepkg_db_dir) + "/repo_link_speeds.txt"; }
+
+// Source URL -> bytes per second, as measured by earlier updates.
+static std::map<std::string, double> load_link_speeds() {
+    std::map<std::string, double> speeds;
+    std::ifstream in(link_speeds_path());
+    std::string url; double speed;
+    while (in >> url >> speed) if (speed > 0) speeds[url] = speed;
+    return speeds;
+}
+
+// Folds this run's list transfers into the stored per-source speeds.
+static void save_link_speeds(std::map<std::string, double> speeds, const std::vector<ListFetch*>& fetches) {
+    std::map<std::string, std::pair<double, int>> samples;
+    for (const auto *f : fetches) {
+        if (f->speed > 0 && f->task.size >= LINK_SAMPLE_MIN) { samples[f->source_url].first += f->speed; samples[f->source_url].second++; }
+    }
+    if (samples.empty()) return;
+    for (const auto& s : samples) {
+        double measured = s.second.first / s.second.second;
+        auto it = speeds.find(s.first);
+        speeds[s.first] = it == speeds.end() ? measured : (it->second + measured) / 2;
+    }
+    std::ofstream out(link_speeds_path());
+    for (const auto& s : speeds) out << s.first << " " << (uint64_t)s.second << "\n";
+}
+
+static bool xz_available() {
+    static const bool available = [] {
+        const char *path = getenv("PATH");
+        std::stringstream ss(path ? path : "/usr/bin:/bin");
+        std::string dir;
+        while (std::getline(ss, dir, ':')) if (!dir.empty() && access((dir + "/xz").c_str(), X_OK) == 0) return true;
+        return false;
+    }();
+    return available;
+}
+
+// Hex digests of data under each of mds, computed in one pass over the bytes.
+class MultiDigest {
+public:
+    explicit MultiDigest(const std::vector<const EVP_MD*>& mds) {
+        for (const EVP_MD *md : mds) {
+            EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+            if (!ctx || EVP_DigestInit_ex(ctx, md, nullptr) != 1) ok_ = false;
+            ctxs_.push_back(ctx);
+        }
+    }
+    ~MultiDigest() { for (EVP_MD_CTX *ctx : ctxs_) EVP_MD_CTX_free(ctx); }
+    MultiDigest(const MultiDigest&) = delete;
+    MultiDigest& operator=(const MultiDigest&) = delete;
+    void update(const void *data, size_t len) {
+        for (EVP_MD_CTX *ctx : ctxs_) if (ok_ && EVP_DigestUpdate(ctx, data, len) != 1) ok_ = false;
+    }
+    // One hex string per digest, or an empty vector on failure.
+    std::vector<std::string> finish() {
+        static const char hex[] = "0123456789abcdef";
+        std::vector<std::string> out;
+        for (EVP_MD_CTX *ctx : ctxs_) {
+            unsigned char md[EVP_MAX_MD_SIZE]; unsigned int len = 0;
+            if (!ok_ || EVP_DigestFinal_ex(ctx, md, &len) != 1) return {};
+            std::string s;
+            for (unsigned int i = 0; i < len; i++) { s += hex[md[i] >> 4]; s += hex[md[i] & 15]; }
+            out.push_back(s);
+        }
+        return out;
+    }
+private:
+    std::vector<EVP_MD_CTX*> ctxs_;
+    bool ok_ = true;
+};
+
+static std::vector<std::string> file_digests(const std::string& path, const std::vector<const EVP_MD*>& mds) {
+    FILE *f = fopen(path.c_str(), "rb");
+    if (!f) return {};
+    MultiDigest digest(mds);
+    std::vector<unsigned char> buf(1 << 20);
+    size_t n;
+    while ((n = fread(buf.data(), 1, buf.size(), f)) > 0) digest.update(buf.data(), n);
+    bool failed = ferror(f);
+    fclose(f);
+    return failed ? std::vector<std::string>() : digest.finish();
+}
+
+static std::string file_sha256(const std::string& path) {
+    std::vector<std::string> digests = file_digests(path, {EVP_sha256()});
+    return digests.empty() ? "" : digests[0];
+}
+
+// Unpacks an .xz list with xz(1), already needed for data.tar.xz members, and
+// stores it gzip-compressed at gz_path.
+static bool transcode_xz_to_gz(const std::string& xz_path, const std::string& gz_path) {
+    int fds[2];
+    if (pipe(fds) != 0) return false;
+    pid_t pid = fork();
+    if (pid < 0) { close(fds[0]); close(fds[1]); return false; }
+    if (pid == 0) {
+        dup2(fds[1], STDOUT_FILENO);
+        close(fds[0]); close(fds[1]);
+        execlp("xz", "xz", "-dc", "--", xz_path.c_str(), (char*)NULL);
+        _exit(127);
+    }
+    close(fds[1]);
+    std::string tmp_path = gz_path + ".tmp";
+    gzFile out = gzopen(tmp_path.c_str(), "wb");
+    bool ok = out != nullptr;
+    char buf[65536];
+    ssize_t n;
+    while ((n = read(fds[0], buf, sizeof(buf))) != 0) {
+        if (n < 0) { if (errno == EINTR) continue; ok = false; break; }
+        if (ok && gzwrite(out, buf, n) != n) ok = false;
+    }
+    close(fds[0]);
+    int status = 0;
+    if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0) ok = false;
+    if (out && gzclose(out) != Z_OK) ok = false;
+    if (!ok || rename(tmp_path.c_str(), gz_path.c_str()) != 0) { unlink(tmp_path.c_str()); return false; }
+    return true;
+}
+
+// A list's stamp (<list>.sha256) holds the Release SHA256 of the file that was
+// fetched for it and that file's format: "gz" when the list is those bytes as
+// published, "xz" when it was transcoded from the .xz and so only has the same
+// content.
+static std::string read_list_stamp(const std::string& list_path) {
+    std::ifstream in(list_path + ".sha256");
+    std::string sha256;
+    in >> sha256;
+    return sha256;
+}
+
+// True when list_path holds exactly the bytes published under sha256.
+static bool list_stored_verbatim(const std::string& list_path, const std::string& sha256) {
+    std::ifstream in(list_path + ".sha256");
+    std::string stamp, format;
+    in >> stamp >> format;
+    return !sha256.empty() && stamp == sha256 && format == "gz" && runepkg_util_file_exists(list_path.c_str());
+}
+
+// Plans the fetch of dists_url/<rel>.gz (rel is e.g. "main/binary-amd64/Packages")
+// into list_path. Without a Release entry the .gz is fetched as before.
+static ListFetch plan_list_fetch(const std::string& source_url, const std::string& dists_url, const std::string& rel,
+                                 const ReleaseInfo *release, double link_speed, bool allow_xz) {
+    ListFetch f;
+    std::string canonical = dists_url + "/" + rel + ".gz";
+    std::string display_name = canonical.substr(canonical.find("/dists/") + 7);
+    display_name = display_name.substr(0, display_name.find_last_of('/'));
+    f.list_path = list_cache_path(canonical);
+    f.source_url = source_url;
+    f.task = {canonical, f.list_path, display_name, 0, false};
+    if (!release) return f;
+    auto entry = [release](const std::string& name) -> const ReleaseFile* {
+        auto it = release->files.find(name);
+        return it == release->files.end() ? nullptr : &it->second;
+    };
+    const ReleaseFile *gz = entry(rel + ".gz");
+    const ReleaseFile *xz = allow_xz && xz_available() ? entry(rel + ".xz") : nullptr;
+    if (!gz && !xz) return f;
+
+    std::string stamp = read_list_stamp(f.list_path);
+    if (runepkg_util_file_exists(f.list_path.c_str()) && !stamp.empty() && ((gz && stamp == gz->sha256) || (xz && stamp == xz->sha256))) return f;
+
+    // Time to have the list on disk: transfer, plus for .xz the unpack and re-deflate.
+    const ReleaseFile *unpacked = entry(rel);
+    double unpacked_size = unpacked ? unpacked->size : (gz ? gz->size : xz->size) * 5.0;
+    double gz_cost = gz ? gz->size / link_speed : 0;
+    double xz_cost = xz ? xz->size / link_speed + unpacked_size / XZ_DECODE_RATE + unpacked_size / GZ_ENCODE_RATE : 0;
+    f.transcode = xz && (!gz || xz_cost < gz_cost);
+    const ReleaseFile& pick = f.transcode ? *xz : *gz;
+    std::string ext = f.transcode ? ".xz" : ".gz";
+    size_t slash = rel.find_last_of('/');
+    f.task.url = release->by_hash ? dists_url + "/" + rel.substr(0, slash) + "/by-hash/SHA256/" + pick.sha256 : dists_url + "/" + rel + ext;
+    f.task.dest_path = f.list_path.substr(0, f.list_path.size() - 3) + ext + ".part";
+    f.task.size = pick.size;
+    f.sha256 = pick.sha256;
+    unlink(f.task.dest_path.c_str());
+    if (g_verbose_mode) {
+        std::cout << "  " << display_name << ": fetching " << ext.substr(1) << (release->by_hash ? " by hash" : "") << " (" << pick.size << " bytes";
+        if (gz && xz) std::cout << "; est. gz " << std::fixed << std::setprecision(2) << gz_cost << "s, xz " << xz_cost << "s" << std::defaultfloat;
+        std::cout << ")" << std::endl;
+    }
+    return f;
+}
+
+// Checks a fetched list against its Release hash and moves it into place.
+// A list that could not be refreshed keeps its previous copy, if any.
+static bool finish_list_fetch(ListFetch& f) {
+    bool have_previous = runepkg_util_file_exists(f.list_path.c_str());
+    if (f.sha256.empty()) return f.task.success;
+    bool ok = f.task.success;
+    if (ok && file_sha256(f.task.dest_path) != f.sha256) {
+        std::cerr << "Warning: " << f.task.url << " does not match the Release checksum." << std::endl;
+        ok = false;
+    }
+    if (ok) ok = f.transcode ? transcode_xz_to_gz(f.task.dest_path, f.list_path) : rename(f.task.dest_path.c_str(), f.list_path.c_str()) == 0;
+    unlink(f.task.dest_path.c_str());
+    if (!ok) {
+        if (have_previous) std::cerr << "Warning: Keeping the previous copy of " << f.task.pkg_name << "." << std::endl;
+        unlink((f.list_path + ".sha256").c_str());
+        return have_previous;
+    }
+    std::ofstream stamp(f.list_path + ".sha256");
+    stamp << f.sha256 << " " << (f.transcode ? "xz" : "gz") << "\n";
+    return true;
 }
 
 extern "C" int runepkg_update(void) {
     std::cout << "\033[1;32m[runepkg]\033[0m Starting parallel repository update..." << std::endl;
     if (!g_sources || g_sources_count == 0) { std::cerr << "Error: No sources configured in runepkgconfig." << std::endl; return -1; }
     curl_global_init(CURL_GLOBAL_ALL);
-    std::vector<DownloadTask> bin_tasks, src_tasks;
-    std::vector<std::string> bin_pkg_files, src_pkg_files;
+    auto start_time = std::chrono::high_resolution_clock::now();
+    std::vector<std::string> dists_urls;
     for (int i = 0; i < g_sources_count; i++) {
         std::string base_url = g_sources[i]->url;
         if (base_url.back() != '/') base_url += '/';
-        std::string suite = g_sources[i]->suite;
-        std::stringstream ss(g_sources[i]->components);
-        std::string component;
-        while (ss >> component) {
-            std::string url, dest_path;
-            if (std::string(g_sources[i]->type) == "deb") {
-                url = base_url + "dists/" + suite + "/" + component + "/binary-" + G_ARCH + "/Packages.gz";
-                std::string safe_url = url; std::replace(safe_url.begin(), safe_url.end(), '/', '_'); std::replace(safe_url.begin(), safe_url.end(), ':', '_');
-                dest_path = std::string(g_runepkg_lists_dir) + "/" + safe_url;
-                bin_tasks.push_back({url, dest_path, "", 0, false});
-            } else if (std::string(g_sources[i]->type) == "deb-src") {
-                url = base_url + "dists/" + suite + "/" + component + "/source/Sources.gz";
-                std::string safe_url = url; std::replace(safe_url.begin(), safe_url.end(), '/', '_'); std::replace(safe_url.begin(), safe_url.end(), ':', '_');
-                dest_path = std::string(g_runepkg_lists_dir) + "/" + safe_url;
-                src_tasks.push_back({url, dest_path, "", 0, false});
-            }
-        }
+        std::string dists_url = base_url + "dists/" + g_sources[i]->suite;
+        if (std::find(dists_urls.begin(), dists_urls.end(), dists_url) == dists_urls.end()) dists_urls.push_back(dists_url);
     }
-    std::cout << "Downloading " << bin_tasks.size() + src_tasks.size() << " package lists..." << std::endl;
-    auto start_time = std::chrono::high_resolution_clock::now();
-    std::vector<std::future<bool>> futures;
-    std::vector<DownloadTask*> all_tasks_ptrs;
-    for (auto& t : bin_tasks) all_tasks_ptrs.push_back(&t);
-    for (auto& t : src_tasks) all_tasks_ptrs.push_back(&t);
-    { std::lock_guard<std::mutex> lock(g_progress_mutex); g_finished_count = 0; g_completed_names.clear(); g_active_downloads.clear(); g_total_to_download = all_tasks_ptrs.size(); }
-    for (auto* task : all_tasks_ptrs) {
-        std::string display_name; size_t dists_pos = task->url.find("/dists/");
-        if (dists_pos != std::string::npos) { display_name = task->url.substr(dists_pos + 7); size_t last_slash = display_name.find_last_of('/'); if (last_slash != std::string::npos) display_name = display_name.substr(0, last_slash); }
-        else display_name = task->url;
-        futures.push_back(std::async(std::launch::async, [task, display_name]() { return download_file(task->url, task->dest_path, task->size, display_name); }));
-    }
-    for (size_t i = 0; i < all_tasks_ptrs.size(); i++) {
-        all_tasks_ptrs[i]->success = futures[i].get();
-        if (all_tasks_ptrs[i]->success) {
-            std::string decompressed = all_tasks_ptrs[i]->dest_path;
-            if (decompressed.size() > 3 && decompressed.substr(decompressed.size() - 3) == ".gz") {
-                decompressed = decompressed.substr(0, decompressed.size() - 3);
-            } else {
-                decompressed += ".unpacked";
-            }
-            if (decompress_gz(all_tasks_ptrs[i]->dest_path, decompressed)) {
-                bool is_bin = false;
-                for(auto& t : bin_tasks) if(&t == all_tasks_ptrs[i]) is_bin = true;
-                if(is_bin) bin_pkg_files.push_back(decompressed);
-                else src_pkg_files.push_back(decompressed);
-            }
-        }
-    }
-    std::cout << std::endl << "Building Hybrid Binary and Source Indexes..." << std::endl;
-    build_index(bin_pkg_files, std::string(g_runepkg_db_dir) + "/repo_index.bin", std::string(g_runepkg_db_dir) + "/repo_files.txt");
-    build_index(src_pkg_files, std::string(g_runepkg_db_dir) + "/repo_src_index.bin", std::string(g_runepkg_db_dir) + "/repo_src_files.txt");
-    auto latest_versions = get_latest_versions();
-    std::cout << "Checking for upgradable packages..." << std::endl;
-    int upgradable_count = 0;
-    if (runepkg_main_hash_table) {
-        for (size_t i = 0; i < runepkg_main_hash_table->size; i++) {
-            runepkg_hash_node_t *node = runepkg_main_hash_table->buckets[i];
-            while (node) {
-                std::string name = node->data.package_name;
-                if (latest_versions.count(name)) {
-                    if (runepkg_util_compare_versions(latest_versions[name].c_str(), node->data.version) > 0) {
-                        std::cout << "  \033[1;33m[upgradable]\033[0m " << name << ": " << node->data.version << " -> " << latest_versions[name] << std::endl;
-                        upgradable_count++;
-                    }
+    std::cout << "Fetching " << dists_urls.size() << " release files..." << std::endl;
+    std::map<std::string, ReleaseInfo> releases = fetch_release_files(dists_urls);
+    std::cout << std::endl;
+    std::map<std::string, double> link_speeds = load_link_speeds();
+    std::vector<ListFetch> bin_fetches, src_fetches, contents_fetches;
+    std::vector<std::string> bin_lists, src_lists, contents_files;
+    for (int i = 0; i < g_sources_count; i++) {
+        std::string base_url = g_sources[i]->url;
+        if (base_url.back() != '/') base_url += '/';
+        std::string dists_url = base_url + "dists/" + g_sources[i]->suite;
+        auto rel_it = releases.find(dists_url);
+        const ReleaseInfo *release = rel_it == releases.end() ? nullptr : &rel_it->second;
+        auto speed_it = link_speeds.find(base_url);
+        double link_speed = speed_it != link_speeds.end() ? speed_it->second : release && release->probe_speed > 0 ? release->probe_speed : 1e6;
+        // Local lists are linked into place, so the .gz always wins over unpacking an .xz.
+        if (!local_url_path(base_url).empty()) link_speed = std::numeric_limits<double>::infinity();
+        std::stringstream ss(g_sources[i]->components);
+        std::string component;
+        while (ss >> component) {
+            if (std::string(g_sources[i]->type) == "deb") {
+                // Every configured architecture goes into the same parallel batch and one index.
+                for (int a = 0; a < g_architectures_count; a++) {
+                    std::string rel = component + "/binary-" + g_architectures[a] + "/Packages";
+                    // binary-all is optional; its packages are repeated in every binary-<arch> list.
+                    if (std::strcmp(g_architectures[a], "all") == 0 && (!release || (!release->files.count(rel + ".gz") && !release->files.count(rel + ".xz")))) continue;
+                    bin_fetches.push_back(plan_list_fetch(base_url, dists_url, rel, release, link_speed, true));
                 }
-                node = node->next;
+                // Contents lists are huge unpacked; re-deflating an .xz one would cost more than it saves.
+                if (g_fetch_contents) contents_fetches.push_back(plan_list_fetch(base_url, dists_url, component + "/Contents-" + runepkg_config_native_arch(), release, link_speed, false));
+            } else if (std::string(g_sources[i]->type) == "deb-src") {
+                src_fetches.push_back(plan_list_fetch(base_url, dists_url, component + "/source/Sources", release, link_speed, true));
             }
         }
     }
+    std::cout << "Downloading " << bin_fetches.size() + src_fetches.size() + contents_fetches.size() << " package lists..." << std::endl;
+    std::vector<std::future<bool>> futures;
+    std::vector<ListFetch*> all_fetches;
+    for (auto& f : bin_fetches) all_fetches.push_back(&f);
+    for (auto& f : src_fetches) all_fetches.push_back(&f);
+    for (auto& f : contents_fetches) all_fetches.push_back(&f);
+    { std::lock_guard<std::mutex> lock(g_progress_mutex); g_finished_count = 0; g_completed_names.clear(); g_active_downloads.clear(); g_total_to_download = all_fetches.size(); }
+    for (auto* f : all_fetches) {
+        futures.push_back(std::async(std::launch::async, [f]() { return download_file(f->task.url, f->task.dest_path, f->task.size, f->task.pkg_name, &f->speed); }));
+    }
+    for (size_t i = 0; i < all_fetches.size(); i++) {
+        all_fetches[i]->task.success = futures[i].get();
+        if (!finish_list_fetch(*all_fetches[i])) continue;
+        const std::string& list = all_fetches[i]->list_path;
+        // Contents lists are streamed straight from the .gz by build_contents_index().
+        if (i >= bin_fetches.size() + src_fetches.size()) { contents_files.push_back(list); continue; }
+        // Lists stay compressed; drop the unpacked copies older versions kept beside them.
+        unlink(list.substr(0, list.size() - 3).c_str());
+        (i < bin_fetches.size() ? bin_lists : src_lists).push_back(list);
+    }
+    save_link_speeds(link_speeds, all_fetches);
+    std::cout << std::endl << "Building Hybrid Binary and Source Indexes..." << std::endl;
+    if (g_update_memory_mb) std::cout << "  Low-memory mode: sorting within " << g_update_memory_mb << " MiB (runs spill to " << scratch_dir() << ")" << std::endl;
+    std::unordered_set<std::string> live_shards;
+    bool bin_changed = build_index(bin_lists, std::string(g_runepkg_db_dir) + "/repo_index.bin", std::string(g_runepkg_db_dir) + "/repo_files.txt", live_shards);
+    bool src_changed = build_index(src_lists, std::string(g_runepkg_db_dir) + "/repo_src_index.bin", std::string(g_runepkg_db_dir) + "/repo_src_files.txt", live_shards);
+    prune_index_shards(live_shards);
+    drop_repo_views();
+    if (!bin_changed && !src_changed) std::cout << "  Package lists unchanged; reusing existing indexes." << std::endl;
+    std::string search_path = std::string(g_runepkg_db_dir) + "/repo_search.bin";
+    if ((bin_changed || !runepkg_util_file_exists(search_path.c_str())) && !build_search_index(bin_lists, search_path)) std::cerr << "Warning: Failed to write search index." << std::endl;
+    if (!contents_files.empty()) {
+        std::cout << "Building Contents index..." << std::endl;
+        if (!build_contents_index(contents_files, std::string(g_runepkg_db_dir) + "/repo_contents.bin")) std::cerr << "Warning: Failed to build Contents index." << std::endl;
+    } else if (g_fetch_contents) {
+        std::cerr << "Warning: No Contents lists could be fetched; 'runepkg contents' will be unavailable." << std::endl;
+    }
+    std::string versions_path = std::string(g_runepkg_db_dir) + "/repo_versions.bin";
+    if ((bin_changed || !runepkg_util_file_exists(versions_path.c_str())) && build_repo_versions(versions_path) < 0) std::cerr << "Warning: Failed to write repository version table." << std::endl;
+    std::cout << "Checking for upgradable packages..." << std::endl;
+    RepoVersionTable repo_versions; UpgradePlan plan;
+    if (repo_versions.open(versions_path)) plan_upgrades(repo_versions, plan);
+    for (const auto& e : plan.upgradable) std::cout << "  \033[1;33m[upgradable]\033[0m " << e.name << ": " << e.installed << " -> " << e.candidate << std::endl;
+    for (const auto& e : plan.held) std::cout << "  \033[1;36m[held]\033[0m " << e.name << ": " << e.installed << " (repo: " << e.candidate << ")" << std::endl;
+    for (const auto& e : plan.downgradable) std::cout << "  \033[1;35m[downgradable]\033[0m " << e.name << ": " << e.installed << " -> " << e.candidate << std::endl;
+    if (g_verbose_mode) for (const auto& e : plan.obsolete) std::cout << "  \033[1;90m[obsolete]\033[0m " << e.name << " " << e.installed << " (not in any repository)" << std::endl;
     auto end_time = std::chrono::high_resolution_clock::now();
     auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
-    std::cout << "\033[1;32mUpdate complete!\033[0m Binary/Source indexes updated. " << upgradable_count << " upgradable. Time: " << duration.count() / 1000.0 << "s" << std::endl;
+    std::cout << "\033[1;32mUpdate complete!\033[0m Binary/Source indexes updated. " << plan.upgradable.size() << " upgradable, " << plan.held.size() << " held, "
+              << plan.downgradable.size() << " downgradable, " << plan.obsolete.size() << " obsolete. Time: " << duration.count() / 1000.0 << "s" << std::endl;
     curl_global_cleanup();
     return 0;
 }
 
-struct SearchResult { std::string name, version, arch, desc; bool installed = false; };
+// Ranking: BM25 over the indexed tokens (short-field hits weighted above the
+// extended description) plus boosts for the package name itself.
+// A query word matches a document if it prefixes one of its tokens (exact tokens
+// count fully, longer ones at half weight) or occurs anywhere in the name, and
+// every word must match.
+static const float SEARCH_BM25_K1 = 1.2f;
+static const float SEARCH_BM25_B = 0.75f;
+static const float SEARCH_PREFIX_WEIGHT = 0.5f;
+static const float SEARCH_NAME_EXACT = 20.0f;
+static const float SEARCH_NAME_PREFIX = 4.0f;
+static const float SEARCH_NAME_SUBSTRING = 1.0f;
+static const size_t SEARCH_TOP_K = 20;
+
+struct SearchHit { uint32_t doc; float score; };
+
+extern "C" int runepkg_repo_search(const char *query, bool show_all) {
+    if (!query) return -1;
+    std::vector<std::string> words;
+    for_each_token(query, [&words](const std::string& t) { words.push_back(t); });
+    if (words.empty()) return -1;
+    std::string whole;
+    for (const char *p = query; *p; p++) whole += (char)ascii_lower((unsigned char)*p);
+    whole.erase(0, whole.find_first_not_of(" \t"));
+    whole.erase(whole.find_last_not_of(" \t") + 1);
 
-extern "C" int runepkg_repo_search(const char *query) {
-    if (!query || strlen(query) == 0) return -1;
-    std::string q = query; std::transform(q.begin(), q.end(), q.begin(), ::tolower);
-    std::string file_list_path = std::string(g_runepkg_db_dir) + "/repo_files.txt";
-    std::ifstream flist(file_list_path);
-    if (!flist.is_open()) { std::cerr << "Error: Repository index not found. Run 'runepkg update' first." << std::endl; return -1; }
-    std::vector<std::string> pkg_files; std::string line;
-    while (std::getline(flist, line)) {
-        if (!line.empty()) pkg_files.push_back(line);
-    }
-    flist.close();
     std::cout << "Searching repository metadata..." << std::endl;
-    std::map<std::string, SearchResult> results;
-    for (const auto& filename : pkg_files) {
-        std::ifstream infile(filename);
-        if (!infile.is_open()) continue;
-        std::string pkg_name, pkg_version, pkg_arch, pkg_desc, pkg_provides;
-        while (std::getline(infile, line)) {
-            if (line.empty() || line == "\r") {
-                if (!pkg_name.empty()) {
-                    std::string combined = pkg_name + " " + pkg_desc + " " + pkg_provides;
-                    std::transform(combined.begin(), combined.end(), combined.begin(), ::tolower);
-                    if (combined.find(q) != std::string::npos) {
-                        SearchResult res = {pkg_name, pkg_version, pkg_arch, pkg_desc, false};
-                        if (runepkg_main_hash_table && runepkg_hash_search(runepkg_main_hash_table, pkg_name.c_str())) res.installed = true;
-                        if (results.find(pkg_name) == results.end() || runepkg_util_compare_versions(pkg_version.c_str(), results[pkg_name].version.c_str()) > 0) results[pkg_name] = res;
-                    }
-                    pkg_name.clear();
-                    pkg_version.clear();
-                    pkg_arch.clear();
-                    pkg_desc.clear();
-                    pkg_provides.clear();
-                }
-                continue;
-            }
-            if (line.compare(0, 9, "Package: ") == 0) pkg_name = line.substr(9);
-            else if (line.compare(0, 9, "Version: ") == 0) pkg_version = line.substr(9);
-            else if (line.compare(0, 14, "Architecture: ") == 0) pkg_arch = line.substr(14);
-            else if (line.compare(0, 13, "Description: ") == 0) pkg_desc = line.substr(13);
-            else if (line.compare(0, 10, "Provides: ") == 0) pkg_provides = line.substr(10);
-            if (!pkg_name.empty() && pkg_name.back() == '\r') pkg_name.pop_back();
-            if (!pkg_version.empty() && pkg_version.back() == '\r') pkg_version.pop_back();
-            if (!pkg_arch.empty() && pkg_arch.back() == '\r') pkg_arch.pop_back();
-            if (!pkg_desc.empty() && pkg_desc.back() == '\r') pkg_desc.pop_back();
-            if (!pkg_provides.empty() && pkg_provides.back() == '\r') pkg_provides.pop_back();
-        }
-        if (!pkg_name.empty()) {
-            std::string combined = pkg_name + " " + pkg_desc + " " + pkg_provides; std::transform(combined.begin(), combined.end(), combined.begin(), ::tolower);
-            if (combined.find(q) != std::string::npos) {
-                SearchResult res = {pkg_name, pkg_version, pkg_arch, pkg_desc, false};
-                if (runepkg_main_hash_table && runepkg_hash_search(runepkg_main_hash_table, pkg_name.c_str())) res.installed = true;
-                if (results.find(pkg_name) == results.end() || runepkg_util_compare_versions(pkg_version.c_str(), results[pkg_name].version.c_str()) > 0) results[pkg_name] = res;
+    SearchIndex idx;
+    if (!load_search_index(idx)) { std::cerr << "Error: Repository index not found. Run 'runepkg update' first." << std::endl; return -1; }
+    const uint32_t n = idx.hdr->doc_count;
+    const float avg_length = n && idx.hdr->total_length ? (float)idx.hdr->total_length / n : 1.0f;
+    const float short_weight = idx.hdr->short_weight;
+
+    std::vector<float> score(n, 0.0f), tf(n, 0.0f);
+    std::vector<uint32_t> matched(n, 0), touched;
+    for (const auto& w : words) {
+        touched.clear();
+        const SearchTerm *first = std::lower_bound(idx.terms, idx.terms + idx.hdr->term_count, w,
+            [&idx](const SearchTerm& t, const std::string& key) { return strcmp(idx.str(t.text_off), key.c_str()) < 0; });
+        for (const SearchTerm *t = first; t < idx.terms + idx.hdr->term_count; t++) {
+            const char *text = idx.str(t->text_off);
+            if (strncmp(text, w.c_str(), w.size()) != 0) break;
+            float weight = text[w.size()] == '\0' ? 1.0f : SEARCH_PREFIX_WEIGHT;
+            const unsigned char *p = idx.postings + t->postings_off, *end = idx.postings + idx.hdr->postings_size;
+            uint64_t doc = 0;
+            for (uint32_t i = 0; i < t->doc_freq && p < end; i++) {
+                doc += get_varint(p, end);
+                uint64_t packed = get_varint(p, end);
+                if (doc >= n) break;
+                if (tf[doc] == 0.0f) touched.push_back(doc);
+                tf[doc] += weight * (short_weight * (packed & SEARCH_SHORT_TF_MAX) + (packed >> 3));
             }
         }
+        float df = touched.size();
+        float idf = std::log(1.0f + (n - df + 0.5f) / (df + 0.5f));
+        for (uint32_t d : touched) {
+            float norm = SEARCH_BM25_K1 * (1.0f - SEARCH_BM25_B + SEARCH_BM25_B * idx.docs[d].length / avg_length);
+            score[d] += idf * tf[d] * (SEARCH_BM25_K1 + 1.0f) / (tf[d] + norm);
+            matched[d]++;
+        }
+        for (uint32_t d = 0; d < n; d++) {
+            const char *name = idx.str(idx.docs[d].name_off);
+            size_t len = strlen(name);
+            const char *hit = ci_find(name, len, w);
+            if (!hit) continue;
+            if (len == w.size()) score[d] += SEARCH_NAME_EXACT;
+            else if (hit == name) score[d] += SEARCH_NAME_PREFIX;
+            else score[d] += SEARCH_NAME_SUBSTRING;
+            if (tf[d] == 0.0f) matched[d]++;
+        }
+        for (uint32_t d : touched) tf[d] = 0.0f;
+    }
+
+    // Best first; ties go to the shorter, then alphabetically earlier, name.
+    auto better = [&idx](const SearchHit& a, const SearchHit& b) {
+        if (a.score != b.score) return a.score > b.score;
+        const char *na = idx.str(idx.docs[a.doc].name_off), *nb = idx.str(idx.docs[b.doc].name_off);
+        size_t la = strlen(na), lb = strlen(nb);
+        if (la != lb) return la < lb;
+        return strcmp(na, nb) < 0;
+    };
+    // Bounded heap whose top is the weakest of the best k seen so far.
+    std::priority_queue<SearchHit, std::vector<SearchHit>, decltype(better)> heap(better);
+    std::vector<SearchHit> ranked;
+    size_t total = 0;
+    for (uint32_t d = 0; d < n; d++) {
+        if (matched[d] != words.size()) continue;
+        total++;
+        SearchHit h = {d, score[d]};
+        if (words.size() > 1 && strcmp(idx.str(idx.docs[d].name_off), whole.c_str()) == 0) h.score += SEARCH_NAME_EXACT;
+        if (show_all) { ranked.push_back(h); continue; }
+        if (heap.size() < SEARCH_TOP_K) heap.push(h);
+        else if (better(h, heap.top())) { heap.pop(); heap.push(h); }
     }
-    for (const auto& pair : results) {
-        const auto& res = pair.second;
-        std::cout << "\033[1;32m" << res.name << "\033[0m/" << "repo";
-        if (res.installed) std::cout << " [\033[1;33minstalled\033[0m]";
-        std::cout << " \033[1;33m" << res.version << "\033[0m " << res.arch << std::endl << "  " << res.desc << std::endl << std::endl;
+    if (!show_all) {
+        for (; !heap.empty(); heap.pop()) ranked.push_back(heap.top());
     }
-    if (results.empty()) {
+    std::sort(ranked.begin(), ranked.end(), better);
+
+    for (const auto& h : ranked) {
+        const SearchDoc& d = idx.docs[h.doc];
+        const char *name = idx.str(d.name_off);
+        std::cout << "\033[1;32m" << name << "\033[0m/" << "repo";
+        if (runepkg_main_hash_table && runepkg_hash_search(runepkg_main_hash_table, name)) std::cout << " [\033[1;33minstalled\033[0m]";
+        std::cout << " \033[1;33m" << idx.str(d.version_off) << "\033[0m " << idx.str(d.arch_off) << std::endl << "  " << idx.str(d.desc_off) << std::endl << std::endl;
+    }
+    if (total == 0) {
         std::cout << "No matches found for '" << query << "'." << std::endl;
+    } else if (ranked.size() < total) {
+        std::cout << "Showing the top " << ranked.size() << " of " << total << " matches. Use 'runepkg search \"" << query << "\" --all' to list them all." << std::endl;
+    } else {
+        std::cout << "Found " << total << " matches." << std::endl;
+    }
+    return 0;
+}
+
+struct ContentsReader {
+    const unsigned char *base = nullptr; size_t size = 0; const ContentsHeader *hdr = nullptr;
+
+    bool open(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(ContentsHeader)) { close(fd); return false; }
+        void *m = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0); close(fd);
+        if (m == MAP_FAILED) return false;
+        base = (const unsigned char*)m; size = st.st_size; hdr = (const ContentsHeader*)base;
+        if (hdr->magic != CONTENTS_MAGIC || hdr->version != CONTENTS_VERSION || hdr->file_size != size || hdr->block_size == 0 || !layout_valid()) { munmap(m, size); base = nullptr; return false; }
+        return true;
+    }
+    ~ContentsReader() { if (base) munmap((void*)base, size); }
+
+    // Every offset the lookups follow stays inside the mapping: the sections are
+    // in order, the tables aligned, each block starts inside its section's data
+    // and each name offset inside the NUL-terminated name blob.
+    bool layout_valid() const {
+        uint64_t blocks = ((uint64_t)hdr->path_count + hdr->block_size - 1) / hdr->block_size;
+        uint64_t names_off = hdr->pkg_table_off + (uint64_t)hdr->pkg_count * sizeof(uint32_t);
+        if (hdr->fwd_blocks != blocks || hdr->rev_blocks != blocks || hdr->pkg_table_off < sizeof(ContentsHeader) || hdr->pkg_table_off % 4 ||
+            hdr->fwd_table_off % 8 || hdr->rev_table_off % 8 || names_off > hdr->fwd_table_off ||
+            hdr->fwd_data_off != hdr->fwd_table_off + blocks * sizeof(uint64_t) || hdr->fwd_data_off > hdr->rev_table_off ||
+            hdr->rev_data_off != hdr->rev_table_off + blocks * sizeof(uint64_t) || hdr->rev_data_off > size) return false;
+        if (hdr->pkg_count > 0 && (names_off == hdr->fwd_table_off || base[hdr->fwd_table_off - 1] != '\0')) return false;
+        const uint32_t *offs = (const uint32_t*)(base + hdr->pkg_table_off);
+        for (uint32_t i = 0; i < hdr->pkg_count; i++) if (offs[i] >= hdr->fwd_table_off - names_off) return false;
+        for (int rev = 0; rev < 2; rev++) {
+            const uint64_t *table = (const uint64_t*)(base + (rev ? hdr->rev_table_off : hdr->fwd_table_off));
+            uint64_t data_len = rev ? size - hdr->rev_data_off : hdr->rev_table_off - hdr->fwd_data_off;
+            for (uint64_t b = 0; b < blocks; b++) if (table[b] >= data_len) return false;
+        }
+        return true;
+    }
+
+    const char* pkg_name(uint32_t id) const {
+        if (id >= hdr->pkg_count) return "?";
+        const uint32_t *offs = (const uint32_t*)(base + hdr->pkg_table_off);
+        return (const char*)(base + hdr->pkg_table_off + hdr->pkg_count * sizeof(uint32_t) + offs[id]);
+    }
+
+    // Walks entries of one section starting at block `b`; fn(key, payload_ptr) must consume the payload and return false to stop.
+    template <typename Fn> void walk(bool rev, uint32_t b, Fn fn) const {
+        const uint64_t *table = (const uint64_t*)(base + (rev ? hdr->rev_table_off : hdr->fwd_table_off));
+        const unsigned char *data = base + (rev ? hdr->rev_data_off : hdr->fwd_data_off);
+        const unsigned char *end = rev ? base + size : base + hdr->rev_table_off;
+        uint32_t nblocks = rev ? hdr->rev_blocks : hdr->fwd_blocks; std::string key;
+        for (; b < nblocks; b++) {
+            const unsigned char *p = data + table[b];
+            for (uint32_t i = 0; i < hdr->block_size && (uint64_t)b * hdr->block_size + i < hdr->path_count && p < end; i++) {
+                if (i == 0) { uint64_t len = get_varint(p, end); if (len > (uint64_t)(end - p)) return; key.assign((const char*)p, len); p += len; }
+                else {
+                    uint64_t shared = get_varint(p, end), len = get_varint(p, end);
+                    if (shared > key.size() || len > (uint64_t)(end - p)) return;
+                    key.resize(shared); key.append((const char*)p, len); p += len;
+                }
+                if (!fn(key, p, end)) return;
+            }
+        }
+    }
+
+    // Last block whose first key is <= k (0 if none), found by binary search over block heads.
+    uint32_t find_block(bool rev, const std::string& k) const {
+        const uint64_t *table = (const uint64_t*)(base + (rev ? hdr->rev_table_off : hdr->fwd_table_off));
+        const unsigned char *data = base + (rev ? hdr->rev_data_off : hdr->fwd_data_off);
+        const unsigned char *end = rev ? base + size : base + hdr->rev_table_off;
+        uint32_t lo = 0, hi = rev ? hdr->rev_blocks : hdr->fwd_blocks;
+        while (hi - lo > 1) {
+            uint32_t mid = lo + (hi - lo) / 2;
+            const unsigned char *p = data + table[mid]; uint64_t len = get_varint(p, end);
+            if (std::string_view((const char*)p, std::min<uint64_t>(len, end - p)) <= k) lo = mid; else hi = mid;
+        }
+        return lo;
+    }
+
+    static void read_pkgs(const unsigned char *&p, const unsigned char *end, std::vector<uint32_t>* out) {
+        uint64_t n = get_varint(p, end);
+        for (uint64_t j = 0; j < n && p < end; j++) { uint32_t id = get_varint(p, end); if (out) out->push_back(id); }
+    }
+
+    bool lookup_exact(const std::string& q, std::vector<uint32_t>& pkgs) const {
+        bool found = false;
+        walk(false, find_block(false, q), [&](const std::string& key, const unsigned char *&p, const unsigned char *end) {
+            if (key == q) { read_pkgs(p, end, &pkgs); found = true; return false; }
+            read_pkgs(p, end, nullptr); return key < q;
+        });
+        return found;
+    }
+
+    // Path ids of every path ending in "/q" (or equal to q), in path order.
+    std::vector<uint32_t> lookup_suffix(const std::string& q) const {
+        std::string rq(q.rbegin(), q.rend()); std::vector<uint32_t> ids;
+        walk(true, find_block(true, rq), [&](const std::string& key, const unsigned char *&p, const unsigned char *end) {
+            uint32_t id = get_varint(p, end);
+            if (key.compare(0, rq.size(), rq) == 0) { if (key.size() == rq.size() || key[rq.size()] == '/') ids.push_back(id); return true; }
+            return key < rq;
+        });
+        std::sort(ids.begin(), ids.end());
+        return ids;
+    }
+
+    void decode_path(uint32_t id, std::string& path, std::vector<uint32_t>& pkgs) const {
+        uint32_t skip = id % hdr->block_size;
+        walk(false, id / hdr->block_size, [&](const std::string& key, const unsigned char *&p, const unsigned char *end) {
+            if (skip-- == 0) { path = key; read_pkgs(p, end, &pkgs); return false; }
+            read_pkgs(p, end, nullptr); return true;
+        });
+    }
+};
+
+extern "C" int runepkg_repo_contents_search(const char *path) {
+    if (!path || strlen(path) == 0) return -1;
+    ContentsReader reader;
+    if (!reader.open(std::string(g_runepkg_db_dir) + "/repo_contents.bin")) {
+        std::cerr << "Error: Contents index not found. Set 'fetch_contents=yes' in runepkgconfig and run 'runepkg update'." << std::endl;
+        return -1;
+    }
+    auto print_match = [&](const std::string& file, const std::vector<uint32_t>& pkgs) {
+        std::cout << "  ";
+        for (size_t i = 0; i < pkgs.size(); i++) {
+            const char *name = reader.pkg_name(pkgs[i]);
+            std::cout << (i ? ", " : "") << "\033[1;32m" << name << "\033[0m";
+            if (runepkg_main_hash_table && runepkg_hash_search(runepkg_main_hash_table, name)) std::cout << " [\033[1;33minstalled\033[0m]";
+        }
+        std::cout << ": /" << file << std::endl;
+    };
+    std::string q = path; size_t matches = 0;
+    if (q[0] == '/') {
+        // Absolute path: exact lookup (paths are stored without the leading slash).
+        q.erase(0, q.find_first_not_of('/'));
+        std::vector<uint32_t> pkgs;
+        if (reader.lookup_exact(q, pkgs)) { print_match(q, pkgs); matches = 1; }
     } else {
-        std::cout << "Found " << results.size() << " matches." << std::endl;
+        // Relative path or bare file name: match on whole trailing path components.
+        while (!q.empty() && q.back() == '/') q.pop_back();
+        for (uint32_t id : reader.lookup_suffix(q)) {
+            std::string file; std::vector<uint32_t> pkgs;
+            reader.decode_path(id, file, pkgs); print_match(file, pkgs); matches++;
+        }
     }
+    if (matches == 0) {
+        std::cout << "No repository package ships '" << path << "'." << std::endl;
+        return 1;
+    }
+    std::cout << "Found " << matches << " matching paths." << std::endl;
     return 0;
 }
 
+// Splits "name:arch"; ":any", ":native" and the native arch itself leave arch empty.
+static std::string split_arch_qualifier(const std::string& spec, std::string& arch) {
+    size_t colon = spec.find(':');
+    arch.clear();
+    if (colon == std::string::npos) return spec;
+    std::string q = spec.substr(colon + 1);
+    if (q != "any" && q != "native" && q != runepkg_config_native_arch()) arch = q;
+    return spec.substr(0, colon);
+}
+
 std::string get_package_url(const char *pkg_name, bool is_source, uint32_t *out_offset, std::string *out_metafile) {
-    std::string index_name = is_source ? "repo_src_index.bin" : "repo_index.bin";
-    std::string file_list_name = is_source ? "repo_src_files.txt" : "repo_files.txt";
-    std::string index_path = std::string(g_runepkg_db_dir) + "/" + index_name;
-    std::ifstream idx(index_path, std::ios::binary);
-    if (!idx.is_open()) return "";
-    uint32_t count; idx.read(reinterpret_cast<char*>(&count), sizeof(count));
-    std::vector<IndexEntry> entries(count); idx.read(reinterpret_cast<char*>(entries.data()), count * sizeof(IndexEntry)); idx.close();
-    IndexEntry search_target; std::strncpy(search_target.name, pkg_name, 63); search_target.name[63] = '\0';
-    auto it = std::lower_bound(entries.begin(), entries.end(), search_target);
-    if (it == entries.end() || std::strcmp(it->name, pkg_name) != 0) return "";
-    std::ifstream flist(std::string(g_runepkg_db_dir) + "/" + file_list_name);
-    std::vector<std::string> pkg_files; std::string line;
-    while (std::getline(flist, line)) pkg_files.push_back(line);
-    flist.close();
-    if (it->file_id >= pkg_files.size()) return "";
+    const RepoIndexView& view = repo_index_view(is_source);
+    std::string arch, name = split_arch_qualifier(pkg_name, arch);
+    // A qualifier naming an architecture outside architectures= has nothing in the lists.
+    if (!is_source && !arch.empty() && !runepkg_config_arch_enabled(arch.c_str())) return "";
+    const IndexEntry *it = is_source ? view.find(name.c_str()) : arch.empty() ? view.find_native(name.c_str()) : view.find(name.c_str(), arch);
+    if (!it || it->file_id >= view.files.size()) return "";
+    const std::vector<std::string>& pkg_files = view.files; std::string line;
     if (out_offset) *out_offset = it->offset;
     if (out_metafile) *out_metafile = pkg_files[it->file_id];
-    std::ifstream meta(pkg_files[it->file_id]);
-    meta.seekg(it->offset);
+    std::istringstream meta(read_list_stanza(pkg_files[it->file_id], it->offset));
     std::string rel_path;
     while (std::getline(meta, line)) {
         if (line.empty() || line == "\r") break;
@@ -571,25 +2628,26 @@ PkgMetadata get_package_metadata(const std::string& pkg_name) {
     std::string url = get_package_url(pkg_name.c_str(), false, &offset, &meta_file);
     if (url.empty()) return meta_data;
     meta_data.url = url; meta_data.filename = url.substr(url.find_last_of('/') + 1);
-    std::ifstream meta(meta_file);
-    if (meta.is_open()) {
-        meta.seekg(offset); std::string line;
-        while (std::getline(meta, line)) {
-            if (line.empty() || line == "\r") break;
-            if (line.compare(0, 9, "Package: ") == 0) {
-                meta_data.name = line.substr(9);
-                if (!meta_data.name.empty() && meta_data.name.back() == '\r') meta_data.name.pop_back();
-            } else if (line.compare(0, 9, "Depends: ") == 0) {
-                meta_data.depends = line.substr(9);
-                if (!meta_data.depends.empty() && meta_data.depends.back() == '\r') meta_data.depends.pop_back();
-            } else if (line.compare(0, 8, "Source: ") == 0) {
-                meta_data.source_name = line.substr(8);
-                size_t space = meta_data.source_name.find(' ');
-                if (space != std::string::npos) meta_data.source_name = meta_data.source_name.substr(0, space);
-                if (!meta_data.source_name.empty() && meta_data.source_name.back() == '\r') meta_data.source_name.pop_back();
-            } else if (line.compare(0, 6, "Size: ") == 0) {
-                try { meta_data.size = std::stoull(line.substr(6)); } catch (...) { meta_data.size = 0; }
-            }
+    std::istringstream meta(read_list_stanza(meta_file, offset));
+    std::string line;
+    while (std::getline(meta, line)) {
+        if (line.empty() || line == "\r") break;
+        if (line.compare(0, 9, "Package: ") == 0) {
+            meta_data.name = line.substr(9);
+            if (!meta_data.name.empty() && meta_data.name.back() == '\r') meta_data.name.pop_back();
+        } else if (line.compare(0, 14, "Architecture: ") == 0) {
+            meta_data.arch = line.substr(14);
+            if (!meta_data.arch.empty() && meta_data.arch.back() == '\r') meta_data.arch.pop_back();
+        } else if (line.compare(0, 9, "Depends: ") == 0) {
+            meta_data.depends = line.substr(9);
+            if (!meta_data.depends.empty() && meta_data.depends.back() == '\r') meta_data.depends.pop_back();
+        } else if (line.compare(0, 8, "Source: ") == 0) {
+            meta_data.source_name = line.substr(8);
+            size_t space = meta_data.source_name.find(' ');
+            if (space != std::string::npos) meta_data.source_name = meta_data.source_name.substr(0, space);
+            if (!meta_data.source_name.empty() && meta_data.source_name.back() == '\r') meta_data.source_name.pop_back();
+        } else if (line.compare(0, 6, "Size: ") == 0) {
+            try { meta_data.size = std::stoull(line.substr(6)); } catch (...) { meta_data.size = 0; }
         }
     }
     if (meta_data.source_name.empty()) meta_data.source_name = meta_data.name;
@@ -602,23 +2660,21 @@ SourceMetadata get_source_package_metadata(const std::string& pkg_name) {
     std::string base_url = get_package_url(pkg_name.c_str(), true, &offset, &meta_file);
     if (base_url.empty()) return meta_data;
     meta_data.base_url = base_url;
-    std::ifstream meta(meta_file);
-    if (meta.is_open()) {
-        meta.seekg(offset); std::string line; bool in_files = false;
-        while (std::getline(meta, line)) {
-            if (line.empty() || line == "\r") break;
-            if (line.compare(0, 9, "Package: ") == 0) {
-                meta_data.name = line.substr(9);
-                if (!meta_data.name.empty() && meta_data.name.back() == '\r') meta_data.name.pop_back();
-            } else if (line.compare(0, 15, "Build-Depends: ") == 0) {
-                meta_data.build_depends = line.substr(15);
-                if (!meta_data.build_depends.empty() && meta_data.build_depends.back() == '\r') meta_data.build_depends.pop_back();
-            } else if (line.compare(0, 7, "Files: ") == 0) in_files = true;
-            else if (in_files && line[0] == ' ') {
-                std::stringstream ss(line); std::string hash, size_str, filename; ss >> hash >> size_str >> filename;
-                if (!filename.empty()) { try { meta_data.files.push_back({filename, (size_t)std::stoull(size_str)}); } catch (...) { meta_data.files.push_back({filename, 0}); } }
-            } else if (in_files && line[0] != ' ') in_files = false;
-        }
+    std::istringstream meta(read_list_stanza(meta_file, offset));
+    std::string line; bool in_files = false;
+    while (std::getline(meta, line)) {
+        if (line.empty() || line == "\r") break;
+        if (line.compare(0, 9, "Package: ") == 0) {
+            meta_data.name = line.substr(9);
+            if (!meta_data.name.empty() && meta_data.name.back() == '\r') meta_data.name.pop_back();
+        } else if (line.compare(0, 15, "Build-Depends: ") == 0) {
+            meta_data.build_depends = line.substr(15);
+            if (!meta_data.build_depends.empty() && meta_data.build_depends.back() == '\r') meta_data.build_depends.pop_back();
+        } else if (line.compare(0, 7, "Files: ") == 0) in_files = true;
+        else if (in_files && line[0] == ' ') {
+            std::stringstream ss(line); std::string hash, size_str, filename; ss >> hash >> size_str >> filename;
+            if (!filename.empty()) { try { meta_data.files.push_back({filename, (size_t)std::stoull(size_str)}); } catch (...) { meta_data.files.push_back({filename, 0}); } }
+        } else if (in_files && line[0] != ' ') in_files = false;
     }
     return meta_data;
 }
@@ -630,56 +2686,102 @@ std::vector<std::string> parse_depends_cpp(const std::string& depends) {
     return result;
 }
 
-void resolve_recursive(const std::string& pkg_name, std::unordered_map<std::string, PkgMetadata>& resolved, std::vector<std::string>& order, std::unordered_set<std::string>& visiting, bool ignore_installed) {
-    if (resolved.count(pkg_name) || visiting.count(pkg_name)) return;
-    if (!ignore_installed && runepkg_main_hash_table && runepkg_hash_search(runepkg_main_hash_table, pkg_name.c_str())) return;
-    PkgMetadata meta = get_package_metadata(pkg_name); if (meta.url.empty()) return;
-    visiting.insert(pkg_name); resolved[pkg_name] = meta;
-    std::vector<std::string> deps = parse_depends_cpp(meta.depends);
-    for (const auto& dep : deps) resolve_recursive(dep, resolved, order, visiting, ignore_installed);
-    order.push_back(pkg_name); visiting.erase(pkg_name);
+// A plain dependency of a foreign-arch package means the same architecture when
+// the repository has it built for that one; otherwise (tools, Multi-Arch:
+// foreign, arch "all") the plain name stands.
+static std::string qualify_dependency(const std::string& dep, const std::string& parent_arch) {
+    if (dep.find(':') != std::string::npos || parent_arch.empty() || parent_arch == "all" || parent_arch == runepkg_config_native_arch()) return dep;
+    const RepoIndexView& view = repo_index_view(false);
+    const IndexEntry *e = view.find(dep.c_str(), parent_arch);
+    return e && parent_arch == view.arch_of(e) ? dep + ":" + parent_arch : dep;
+}
+
+// --- Resolver state ---
+// The resolvers walk interned name ids (runepkg_intern.h) rather than strings:
+// a dependency name is hashed once when it is interned, and every later visit
+// is a bit test or an array load. Resolved metadata sits in a dense id -> slot
+// table; names that were skipped (already installed, not in the repository)
+// are remembered too, so a popular dependency is only looked up once per run.
+struct IdBitset {
+    std::vector<uint64_t> words;
+    bool test(runepkg_name_id id) const { size_t w = id >> 6; return w < words.size() && ((words[w] >> (id & 63)) & 1); }
+    void set(runepkg_name_id id) { size_t w = id >> 6; if (w >= words.size()) words.resize(w + 1, 0); words[w] |= 1ull << (id & 63); }
+    void reset(runepkg_name_id id) { size_t w = id >> 6; if (w < words.size()) words[w] &= ~(1ull << (id & 63)); }
+};
+
+template <typename Meta>
+struct Resolution {
+    std::vector<uint32_t> slot;         // By id: 1 + index into metas, 0 when not resolved
+    std::vector<Meta> metas;
+    std::vector<runepkg_name_id> order; // Dependencies before their dependents
+    IdBitset visiting, skipped;
+
+    const Meta *find(runepkg_name_id id) const { return id < slot.size() && slot[id] ? &metas[slot[id] - 1] : nullptr; }
+    void add(runepkg_name_id id, Meta meta) {
+        if (id >= slot.size()) slot.resize(id + 1, 0);
+        metas.push_back(std::move(meta)); slot[id] = metas.size();
+    }
+    bool empty() const { return metas.empty(); }
+    size_t size() const { return metas.size(); }
+    std::string_view name(size_t i) const { return runepkg_intern_name(order[i]); }
+};
+
+void resolve_recursive(runepkg_name_id id, Resolution<PkgMetadata>& res, bool ignore_installed) {
+    if (id == RUNEPKG_NAME_NONE || res.find(id) || res.visiting.test(id) || res.skipped.test(id)) return;
+    const char *pkg_name = runepkg_intern_name(id);
+    // The installed database has one record per name, whatever its architecture.
+    std::string arch, bare_name = split_arch_qualifier(pkg_name, arch);
+    if (!ignore_installed && runepkg_main_hash_table && runepkg_hash_search(runepkg_main_hash_table, bare_name.c_str())) { res.skipped.set(id); return; }
+    PkgMetadata meta = get_package_metadata(pkg_name); if (meta.url.empty()) { res.skipped.set(id); return; }
+    std::vector<std::string> deps = parse_depends_cpp(meta.depends); std::string parent_arch = meta.arch;
+    res.visiting.set(id); res.add(id, std::move(meta));
+    for (const auto& dep : deps) resolve_recursive(runepkg_intern(qualify_dependency(dep, parent_arch).c_str()), res, ignore_installed);
+    res.order.push_back(id); res.visiting.reset(id);
 }
 
-void resolve_source_recursive(const std::string& pkg_name, std::unordered_map<std::string, SourceMetadata>& resolved, std::vector<std::string>& order, std::unordered_set<std::string>& visiting) {
-    if (resolved.count(pkg_name) || visiting.count(pkg_name)) return;
-    SourceMetadata meta = get_source_package_metadata(pkg_name); if (meta.base_url.empty()) return;
-    visiting.insert(pkg_name); resolved[pkg_name] = meta;
+void resolve_source_recursive(runepkg_name_id id, Resolution<SourceMetadata>& res) {
+    if (id == RUNEPKG_NAME_NONE || res.find(id) || res.visiting.test(id) || res.skipped.test(id)) return;
+    SourceMetadata meta = get_source_package_metadata(runepkg_intern_name(id)); if (meta.base_url.empty()) { res.skipped.set(id); return; }
     std::vector<std::string> deps = parse_depends_cpp(meta.build_depends);
-    for (const auto& dep : deps) resolve_source_recursive(dep, resolved, order, visiting);
-    order.push_back(pkg_name); visiting.erase(pkg_name);
+    res.visiting.set(id); res.add(id, std::move(meta));
+    for (const auto& dep : deps) resolve_source_recursive(runepkg_intern(dep.c_str()), res);
+    res.order.push_back(id); res.visiting.reset(id);
 }
 
-void resolve_source_runtime_recursive(const std::string& pkg_name, std::unordered_map<std::string, SourceMetadata>& resolved, std::vector<std::string>& order, std::unordered_set<std::string>& visiting) {
-    if (visiting.count(pkg_name)) return;
-    visiting.insert(pkg_name);
-    PkgMetadata bin_meta = get_package_metadata(pkg_name); if (bin_meta.source_name.empty()) { visiting.erase(pkg_name); return; }
-    if (resolved.find(bin_meta.source_name) == resolved.end()) {
+// Walks binary runtime dependencies (visiting is keyed by binary name) and
+// collects the source package of each one (slots are keyed by source name).
+void resolve_source_runtime_recursive(runepkg_name_id id, Resolution<SourceMetadata>& res) {
+    if (id == RUNEPKG_NAME_NONE || res.visiting.test(id)) return;
+    res.visiting.set(id);
+    PkgMetadata bin_meta = get_package_metadata(runepkg_intern_name(id)); if (bin_meta.source_name.empty()) { res.visiting.reset(id); return; }
+    runepkg_name_id src_id = runepkg_intern(bin_meta.source_name.c_str());
+    if (src_id != RUNEPKG_NAME_NONE && !res.find(src_id)) {
         SourceMetadata src_meta = get_source_package_metadata(bin_meta.source_name);
-        if (!src_meta.base_url.empty()) { resolved[bin_meta.source_name] = src_meta; order.push_back(bin_meta.source_name); }
+        if (!src_meta.base_url.empty()) { res.add(src_id, std::move(src_meta)); res.order.push_back(src_id); }
     }
     std::vector<std::string> deps = parse_depends_cpp(bin_meta.depends);
-    for (const auto& dep : deps) resolve_source_runtime_recursive(dep, resolved, order, visiting);
-    visiting.erase(pkg_name);
+    for (const auto& dep : deps) resolve_source_runtime_recursive(runepkg_intern(dep.c_str()), res);
+    res.visiting.reset(id);
 }
 
 extern "C" char* runepkg_repo_download(const char *pkg_name, bool recursive) {
     if (!pkg_name) return NULL;
-    std::string clean_pkg = pkg_name; size_t extra_pos = clean_pkg.find_first_of(":[<");
+    std::string clean_pkg = pkg_name; size_t extra_pos = clean_pkg.find_first_of("[<");
     if (extra_pos != std::string::npos) clean_pkg = clean_pkg.substr(0, extra_pos);
     clean_pkg.erase(0, clean_pkg.find_first_not_of(" \t")); clean_pkg.erase(clean_pkg.find_last_not_of(" \t") + 1);
     std::string index_path = std::string(g_runepkg_db_dir) + "/repo_index.bin";
     if (!runepkg_util_file_exists(index_path.c_str())) { std::cerr << "\033[1;31m[error]\033[0m Repository index not found. Please run 'runepkg update' first." << std::endl; return NULL; }
-    std::unordered_map<std::string, PkgMetadata> resolved; std::vector<std::string> order; std::unordered_set<std::string> visiting;
-    if (recursive) resolve_recursive(clean_pkg, resolved, order, visiting, g_force_mode);
-    else { PkgMetadata meta = get_package_metadata(clean_pkg); if (!meta.url.empty()) { resolved[clean_pkg] = meta; order.push_back(clean_pkg); } }
-    if (resolved.empty()) return NULL;
-    if (recursive && resolved.size() > 1) {
+    Resolution<PkgMetadata> res; runepkg_name_id top = runepkg_intern(clean_pkg.c_str());
+    if (recursive) resolve_recursive(top, res, g_force_mode);
+    else if (top != RUNEPKG_NAME_NONE) { PkgMetadata meta = get_package_metadata(clean_pkg); if (!meta.url.empty()) { res.add(top, std::move(meta)); res.order.push_back(top); } }
+    if (!res.find(top)) return NULL;
+    if (recursive && res.size() > 1) {
         std::cout << "\033[1;34m[runepkg]\033[0m Resolving recursive dependencies for " << clean_pkg << "..." << std::endl;
         std::cout << "\033[1;33m[dependencies]\033[0m The following dependencies are required:" << std::endl;
         int width = runepkg_util_get_terminal_width(); int current_line_len = 2; std::cout << "  ";
-        for (size_t i = 0; i < order.size(); i++) {
-            if (current_line_len + order[i].length() + 1 > (size_t)width && i > 0) { std::cout << "\n  "; current_line_len = 2; }
-            std::cout << order[i]; current_line_len += order[i].length(); if (i < order.size() - 1) { std::cout << " "; current_line_len += 1; }
+        for (size_t i = 0; i < res.order.size(); i++) {
+            if (current_line_len + res.name(i).length() + 1 > (size_t)width && i > 0) { std::cout << "\n  "; current_line_len = 2; }
+            std::cout << res.name(i); current_line_len += res.name(i).length(); if (i < res.order.size() - 1) { std::cout << " "; current_line_len += 1; }
         }
         std::cout << std::endl << "Would you like to attempt to download them? [\033[1;33my\033[0m/\033[1;33mN\033[0m] ";
         std::fflush(stdout); char resp[16]; bool confirmed = false;
@@ -688,17 +2790,61 @@ extern "C" char* runepkg_repo_download(const char *pkg_name, bool recursive) {
         if (!confirmed) { std::cout << "Download cancelled." << std::endl; return NULL; }
     }
     std::vector<DownloadTask> tasks;
-    for (const auto& name : order) { const auto& meta = resolved[name]; std::string dest_path = std::string(g_download_dir) + "/" + meta.filename; tasks.push_back({meta.url, dest_path, name, meta.size, false}); }
-    curl_global_init(CURL_GLOBAL_ALL); std::vector<std::future<bool>> futures;
+    for (runepkg_name_id id : res.order) { const auto& meta = *res.find(id); std::string dest_path = std::string(g_download_dir) + "/" + meta.filename; tasks.push_back({meta.url, dest_path, runepkg_intern_name(id), meta.size, false}); }
+    runepkg_cache_hold(); curl_global_init(CURL_GLOBAL_ALL); std::vector<std::future<bool>> futures;
     { std::lock_guard<std::mutex> lock(g_progress_mutex); g_finished_count = 0; g_completed_names.clear(); g_active_downloads.clear(); g_total_to_download = tasks.size(); }
     for (auto& t : tasks) futures.push_back(std::async(std::launch::async, [&t]() { return download_file(t.url, t.dest_path, t.size, t.pkg_name); }));
-    for (size_t i = 0; i < tasks.size(); i++) tasks[i].success = futures[i].get();
+    for (size_t i = 0; i < tasks.size(); i++) {
+        tasks[i].success = futures[i].get();
+        if (tasks[i].success) runepkg_cache_touch(tasks[i].dest_path.c_str());
+    }
     std::cout << std::endl; curl_global_cleanup();
-    std::string top_filename = resolved[clean_pkg].url.substr(resolved[clean_pkg].url.find_last_of('/') + 1);
+    const std::string& top_url = res.find(top)->url;
+    std::string top_filename = top_url.substr(top_url.find_last_of('/') + 1);
     std::string top_dest = std::string(g_download_dir) + "/" + top_filename;
     return strdup(top_dest.c_str());
 }
 
+extern "C" char** runepkg_repo_fetch_closure(const char *const *pkg_names, int count) {
+    if (!pkg_names || count <= 0) return NULL;
+    std::string index_path = std::string(g_runepkg_db_dir) + "/repo_index.bin";
+    bool have_index = runepkg_util_file_exists(index_path.c_str());
+    Resolution<PkgMetadata> res;
+    std::vector<std::string> deb_paths, local_debs; int missing = 0;
+    for (int i = 0; i < count; i++) {
+        std::string name = pkg_names[i];
+        if (name.size() > 4 && name.compare(name.size() - 4, 4, ".deb") == 0 && runepkg_util_file_exists(name.c_str())) { local_debs.push_back(name); continue; }
+        if (!have_index) { std::cerr << "\033[1;31m[error]\033[0m Repository index not found. Please run 'runepkg update' first." << std::endl; return NULL; }
+        // A bootstrap root starts empty, so the host's installed packages never satisfy anything
+        runepkg_name_id id = runepkg_intern(name.c_str());
+        resolve_recursive(id, res, true);
+        if (!res.find(id)) { std::cerr << "\033[1;31m[error]\033[0m Package not found in repositories: " << name << std::endl; missing++; }
+    }
+    if (missing) return NULL;
+    if (!res.order.empty()) {
+        std::cout << "\033[1;34m[runepkg]\033[0m Closure of " << count << " requested packages: " << res.order.size() << " packages" << std::endl;
+        std::vector<DownloadTask> tasks;
+        for (runepkg_name_id id : res.order) { const auto& meta = *res.find(id); tasks.push_back({meta.url, std::string(g_download_dir) + "/" + meta.filename, runepkg_intern_name(id), meta.size, false}); }
+        runepkg_cache_hold(); curl_global_init(CURL_GLOBAL_ALL); std::vector<std::future<bool>> futures;
+        { std::lock_guard<std::mutex> lock(g_progress_mutex); g_finished_count = 0; g_completed_names.clear(); g_active_downloads.clear(); g_total_to_download = tasks.size(); }
+        for (auto& t : tasks) futures.push_back(std::async(std::launch::async, [&t]() { return download_file(t.url, t.dest_path, t.size, t.pkg_name); }));
+        for (size_t i = 0; i < tasks.size(); i++) {
+            tasks[i].success = futures[i].get();
+            if (tasks[i].success) runepkg_cache_touch(tasks[i].dest_path.c_str());
+        }
+        std::cout << std::endl; curl_global_cleanup();
+        for (const auto& t : tasks) if (!t.success) { std::cerr << "Failed to download " << t.pkg_name << std::endl; missing++; }
+        if (missing) return NULL;
+        for (const auto& t : tasks) deb_paths.push_back(t.dest_path);
+    }
+    // Dependencies come before their dependents (and local .debs last), which is the order files are layered in
+    deb_paths.insert(deb_paths.end(), local_debs.begin(), local_debs.end());
+    char **paths = (char**)calloc(deb_paths.size() + 1, sizeof(char*));
+    if (!paths) return NULL;
+    for (size_t i = 0; i < deb_paths.size(); i++) paths[i] = strdup(deb_paths[i].c_str());
+    return paths;
+}
+
 extern "C" int runepkg_repo_build_depends_download(const char *pkg_name) {
     if (!pkg_name) return -1;
     SourceMetadata src_meta = get_source_package_metadata(pkg_name);
@@ -706,16 +2852,16 @@ extern "C" int runepkg_repo_build_depends_download(const char *pkg_name) {
         std::cerr << "\033[1;31m[error]\033[0m Could not find source metadata for " << pkg_name << std::endl;
         return -1;
     }
-    std::unordered_map<std::string, PkgMetadata> resolved; std::vector<std::string> order; std::unordered_set<std::string> visiting;
+    Resolution<PkgMetadata> res;
     std::cout << "\033[1;34m[runepkg]\033[0m Resolving binary build-dependencies for " << pkg_name << "..." << std::endl;
     std::vector<std::string> build_deps = parse_depends_cpp(src_meta.build_depends);
-    for (const auto& dep : build_deps) resolve_recursive(dep, resolved, order, visiting, g_force_mode);
-    if (resolved.empty()) { std::cout << "All build dependencies are already satisfied or not found." << std::endl; return 0; }
+    for (const auto& dep : build_deps) resolve_recursive(runepkg_intern(dep.c_str()), res, g_force_mode);
+    if (res.empty()) { std::cout << "All build dependencies are already satisfied or not found." << std::endl; return 0; }
     std::cout << "\033[1;33m[dependencies]\033[0m The following binary packages (build-deps) are required:" << std::endl;
     int width = runepkg_util_get_terminal_width(); int current_line_len = 2; std::cout << "  ";
-    for (size_t i = 0; i < order.size(); i++) {
-        if (current_line_len + order[i].length() + 1 > (size_t)width && i > 0) { std::cout << "\n  "; current_line_len = 2; }
-        std::cout << order[i]; current_line_len += order[i].length(); if (i < order.size() - 1) { std::cout << " "; current_line_len += 1; }
+    for (size_t i = 0; i < res.order.size(); i++) {
+        if (current_line_len + res.name(i).length() + 1 > (size_t)width && i > 0) { std::cout << "\n  "; current_line_len = 2; }
+        std::cout << res.name(i); current_line_len += res.name(i).length(); if (i < res.order.size() - 1) { std::cout << " "; current_line_len += 1; }
     }
     std::cout << std::endl << "Would you like to attempt to download them? [\033[1;33my\033[0m/\033[1;33mN\033[0m] ";
     std::fflush(stdout); char resp[16]; bool confirmed = false;
@@ -723,27 +2869,25 @@ extern "C" int runepkg_repo_build_depends_download(const char *pkg_name) {
     else if (std::fgets(resp, sizeof(resp), stdin) && (resp[0] == 'y' || resp[0] == 'Y')) { confirmed = true; }
     if (!confirmed) { std::cout << "Download cancelled." << std::endl; return 0; }
     std::vector<DownloadTask> tasks;
-    for (const auto& name : order) { const auto& meta = resolved[name]; std::string dest_path = std::string(g_download_dir) + "/" + meta.filename; tasks.push_back({meta.url, dest_path, name, meta.size, false}); }
-    curl_global_init(CURL_GLOBAL_ALL); std::vector<std::future<bool>> futures;
+    for (runepkg_name_id id : res.order) { const auto& meta = *res.find(id); std::string dest_path = std::string(g_download_dir) + "/" + meta.filename; tasks.push_back({meta.url, dest_path, runepkg_intern_name(id), meta.size, false}); }
+    runepkg_cache_hold(); curl_global_init(CURL_GLOBAL_ALL); std::vector<std::future<bool>> futures;
     { std::lock_guard<std::mutex> lock(g_progress_mutex); g_finished_count = 0; g_completed_names.clear(); g_active_downloads.clear(); g_total_to_download = tasks.size(); }
     for (auto& t : tasks) futures.push_back(std::async(std::launch::async, [&t]() { return download_file(t.url, t.dest_path, t.size, t.pkg_name); }));
-    for (size_t i = 0; i < tasks.size(); i++) tasks[i].success = futures[i].get();
+    for (size_t i = 0; i < tasks.size(); i++) {
+        tasks[i].success = futures[i].get();
+        if (tasks[i].success) runepkg_cache_touch(tasks[i].dest_path.c_str());
+    }
     std::cout << std::endl; curl_global_cleanup(); return 0;
 }
 
 extern "C" int runepkg_upgrade(void) {
     std::cout << "\033[1;32m[runepkg]\033[0m Starting full system upgrade..." << std::endl;
-    auto latest_versions = get_latest_versions(); std::vector<std::string> to_upgrade;
-    if (runepkg_main_hash_table) {
-        for (size_t i = 0; i < runepkg_main_hash_table->size; i++) {
-            runepkg_hash_node_t *node = runepkg_main_hash_table->buckets[i];
-            while (node) {
-                std::string name = node->data.package_name;
-                if (latest_versions.count(name) && runepkg_util_compare_versions(latest_versions[name].c_str(), node->data.version) > 0) to_upgrade.push_back(name);
-                node = node->next;
-            }
-        }
-    }
+    RepoVersionTable repo_versions; UpgradePlan plan;
+    if (!load_repo_versions(repo_versions)) { std::cerr << "Error: No repository metadata found. Run 'runepkg update' first." << std::endl; return -1; }
+    plan_upgrades(repo_versions, plan);
+    std::vector<std::string> to_upgrade;
+    for (const auto& e : plan.upgradable) to_upgrade.push_back(e.name);
+    for (const auto& e : plan.held) std::cout << "  \033[1;36m[kept back]\033[0m " << e.name << ": " << e.installed << " (held; repo has " << e.candidate << ")" << std::endl;
     if (to_upgrade.empty()) { std::cout << "All packages are already up to date." << std::endl; return 0; }
     std::cout << "The following packages will be upgraded:" << std::endl;
     int width = runepkg_util_get_terminal_width(); int current_line_len = 2; std::cout << "  ";
@@ -758,10 +2902,13 @@ extern "C" int runepkg_upgrade(void) {
     std::cout << "\033[1;34m[runepkg]\033[0m Pre-fetching " << to_upgrade.size() << " packages in parallel..." << std::endl;
     std::vector<DownloadTask> tasks;
     for (const auto& name : to_upgrade) { PkgMetadata meta = get_package_metadata(name); if (!meta.url.empty()) tasks.push_back({meta.url, std::string(g_download_dir) + "/" + meta.filename, name, meta.size, false}); }
-    curl_global_init(CURL_GLOBAL_ALL); std::vector<std::future<bool>> futures;
+    runepkg_cache_hold(); curl_global_init(CURL_GLOBAL_ALL); std::vector<std::future<bool>> futures;
     { std::lock_guard<std::mutex> lock(g_progress_mutex); g_finished_count = 0; g_completed_names.clear(); g_active_downloads.clear(); g_total_to_download = tasks.size(); }
     for (auto& t : tasks) futures.push_back(std::async(std::launch::async, [&t]() { return download_file(t.url, t.dest_path, t.size, t.pkg_name); }));
-    for (size_t i = 0; i < tasks.size(); i++) tasks[i].success = futures[i].get();
+    for (size_t i = 0; i < tasks.size(); i++) {
+        tasks[i].success = futures[i].get();
+        if (tasks[i].success) runepkg_cache_touch(tasks[i].dest_path.c_str());
+    }
     std::cout << std::endl; int success_count = 0, fail_count = 0;
     for (const auto& t : tasks) {
         if (!t.success) { std::cerr << "Failed to download " << t.pkg_name << std::endl; fail_count++; continue; }
@@ -799,16 +2946,16 @@ extern "C" int runepkg_repo_source_download(const char *pkg_name) {
 
 extern "C" int runepkg_repo_source_build_depends_download(const char *pkg_name) {
     if (!pkg_name) return -1;
-    std::unordered_map<std::string, SourceMetadata> resolved; std::vector<std::string> order; std::unordered_set<std::string> visiting;
+    Resolution<SourceMetadata> res;
     std::cout << "\033[1;34m[runepkg]\033[0m Resolving source build-dependencies for " << pkg_name << "..." << std::endl;
-    resolve_source_recursive(pkg_name, resolved, order, visiting);
-    if (resolved.empty()) { std::cerr << "\033[1;31m[error]\033[0m Could not find source package " << pkg_name << std::endl; return -1; }
-    if (order.size() > 1) {
+    resolve_source_recursive(runepkg_intern(pkg_name), res);
+    if (res.empty()) { std::cerr << "\033[1;31m[error]\033[0m Could not find source package " << pkg_name << std::endl; return -1; }
+    if (res.order.size() > 1) {
         std::cout << "\033[1;33m[dependencies]\033[0m The following source packages (build-deps) are required:" << std::endl;
         int width = runepkg_util_get_terminal_width(); int current_line_len = 2; std::cout << "  ";
-        for (size_t i = 0; i < order.size(); i++) {
-            if (current_line_len + order[i].length() + 1 > (size_t)width && i > 0) { std::cout << "\n  "; current_line_len = 2; }
-            std::cout << order[i]; current_line_len += order[i].length(); if (i < order.size() - 1) { std::cout << " "; current_line_len += 1; }
+        for (size_t i = 0; i < res.order.size(); i++) {
+            if (current_line_len + res.name(i).length() + 1 > (size_t)width && i > 0) { std::cout << "\n  "; current_line_len = 2; }
+            std::cout << res.name(i); current_line_len += res.name(i).length(); if (i < res.order.size() - 1) { std::cout << " "; current_line_len += 1; }
         }
         std::cout << std::endl << "Do you want to continue? [\033[1;33my\033[0m/\033[1;33mN\033[0m] "; std::fflush(stdout); char resp[16]; bool confirmed = false;
         if (g_auto_confirm_deps) { std::cout << "\033[1;33my (auto)\033[0m" << std::endl; confirmed = true; }
@@ -816,8 +2963,8 @@ extern "C" int runepkg_repo_source_build_depends_download(const char *pkg_name)
         if (!confirmed) { std::cout << "Source download cancelled." << std::endl; return 0; }
     }
     curl_global_init(CURL_GLOBAL_ALL);
-    for (const auto& name : order) {
-        const auto& meta = resolved[name]; std::cout << "\033[1;34m[source]\033[0m Downloading " << name << " (" << meta.files.size() << " files)..." << std::endl;
+    for (runepkg_name_id id : res.order) {
+        const auto& meta = *res.find(id); std::cout << "\033[1;34m[source]\033[0m Downloading " << runepkg_intern_name(id) << " (" << meta.files.size() << " files)..." << std::endl;
         std::vector<std::future<bool>> futures; { std::lock_guard<std::mutex> lock(g_progress_mutex); g_finished_count = 0; g_completed_names.clear(); g_active_downloads.clear(); g_total_to_download = meta.files.size(); }
         for (const auto& sf : meta.files) {
             std::string url = meta.base_url + "/" + sf.filename;
@@ -835,16 +2982,16 @@ extern "C" int runepkg_repo_source_build_depends_download(const char *pkg_name)
 
 extern "C" int runepkg_repo_source_depends_download(const char *pkg_name) {
     if (!pkg_name) return -1;
-    std::unordered_map<std::string, SourceMetadata> resolved; std::vector<std::string> order; std::unordered_set<std::string> visiting;
+    Resolution<SourceMetadata> res;
     std::cout << "\033[1;34m[runepkg]\033[0m Resolving source runtime-dependencies for " << pkg_name << "..." << std::endl;
-    resolve_source_runtime_recursive(pkg_name, resolved, order, visiting);
-    if (resolved.empty()) { std::cerr << "\033[1;31m[error]\033[0m Could not find dependencies for " << pkg_name << std::endl; return -1; }
-    if (order.size() > 0) {
+    resolve_source_runtime_recursive(runepkg_intern(pkg_name), res);
+    if (res.empty()) { std::cerr << "\033[1;31m[error]\033[0m Could not find dependencies for " << pkg_name << std::endl; return -1; }
+    if (res.order.size() > 0) {
         std::cout << "\033[1;33m[dependencies]\033[0m The following source packages (runtime-deps) are required:" << std::endl;
         int width = runepkg_util_get_terminal_width(); int current_line_len = 2; std::cout << "  ";
-        for (size_t i = 0; i < order.size(); i++) {
-            if (current_line_len + order[i].length() + 1 > (size_t)width && i > 0) { std::cout << "\n  "; current_line_len = 2; }
-            std::cout << order[i]; current_line_len += order[i].length(); if (i < order.size() - 1) { std::cout << " "; current_line_len += 1; }
+        for (size_t i = 0; i < res.order.size(); i++) {
+            if (current_line_len + res.name(i).length() + 1 > (size_t)width && i > 0) { std::cout << "\n  "; current_line_len = 2; }
+            std::cout << res.name(i); current_line_len += res.name(i).length(); if (i < res.order.size() - 1) { std::cout << " "; current_line_len += 1; }
         }
         std::cout << std::endl << "Do you want to continue? [\033[1;33my\033[0m/\033[1;33mN\033[0m] "; std::fflush(stdout); char resp[16]; bool confirmed = false;
         if (g_auto_confirm_deps) { std::cout << "\033[1;33my (auto)\033[0m" << std::endl; confirmed = true; }
@@ -852,8 +2999,8 @@ extern "C" int runepkg_repo_source_depends_download(const char *pkg_name) {
         if (!confirmed) { std::cout << "Source download cancelled." << std::endl; return 0; }
     }
     curl_global_init(CURL_GLOBAL_ALL);
-    for (const auto& name : order) {
-        const auto& meta = resolved[name]; std::cout << "\033[1;34m[source]\033[0m Downloading " << name << " (" << meta.files.size() << " files)..." << std::endl;
+    for (runepkg_name_id id : res.order) {
+        const auto& meta = *res.find(id); std::cout << "\033[1;34m[source]\033[0m Downloading " << runepkg_intern_name(id) << " (" << meta.files.size() << " files)..." << std::endl;
         std::vector<std::future<bool>> futures; { std::lock_guard<std::mutex> lock(g_progress_mutex); g_finished_count = 0; g_completed_names.clear(); g_active_downloads.clear(); g_total_to_download = meta.files.size(); }
         for (const auto& sf : meta.files) {
             std::string url = meta.base_url + "/" + sf.filename;
@@ -868,3 +3015,850 @@ extern "C" int runepkg_repo_source_depends_download(const char *pkg_name) {
     }
     curl_global_cleanup(); runepkg_storage_build_autocomplete_index(); return 0;
 }
+
+// --- Local repository indexer (scan-repo) ---
+// Publishes every .deb under a directory as dists/local/main/binary-<arch>/
+// Packages{,.gz,.xz} plus a Release file, so the directory can be used as a
+// source ("deb file:///dir local main"). Only the control member of each deb
+// is unpacked, in-process; the hashes come from one read of the whole file.
+static const char *SCAN_SUITE = "local";
+static const char *SCAN_COMPONENT = "main";
+static const char *SCAN_CACHE_NAME = ".runepkg-scan.cache";
+static const char *SCAN_CACHE_MAGIC = "RUNEPKG-SCAN 1";
+
+struct ScannedDeb {
+    std::string rel_path;  // Filename: field, relative to the repository root
+    uint64_t ino = 0, size = 0;
+    int64_t mtime_ns = 0;
+    std::string stanza;    // Control fields plus Filename/Size/MD5sum/SHA256, newline-terminated
+    std::string package, version, arch;
+};
+
+static std::string stanza_field(const std::string& stanza, const std::string& key) {
+    std::istringstream in(stanza);
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.size() > key.size() && line.compare(0, key.size(), key) == 0 && line[key.size()] == ':') {
+            size_t start = line.find_first_not_of(" \t", key.size() + 1);
+            return start == std::string::npos ? "" : line.substr(start);
+        }
+    }
+    return "";
+}
+
+// Runs argv with input on stdin and collects its stdout.
+static bool pipe_through(const char *const argv[], const std::string& input, std::string& output) {
+    int in_fds[2], out_fds[2];
+    // Close-on-exec, so a decompressor started by another scan worker never
+    // inherits (and holds open) this one's pipe ends.
+    if (pipe2(in_fds, O_CLOEXEC) != 0) return false;
+    if (pipe2(out_fds, O_CLOEXEC) != 0) { close(in_fds[0]); close(in_fds[1]); return false; }
+    pid_t pid = fork();
+    if (pid < 0) { close(in_fds[0]); close(in_fds[1]); close(out_fds[0]); close(out_fds[1]); return false; }
+    if (pid == 0) {
+        dup2(in_fds[0], STDIN_FILENO);
+        dup2(out_fds[1], STDOUT_FILENO);
+        execvp(argv[0], (char *const *)argv);
+        _exit(127);
+    }
+    close(in_fds[0]);
+    close(out_fds[1]);
+    std::thread writer([&input, fd = in_fds[1]]() {
+        // A tool that exits early must not take the whole process down with SIGPIPE.
+        sigset_t set;
+        sigemptyset(&set);
+        sigaddset(&set, SIGPIPE);
+        pthread_sigmask(SIG_BLOCK, &set, nullptr);
+        size_t off = 0;
+        while (off < input.size()) {
+            ssize_t n = write(fd, input.data() + off, input.size() - off);
+            if (n < 0) { if (errno == EINTR) continue; break; }
+            off += n;
+        }
+        close(fd);
+    });
+    output.clear();
+    char buf[65536];
+    ssize_t n;
+    bool ok = true;
+    while ((n = read(out_fds[0], buf, sizeof(buf))) != 0) {
+        if (n < 0) { if (errno == EINTR) continue; ok = false; break; }
+        output.append(buf, n);
+    }
+    close(out_fds[0]);
+    writer.join();
+    int status = 0;
+    if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0) ok = false;
+    return ok;
+}
+
+static bool gunzip_buffer(const std::string& in, std::string& out) {
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (inflateInit2(&zs, 16 + MAX_WBITS) != Z_OK) return false;
+    zs.next_in = (Bytef*)in.data();
+    zs.avail_in = in.size();
+    out.clear();
+    char buf[65536];
+    int ret;
+    do {
+        zs.next_out = (Bytef*)buf;
+        zs.avail_out = sizeof(buf);
+        ret = inflate(&zs, Z_NO_FLUSH);
+        if (ret != Z_OK && ret != Z_STREAM_END) break;
+        out.append(buf, sizeof(buf) - zs.avail_out);
+    } while (ret != Z_STREAM_END);
+    inflateEnd(&zs);
+    return ret == Z_STREAM_END;
+}
+
+// The regular file "control" (or "./control") inside a tar archive.
+static bool tar_find_control(const std::string& tar, std::string& out) {
+    size_t off = 0;
+    while (off + 512 <= tar.size()) {
+        const char *h = tar.data() + off;
+        if (h[0] == '\0') break;
+        std::string name(h, strnlen(h, 100));
+        uint64_t size = strtoull(std::string(h + 124, 12).c_str(), nullptr, 8);
+        char type = h[156];
+        size_t data = off + 512;
+        if (data + size > tar.size()) return false;
+        if ((type == '0' || type == '\0') && (name == "./control" || name == "control")) {
+            out.assign(tar, data, size);
+            return true;
+        }
+        off = data + (size + 511) / 512 * 512;
+    }
+    return false;
+}
+
+// Reads the control file of a .deb without unpacking anything else: walks the
+// ar members to control.tar*, decompresses just that member and pulls
+// "control" out of the tar stream.
+static bool deb_read_control(const std::string& path, std::string& control) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    char magic[8];
+    struct stat st;
+    bool ok = fstat(fd, &st) == 0 && pread(fd, magic, 8, 0) == 8 && memcmp(magic, "!<arch>\n", 8) == 0;
+    std::string member_name, member;
+    off_t off = 8;
+    char hdr[60];
+    while (ok && pread(fd, hdr, sizeof(hdr), off) == (ssize_t)sizeof(hdr)) {
+        std::string name(hdr, 16);
+        name.erase(name.find_last_not_of(' ') + 1);
+        if (!name.empty() && name.back() == '/') name.pop_back();
+        uint64_t size = strtoull(std::string(hdr + 48, 10).c_str(), nullptr, 10);
+        off += sizeof(hdr);
+        // The header's size is only trusted as far as the file actually reaches.
+        if (size > (uint64_t)(st.st_size - off)) { ok = false; break; }
+        if (name.compare(0, 11, "control.tar") == 0) {
+            member_name = name;
+            member.resize(size);
+            ok = pread(fd, &member[0], size, off) == (ssize_t)size;
+            break;
+        }
+        off += size + (size & 1);
+    }
+    close(fd);
+    if (!ok || member_name.empty()) return false;
+
+    std::string tar;
+    std::string ext = member_name.substr(11);
+    if (ext.empty()) tar.swap(member);
+    else if (ext == ".gz") ok = gunzip_buffer(member, tar);
+    else if (ext == ".xz") { const char *argv[] = {"xz", "-dc", nullptr}; ok = pipe_through(argv, member, tar); }
+    else if (ext == ".zst") { const char *argv[] = {"zstd", "-dcq", nullptr}; ok = pipe_through(argv, member, tar); }
+    else ok = false;
+    return ok && tar_find_control(tar, control);
+}
+
+// Builds the Packages stanza for one .deb; false if it is not a readable package.
+static bool scan_deb(const std::string& root, ScannedDeb& deb) {
+    std::string path = root + "/" + deb.rel_path;
+    std::string control;
+    if (!deb_read_control(path, control)) return false;
+    std::vector<std::string> digests = file_digests(path, {EVP_md5(), EVP_sha256()});
+    if (digests.size() != 2) return false;
+
+    std::string stanza;
+    std::istringstream in(control);
+    std::string line;
+    while (std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.find_first_not_of(" \t") == std::string::npos) continue;
+        stanza += line + "\n";
+    }
+    stanza += "Filename: " + deb.rel_path + "\n";
+    stanza += "Size: " + std::to_string(deb.size) + "\n";
+    stanza += "MD5sum: " + digests[0] + "\n";
+    stanza += "SHA256: " + digests[1] + "\n";
+    deb.stanza = stanza;
+    return true;
+}
+
+static void scan_collect_debs(const std::string& root, const std::string& rel, std::vector<ScannedDeb>& debs) {
+    std::string dir_path = rel.empty() ? root : root + "/" + rel;
+    DIR *dir = opendir(dir_path.c_str());
+    if (!dir) return;
+    struct dirent *de;
+    while ((de = readdir(dir)) != NULL) {
+        std::string name = de->d_name;
+        if (name[0] == '.' || (rel.empty() && name == "dists")) continue;
+        if (name.find_first_of("\t\n") != std::string::npos) continue;
+        std::string child = rel.empty() ? name : rel + "/" + name;
+        struct stat st;
+        if (stat((root + "/" + child).c_str(), &st) != 0) continue;
+        if (S_ISDIR(st.st_mode)) { scan_collect_debs(root, child, debs); continue; }
+        if (!S_ISREG(st.st_mode) || name.size() < 5 || name.compare(name.size() - 4, 4, ".deb") != 0) continue;
+        ScannedDeb deb;
+        deb.rel_path = child;
+        deb.ino = st.st_ino;
+        deb.size = st.st_size;
+        deb.mtime_ns = (int64_t)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+        debs.push_back(std::move(deb));
+    }
+    closedir(dir);
+}
+
+// Cache of earlier stanzas keyed by path, valid while (inode, size, mtime) match.
+static std::unordered_map<std::string, ScannedDeb> load_scan_cache(const std::string& path) {
+    std::unordered_map<std::string, ScannedDeb> cache;
+    std::ifstream in(path, std::ios::binary);
+    std::string line;
+    if (!std::getline(in, line) || line != SCAN_CACHE_MAGIC) return cache;
+    while (std::getline(in, line)) {
+        std::istringstream ss(line);
+        ScannedDeb deb;
+        size_t len = 0;
+        if (!std::getline(ss, deb.rel_path, '\t') || !(ss >> deb.ino >> deb.size >> deb.mtime_ns >> len)) break;
+        deb.stanza.resize(len);
+        if (!in.read(&deb.stanza[0], len)) break;
+        cache[deb.rel_path] = std::move(deb);
+    }
+    return cache;
+}
+
+static void save_scan_cache(const std::string& path, const std::vector<ScannedDeb>& debs) {
+    std::string tmp_path = path + ".tmp";
+    std::ofstream out(tmp_path, std::ios::binary);
+    out << SCAN_CACHE_MAGIC << "\n";
+    for (const auto& deb : debs) {
+        out << deb.rel_path << "\t" << deb.ino << "\t" << deb.size << "\t" << deb.mtime_ns << "\t" << deb.stanza.size() << "\n";
+        out.write(deb.stanza.data(), deb.stanza.size());
+    }
+    out.close();
+    if (!out || rename(tmp_path.c_str(), path.c_str()) != 0) unlink(tmp_path.c_str());
+}
+
+static bool write_file_atomic(const std::string& path, const std::string& data) {
+    std::string tmp_path = path + ".tmp";
+    std::ofstream out(tmp_path, std::ios::binary);
+    out.write(data.data(), data.size());
+    out.close();
+    if (!out || rename(tmp_path.c_str(), path.c_str()) != 0) { unlink(tmp_path.c_str()); return false; }
+    return true;
+}
+
+static bool write_gz_atomic(const std::string& path, const std::string& data) {
+    std::string tmp_path = path + ".tmp";
+    gzFile out = gzopen(tmp_path.c_str(), "wb9");
+    bool ok = out != nullptr;
+    // gzwrite takes an unsigned length; feed large lists in pieces.
+    for (size_t off = 0; ok && off < data.size(); off += 1 << 30) {
+        unsigned int len = (unsigned int)std::min(data.size() - off, (size_t)1 << 30);
+        ok = gzwrite(out, data.data() + off, len) == (int)len;
+    }
+    if (out && gzclose(out) != Z_OK) ok = false;
+    if (!ok || rename(tmp_path.c_str(), path.c_str()) != 0) { unlink(tmp_path.c_str()); return false; }
+    return true;
+}
+
+// Release entry for one list file: " <hash> <size> <name>".
+static void release_entries(const std::string& rel_name, const std::string& data, std::string& md5_lines, std::string& sha256_lines) {
+    MultiDigest digest({EVP_md5(), EVP_sha256()});
+    digest.update(data.data(), data.size());
+    std::vector<std::string> d = digest.finish();
+    if (d.size() != 2) return;
+    char size[32];
+    snprintf(size, sizeof(size), " %16zu ", data.size());
+    md5_lines += " " + d[0] + size + rel_name + "\n";
+    sha256_lines += " " + d[1] + size + rel_name + "\n";
+}
+
+static bool read_whole_file(const std::string& path, std::string& data) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) return false;
+    std::ostringstream ss;
+    ss << in.rdbuf();
+    data = ss.str();
+    return true;
+}
+
+extern "C" int runepkg_repo_scan(const char *dir) {
+    if (!dir) return -1;
+    char resolved[PATH_MAX];
+    if (!realpath(dir, resolved)) { std::cerr << "Error: Cannot open repository directory " << dir << ": " << strerror(errno) << std::endl; return -1; }
+    std::string root = resolved;
+    auto start_time = std::chrono::high_resolution_clock::now();
+
+    std::vector<ScannedDeb> debs;
+    scan_collect_debs(root, "", debs);
+    std::string cache_path = root + "/" + SCAN_CACHE_NAME;
+    std::unordered_map<std::string, ScannedDeb> cache = load_scan_cache(cache_path);
+    std::vector<size_t> to_read;
+    for (size_t i = 0; i < debs.size(); i++) {
+        auto it = cache.find(debs[i].rel_path);
+        if (it != cache.end() && it->second.ino == debs[i].ino && it->second.size == debs[i].size && it->second.mtime_ns == debs[i].mtime_ns) debs[i].stanza = std::move(it->second.stanza);
+        else to_read.push_back(i);
+    }
+    cache.clear();
+    std::cout << "\033[1;32m[runepkg]\033[0m Scanning " << debs.size() << " packages in " << root << " (" << debs.size() - to_read.size() << " unchanged, " << to_read.size() << " to read)..." << std::endl;
+
+    // Workers pull debs off a shared counter; each one is read and hashed whole.
+    std::atomic<size_t> next(0);
+    std::vector<char> failed(debs.size(), 0);
+    unsigned int workers = std::max(1u, std::min(std::thread::hardware_concurrency(), (unsigned int)to_read.size()));
+    std::vector<std::future<void>> futures;
+    for (unsigned int w = 0; w < workers && !to_read.empty(); w++) {
+        futures.push_back(std::async(std::launch::async, [&]() {
+            for (size_t k; (k = next.fetch_add(1)) < to_read.size();) {
+                if (!scan_deb(root, debs[to_read[k]])) failed[to_read[k]] = 1;
+            }
+        }));
+    }
+    for (auto& f : futures) f.get();
+
+    std::vector<ScannedDeb> packages;
+    std::set<std::string> archs;
+    for (size_t i = 0; i < debs.size(); i++) {
+        if (failed[i]) { std::cerr << "Warning: Skipping " << debs[i].rel_path << ": not a readable .deb package." << std::endl; continue; }
+        ScannedDeb& deb = debs[i];
+        deb.package = stanza_field(deb.stanza, "Package");
+        deb.version = stanza_field(deb.stanza, "Version");
+        deb.arch = stanza_field(deb.stanza, "Architecture");
+        if (deb.package.empty() || deb.version.empty()) { std::cerr << "Warning: Skipping " << deb.rel_path << ": control file has no Package or Version." << std::endl; continue; }
+        if (!deb.arch.empty() && deb.arch != "all") archs.insert(deb.arch);
+        packages.push_back(std::move(deb));
+    }
+    save_scan_cache(cache_path, packages);
+    if (archs.empty()) archs.insert(runepkg_config_native_arch());
+    std::sort(packages.begin(), packages.end(), [](const ScannedDeb& a, const ScannedDeb& b) {
+        if (a.package != b.package) return a.package < b.package;
+        if (a.version != b.version) return a.version < b.version;
+        return a.rel_path < b.rel_path;
+    });
+
+    std::string dists = root + "/dists/" + SCAN_SUITE;
+    std::string md5_lines, sha256_lines;
+    bool changed = !runepkg_util_file_exists((dists + "/Release").c_str());
+    for (const auto& arch : archs) {
+        std::string rel_dir = std::string(SCAN_COMPONENT) + "/binary-" + arch;
+        std::string list_dir = dists + "/" + rel_dir;
+        if (runepkg_util_create_dir_recursive(list_dir.c_str(), 0755) != 0) { std::cerr << "Error: Cannot create " << list_dir << std::endl; return -1; }
+        std::string text;
+        size_t count = 0;
+        for (const auto& p : packages) {
+            if (p.arch != arch && p.arch != "all") continue;
+            if (!text.empty()) text += "\n";
+            text += p.stanza;
+            count++;
+        }
+        std::string list = list_dir + "/Packages", old_text;
+        bool xz = xz_available();
+        bool current = read_whole_file(list, old_text) && old_text == text && runepkg_util_file_exists((list + ".gz").c_str()) &&
+                       (!xz || runepkg_util_file_exists((list + ".xz").c_str()));
+        if (!current) {
+            changed = true;
+            bool ok = write_file_atomic(list, text) && write_gz_atomic(list + ".gz", text);
+            std::string xz_data;
+            const char *argv[] = {"xz", "-c", "-6", nullptr};
+            if (ok && xz) ok = pipe_through(argv, text, xz_data) && write_file_atomic(list + ".xz", xz_data);
+            else if (!xz) unlink((list + ".xz").c_str());
+            if (!ok) { std::cerr << "Error: Failed to write " << list << std::endl; return -1; }
+        }
+        std::cout << "  " << rel_dir << ": " << count << " packages" << (current ? " (unchanged)" : "") << std::endl;
+        release_entries(rel_dir + "/Packages", text, md5_lines, sha256_lines);
+        for (const char *ext : {".gz", ".xz"}) {
+            std::string data;
+            if (read_whole_file(list + ext, data)) release_entries(rel_dir + "/Packages" + ext, data, md5_lines, sha256_lines);
+        }
+    }
+
+    // Lists of architectures whose last package has left the tree go too, and
+    // the Release is rewritten without them.
+    std::string component_dir = dists + "/" + SCAN_COMPONENT;
+    if (DIR *d = opendir(component_dir.c_str())) {
+        while (struct dirent *e = readdir(d)) {
+            std::string entry = e->d_name;
+            if (entry.compare(0, 7, "binary-") != 0 || archs.count(entry.substr(7))) continue;
+            std::string list_dir = component_dir + "/" + entry;
+            for (const char *name : {"/Packages", "/Packages.gz", "/Packages.xz"}) unlink((list_dir + name).c_str());
+            rmdir(list_dir.c_str());
+            std::cout << "  " << SCAN_COMPONENT << "/" << entry << ": removed (no packages left)" << std::endl;
+            changed = true;
+        }
+        closedir(d);
+    }
+
+    if (changed) {
+        char date[64];
+        time_t now = time(nullptr);
+        struct tm tm_utc;
+        gmtime_r(&now, &tm_utc);
+        strftime(date, sizeof(date), "%a, %d %b %Y %H:%M:%S UTC", &tm_utc);
+        std::string release = "Origin: runepkg\nLabel: runepkg\nSuite: " + std::string(SCAN_SUITE) + "\nCodename: " + SCAN_SUITE + "\nDate: " + date + "\nArchitectures:";
+        for (const auto& arch : archs) release += " " + arch;
+        release += "\nComponents: " + std::string(SCAN_COMPONENT) + "\nDescription: Local repository generated by runepkg scan-repo\n";
+        release += "MD5Sum:\n" + md5_lines + "SHA256:\n" + sha256_lines;
+        if (!write_file_atomic(dists + "/Release", release)) { std::cerr << "Error: Failed to write " << dists << "/Release" << std::endl; return -1; }
+        // A stale InRelease would be preferred over the Release just written.
+        unlink((dists + "/InRelease").c_str());
+    }
+
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start_time);
+    std::cout << "\033[1;32mScan complete!\033[0m " << packages.size() << " packages indexed in " << std::fixed << std::setprecision(1) << duration.count() / 1000.0 << "s" << std::defaultfloat
+              << (changed ? "" : "; repository unchanged") << "." << std::endl;
+    std::cout << "Use it with: deb file://" << root << " " << SCAN_SUITE << " " << SCAN_COMPONENT << std::endl;
+    return 0;
+}
+
+// --- LAN package cache (serve) ---
+// Serves this node's download_dir and package lists over HTTP so other
+// machines can use it as their mirror ("deb http://<node>:3142/ <suite> ..."),
+// fetching anything it does not have from the first configured deb source.
+// Request paths map onto that source's layout:
+//   pool/.../<name>.deb   -> download_dir/<name>.deb (where installs put them)
+//   dists/...             -> this node's lists from its last 'runepkg update',
+//                            but only a list stored exactly as published whose
+//                            hash is the one the served Release (or by-hash
+//                            path) names; a list transcoded from .xz never is
+//   anything else, and dists files this node does not have
+//                         -> db/serve_cache/, fetched from upstream on demand
+//                            (a list the served Release names is fetched by hash
+//                            when the suite allows it, so it matches that Release)
+//                            and trimmed on the download cache's eviction pass:
+//                            by-hash lists once no served Release names them,
+//                            everything else once unused for SERVE_CACHE_IDLE
+static const int SERVE_DEFAULT_PORT = 3142;
+static const int SERVE_MAX_CLIENTS = 256;
+static const time_t SERVE_LIST_TTL = 300;        // Refetch cached dists/ files older than this
+static const time_t SERVE_EVICT_INTERVAL = 60;   // Minimum gap between download cache trims
+static const time_t SERVE_CACHE_IDLE = 7 * 24 * 3600; // Drop serve_cache files unused this long
+static const size_t SERVE_MAX_HEADER = 16384;
+
+static std::mutex g_serve_mutex;
+static std::map<std::string, std::shared_future<bool>> g_serve_inflight;
+static std::atomic<int> g_serve_clients(0);
+static std::atomic<time_t> g_serve_last_evict(0);
+static std::map<std::string, time_t> g_serve_missing; // Upstream 404s, retried after SERVE_LIST_TTL
+
+static bool serve_ends_with(const std::string& s, const std::string& suffix) {
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// Fetches url to dest through a temporary, so readers only ever see whole files.
+static bool serve_fetch_upstream(const std::string& url, const std::string& dest) {
+    std::string tmp_path = dest + ".serve-" + std::to_string(getpid()) + "-" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+    bool ok;
+    std::string local_path = local_url_path(url);
+    if (!local_path.empty()) {
+        ok = link_local_file(local_path, tmp_path);
+    } else {
+        CURL *curl = curl_easy_init();
+        FILE *fp = curl ? fopen(tmp_path.c_str(), "wb") : nullptr;
+        ok = fp != nullptr;
+        if (ok) {
+            curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_data);
+            curl_easy_setopt(curl, CURLOPT_WRITEDATA, fp);
+            curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+            curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+            curl_easy_setopt(curl, CURLOPT_TIMEOUT, 300L);
+            curl_easy_setopt(curl, CURLOPT_USERAGENT, "runepkg/1.0");
+            ok = curl_easy_perform(curl) == CURLE_OK;
+            if (fclose(fp) != 0) ok = false;
+        }
+        if (curl) curl_easy_cleanup(curl);
+    }
+    if (!ok || rename(tmp_path.c_str(), dest.c_str()) != 0) { unlink(tmp_path.c_str()); return false; }
+    return true;
+}
+
+// Fetches url into dest unless another client is already doing so, in which
+// case this waits for and shares that one transfer.
+static bool serve_fetch_coalesced(const std::string& url, const std::string& dest) {
+    std::promise<bool> done;
+    std::shared_future<bool> pending;
+    {
+        std::lock_guard<std::mutex> lock(g_serve_mutex);
+        auto it = g_serve_inflight.find(dest);
+        if (it != g_serve_inflight.end()) pending = it->second;
+        else g_serve_inflight[dest] = done.get_future().share();
+    }
+    if (pending.valid()) return pending.get();
+    if (g_verbose_mode) std::cout << "  fetching " << url << std::endl;
+    bool ok = serve_fetch_upstream(url, dest);
+    done.set_value(ok);
+    std::lock_guard<std::mutex> lock(g_serve_mutex);
+    g_serve_inflight.erase(dest);
+    return ok;
+}
+
+// This node's copy of a by-hash list: the list in db/lists under dir stored
+// verbatim under the Release SHA256 hash.
+static std::string serve_find_by_hash(const std::string& upstream, const std::string& dir, const std::string& hash) {
+    std::string prefix = list_cache_path(upstream + dir + "/");
+    prefix = prefix.substr(prefix.find_last_of('/') + 1);
+    DIR *d = opendir(g_runepkg_lists_dir);
+    if (!d) return "";
+    std::string found;
+    struct dirent *de;
+    while (found.empty() && (de = readdir(d)) != NULL) {
+        std::string name = de->d_name;
+        if (name.compare(0, prefix.size(), prefix) != 0 || !serve_ends_with(name, ".gz")) continue;
+        // Only lists directly in dir, not in a subdirectory of it.
+        if (name.find('_', prefix.size()) != std::string::npos) continue;
+        std::string path = std::string(g_runepkg_lists_dir) + "/" + name;
+        if (list_stored_verbatim(path, hash)) found = path;
+    }
+    closedir(d);
+    return found;
+}
+
+// The entry for dists/<suite>/<rel> in the Release this node serves for the
+// suite (its own InRelease, else Release, as 'runepkg update' left them).
+static bool serve_release_entry(const std::string& upstream, const std::string& path, ReleaseFile& entry, bool& by_hash) {
+    size_t suite_end = path.find('/', 6);
+    if (suite_end == std::string::npos) return false;
+    std::string suite_dir = path.substr(0, suite_end);
+    ReleaseInfo info;
+    for (const char *name : {"/InRelease", "/Release"}) {
+        std::string release = list_cache_path(upstream + suite_dir + name);
+        if (!runepkg_util_file_exists(release.c_str())) continue;
+        if (!parse_release(release, info)) return false;
+        auto it = info.files.find(path.substr(suite_end + 1));
+        if (it == info.files.end()) return false;
+        entry = it->second; by_hash = info.by_hash;
+        return true;
+    }
+    return false;
+}
+
+// Every SHA256 named by a Release this node serves: its own from the last
+// 'runepkg update', and any fetched into serve_cache.
+static std::unordered_set<std::string> serve_named_hashes(const std::string& upstream, const std::string& cache_dir) {
+    std::unordered_set<std::string> hashes;
+    std::string prefix = list_cache_path(upstream + "dists/");
+    prefix = prefix.substr(prefix.find_last_of('/') + 1);
+    for (const std::string& dir : {std::string(g_runepkg_lists_dir), cache_dir}) {
+        std::string want = dir == cache_dir ? "dists_" : prefix;
+        DIR *d = opendir(dir.c_str());
+        if (!d) continue;
+        struct dirent *de;
+        while ((de = readdir(d)) != NULL) {
+            std::string name = de->d_name;
+            if (name.compare(0, want.size(), want) != 0) continue;
+            if (!serve_ends_with(name, "_Release") && !serve_ends_with(name, "_InRelease")) continue;
+            ReleaseInfo info;
+            if (!parse_release(dir + "/" + name, info)) continue;
+            for (const auto& file : info.files) hashes.insert(file.second.sha256);
+        }
+        closedir(d);
+    }
+    return hashes;
+}
+
+// Bounds db/serve_cache: by-hash lists no served Release names any more go
+// once older than SERVE_LIST_TTL, and anything else once untouched for
+// SERVE_CACHE_IDLE (hits refresh immutable files, refetches refresh lists).
+static void serve_trim_cache(const std::string& upstream, time_t now) {
+    std::string cache_dir = std::string(g_runepkg_db_dir) + "/serve_cache";
+    DIR *d = opendir(cache_dir.c_str());
+    if (!d) return;
+    std::unordered_set<std::string> named;
+    bool named_loaded = false;
+    int removed = 0;
+    struct dirent *de;
+    while ((de = readdir(d)) != NULL) {
+        std::string name = de->d_name;
+        if (name[0] == '.') continue;
+        std::string path = cache_dir + "/" + name;
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) continue;
+        time_t age = now - st.st_mtime;
+        bool stale;
+        size_t by_hash = name.find("_by-hash_SHA256_");
+        if (by_hash != std::string::npos && name.find(".serve-") == std::string::npos) {
+            if (age < SERVE_LIST_TTL) continue;
+            if (!named_loaded) { named = serve_named_hashes(upstream, cache_dir); named_loaded = true; }
+            stale = named.count(name.substr(by_hash + 16)) == 0;
+        } else {
+            // Includes fetch temporaries left behind by a killed node.
+            stale = age >= SERVE_CACHE_IDLE;
+        }
+        if (stale && unlink(path.c_str()) == 0) removed++;
+    }
+    closedir(d);
+    if (removed > 0 && g_verbose_mode) std::cout << "  serve_cache: removed " << removed << " stale files" << std::endl;
+}
+
+// Local file to answer a request path with (path has no leading '/'),
+// fetching it from upstream first if needed; empty when unavailable.
+static std::string serve_resolve(const std::string& upstream, const std::string& request_path, const char **how) {
+    std::string path = request_path;
+    std::string url = upstream + path;
+    std::string name = path.substr(path.find_last_of('/') + 1);
+    std::string cached;
+    bool in_serve_cache = false;
+    bool list = path.compare(0, 6, "dists/") == 0;
+    bool immutable = !list || path.find("/by-hash/") != std::string::npos;
+    *how = "hit";
+    if (serve_ends_with(name, ".deb") || serve_ends_with(name, ".udeb")) {
+        cached = std::string(g_download_dir) + "/" + name;
+    } else {
+        if (list) {
+            size_t by_hash = path.find("/by-hash/SHA256/");
+            ReleaseFile entry; bool release_by_hash = false;
+            if (by_hash != std::string::npos) {
+                std::string own = serve_find_by_hash(upstream, path.substr(0, by_hash), path.substr(by_hash + 16));
+                if (!own.empty()) return own;
+            } else if (serve_release_entry(upstream, path, entry, release_by_hash)) {
+                // A list the served Release names: answer with exactly those bytes.
+                std::string own = list_cache_path(url);
+                if (list_stored_verbatim(own, entry.sha256)) return own;
+                if (release_by_hash) {
+                    path = path.substr(0, path.find_last_of('/')) + "/by-hash/SHA256/" + entry.sha256;
+                    url = upstream + path;
+                    immutable = true;
+                }
+            } else {
+                // Release/InRelease themselves, and files no Release lists.
+                std::string own = list_cache_path(url);
+                if (runepkg_util_file_exists(own.c_str())) return own;
+            }
+        }
+        std::string safe = path;
+        std::replace(safe.begin(), safe.end(), '/', '_');
+        std::string cache_dir = std::string(g_runepkg_db_dir) + "/serve_cache";
+        runepkg_util_create_dir_recursive(cache_dir.c_str(), 0755);
+        cached = cache_dir + "/" + safe;
+        in_serve_cache = true;
+    }
+    struct stat st;
+    if (stat(cached.c_str(), &st) == 0 && (immutable || time(nullptr) - st.st_mtime < SERVE_LIST_TTL)) {
+        // serve_cache ages by mtime; a list's mtime is its fetch time, so only immutable files are refreshed.
+        if (in_serve_cache && immutable) utimensat(AT_FDCWD, cached.c_str(), NULL, 0);
+        else runepkg_cache_touch(cached.c_str());
+        return cached;
+    }
+    *how = "fetched";
+    {
+        std::lock_guard<std::mutex> lock(g_serve_mutex);
+        auto it = g_serve_missing.find(path);
+        if (it != g_serve_missing.end() && time(nullptr) - it->second < SERVE_LIST_TTL) return "";
+    }
+    if (!serve_fetch_coalesced(url, cached)) {
+        std::lock_guard<std::mutex> lock(g_serve_mutex);
+        g_serve_missing[path] = time(nullptr);
+        return "";
+    }
+    runepkg_cache_touch(cached.c_str());
+    time_t now = time(nullptr), last = g_serve_last_evict.load();
+    if (now - last >= SERVE_EVICT_INTERVAL && g_serve_last_evict.compare_exchange_strong(last, now)) {
+        if (runepkg_cache_enabled()) runepkg_cache_evict((uint64_t)g_download_cache_mb << 20, NULL, NULL);
+        serve_trim_cache(upstream, now);
+    }
+    return cached;
+}
+
+static bool serve_send_all(int fd, const std::string& data) {
+    size_t off = 0;
+    while (off < data.size()) {
+        ssize_t n = send(fd, data.data() + off, data.size() - off, MSG_NOSIGNAL);
+        if (n < 0) { if (errno == EINTR) continue; return false; }
+        off += n;
+    }
+    return true;
+}
+
+static bool serve_send_status(int fd, int code, const char *reason, bool keep_alive, const std::string& extra = "") {
+    std::string body = std::to_string(code) + " " + reason + "\n";
+    return serve_send_all(fd, "HTTP/1.1 " + std::to_string(code) + " " + reason + "\r\nContent-Type: text/plain\r\nContent-Length: " +
+                              std::to_string(body.size()) + "\r\n" + extra + "Connection: " + (keep_alive ? "keep-alive" : "close") + "\r\n\r\n" + body);
+}
+
+// Request target -> repository path without the leading '/', or empty if it
+// is not a plain path inside the repository.
+static std::string serve_clean_path(const std::string& target) {
+    std::string raw = target.substr(0, target.find('?'));
+    if (raw.empty() || raw[0] != '/') return "";
+    std::string path;
+    for (size_t i = 1; i < raw.size(); i++) {
+        if (raw[i] == '%' && i + 2 < raw.size() && isxdigit((unsigned char)raw[i + 1]) && isxdigit((unsigned char)raw[i + 2])) {
+            path += (char)std::stoi(raw.substr(i + 1, 2), nullptr, 16);
+            i += 2;
+        } else {
+            path += raw[i];
+        }
+    }
+    std::stringstream ss(path);
+    std::string segment;
+    while (std::getline(ss, segment, '/')) {
+        if (segment == ".." || segment == "." || segment.find('\0') != std::string::npos) return "";
+    }
+    return path.empty() || path.back() == '/' ? "" : path;
+}
+
+// Parses a single "bytes=a-b" range against size; false if it cannot be satisfied.
+// Forms this does not handle (several ranges) leave the whole file selected.
+static bool serve_parse_range(const std::string& value, uint64_t size, uint64_t& start, uint64_t& end, bool& partial) {
+    start = 0; end = size; partial = false;
+    if (value.compare(0, 6, "bytes=") != 0 || value.find(',') != std::string::npos) return true;
+    std::string spec = value.substr(6);
+    size_t dash = spec.find('-');
+    if (dash == std::string::npos) return true;
+    std::string a = spec.substr(0, dash), b = spec.substr(dash + 1);
+    try {
+        if (a.empty()) {
+            uint64_t suffix = std::stoull(b);
+            if (suffix == 0) return false;
+            start = suffix >= size ? 0 : size - suffix;
+        } else {
+            start = std::stoull(a);
+            if (!b.empty()) end = std::min<uint64_t>(std::stoull(b) + 1, size);
+        }
+    } catch (...) {
+        return true;
+    }
+    if (start >= size || start >= end) return false;
+    partial = true;
+    return true;
+}
+
+static void serve_client(int fd, std::string upstream) {
+    struct timeval tv = {30, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    std::string buf;
+    bool keep_alive = true;
+    while (keep_alive) {
+        size_t head_end;
+        char chunk[4096];
+        while ((head_end = buf.find("\r\n\r\n")) == std::string::npos) {
+            ssize_t n = buf.size() > SERVE_MAX_HEADER ? -1 : recv(fd, chunk, sizeof(chunk), 0);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) { close(fd); g_serve_clients--; return; }
+            buf.append(chunk, n);
+        }
+        std::istringstream head(buf.substr(0, head_end));
+        buf.erase(0, head_end + 4);
+        std::string line, method, target, version, range, connection;
+        std::getline(head, line);
+        std::istringstream request_line(line);
+        request_line >> method >> target >> version;
+        while (std::getline(head, line)) {
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            size_t colon = line.find(':');
+            if (colon == std::string::npos) continue;
+            std::string key = line.substr(0, colon), value = line.substr(colon + 1);
+            std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+            value.erase(0, value.find_first_not_of(" \t"));
+            if (key == "range") range = value;
+            else if (key == "connection") { connection = value; std::transform(connection.begin(), connection.end(), connection.begin(), ::tolower); }
+        }
+        keep_alive = version == "HTTP/1.1" ? connection != "close" : connection == "keep-alive";
+
+        if (method != "GET" && method != "HEAD") { serve_send_status(fd, 405, "Method Not Allowed", false, "Allow: GET, HEAD\r\n"); break; }
+        std::string path = serve_clean_path(target);
+        const char *how = "miss";
+        std::string file = path.empty() ? "" : serve_resolve(upstream, path, &how);
+        int file_fd = file.empty() ? -1 : open(file.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat st;
+        if (file_fd < 0 || fstat(file_fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+            if (file_fd >= 0) close(file_fd);
+            if (g_verbose_mode) std::cout << "  " << method << " /" << path << " 404" << std::endl;
+            if (!serve_send_status(fd, 404, "Not Found", keep_alive)) break;
+            continue;
+        }
+        uint64_t size = st.st_size, start, end;
+        bool partial;
+        if (!serve_parse_range(range, size, start, end, partial)) {
+            close(file_fd);
+            if (!serve_send_status(fd, 416, "Range Not Satisfiable", keep_alive, "Content-Range: bytes */" + std::to_string(size) + "\r\n")) break;
+            continue;
+        }
+        char modified[64];
+        struct tm tm_utc;
+        gmtime_r(&st.st_mtime, &tm_utc);
+        strftime(modified, sizeof(modified), "%a, %d %b %Y %H:%M:%S GMT", &tm_utc);
+        std::string header = std::string("HTTP/1.1 ") + (partial ? "206 Partial Content" : "200 OK") + "\r\n" +
+                             "Content-Type: application/octet-stream\r\nAccept-Ranges: bytes\r\n" +
+                             "Content-Length: " + std::to_string(end - start) + "\r\nLast-Modified: " + modified + "\r\n";
+        if (partial) header += "Content-Range: bytes " + std::to_string(start) + "-" + std::to_string(end - 1) + "/" + std::to_string(size) + "\r\n";
+        header += std::string("Connection: ") + (keep_alive ? "keep-alive" : "close") + "\r\n\r\n";
+        bool ok = serve_send_all(fd, header);
+        if (ok && method == "GET") {
+            // The kernel moves the file to the socket; nothing is copied through here.
+            off_t off = start;
+            while (ok && (uint64_t)off < end) {
+                ssize_t n = sendfile(fd, file_fd, &off, std::min<uint64_t>(end - off, 1 << 30));
+                if (n < 0 && errno == EINTR) continue;
+                if (n <= 0) ok = false;
+            }
+        }
+        close(file_fd);
+        if (g_verbose_mode) std::cout << "  " << method << " /" << path << " " << (partial ? 206 : 200) << " " << how << " " << end - start << " bytes" << std::endl;
+        if (!ok) break;
+    }
+    close(fd);
+    g_serve_clients--;
+}
+
+extern "C" int runepkg_serve(int port) {
+    if (port <= 0) port = SERVE_DEFAULT_PORT;
+    std::string upstream;
+    for (int i = 0; i < g_sources_count && upstream.empty(); i++) {
+        if (std::string(g_sources[i]->type) == "deb") upstream = g_sources[i]->url;
+    }
+    if (upstream.empty()) { std::cerr << "Error: No deb sources configured in runepkgconfig to serve." << std::endl; return -1; }
+    if (upstream.back() != '/') upstream += '/';
+
+    int listener = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listener < 0) { std::cerr << "Error: Cannot create socket: " << strerror(errno) << std::endl; return -1; }
+    int one = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(listener, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(listener, 128) != 0) {
+        std::cerr << "Error: Cannot listen on port " << port << ": " << strerror(errno) << std::endl;
+        close(listener);
+        return -1;
+    }
+    // A client going away mid-transfer must not end the server.
+    signal(SIGPIPE, SIG_IGN);
+    curl_global_init(CURL_GLOBAL_ALL);
+    std::cout << "\033[1;32m[runepkg]\033[0m Serving " << g_download_dir << " and package lists on port " << port << " (upstream: " << upstream << ")" << std::endl;
+    std::cout << "Clients use: deb http://<this-host>:" << port << "/ <suite> <components>" << std::endl;
+    while (true) {
+        int fd = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (errno == EMFILE || errno == ENFILE) { usleep(100000); continue; }
+            std::cerr << "Error: accept failed: " << strerror(errno) << std::endl;
+            break;
+        }
+        if (g_serve_clients >= SERVE_MAX_CLIENTS) {
+            serve_send_status(fd, 503, "Service Unavailable", false);
+            close(fd);
+            continue;
+        }
+        g_serve_clients++;
+        std::thread(serve_client, fd, upstream).detach();
+    }
+    close(listener);
+    curl_global_cleanup();
+    return -1;
+}
@@ -64,6 +64,8 @@ void runepkg_pack_init_package_info(PkgInfo *pkg_info) {
     pkg_info->data_dir_path = NULL;
     pkg_info->file_list = NULL;
     pkg_info->file_count = 0;
+    pkg_info->excluded_files = NULL;
+    pkg_info->excluded_count = 0;
 }
 
 /**
@@ -100,6 +102,15 @@ void runepkg_pack_free_package_info(PkgInfo *pkg_info) {
         pkg_info->file_list = NULL;
     }
     pkg_info->file_count = 0;
+
+    if (pkg_info->excluded_files) {
+        for (int i = 0; i < pkg_info->excluded_count; i++) {
+            runepkg_util_free_and_null(&pkg_info->excluded_files[i]);
+        }
+        free(pkg_info->excluded_files);
+        pkg_info->excluded_files = NULL;
+    }
+    pkg_info->excluded_count = 0;
 }
 
 /**
@@ -210,6 +221,84 @@ int runepkg_pack_parse_control_file(const char *control_file_path, PkgInfo *pkg_
     return 0;
 }
 
+// --- Path Filters ---
+
+static int add_excluded_file(PkgInfo *pkg_info, char *path, int *capacity) {
+    if (pkg_info->excluded_count >= *capacity) {
+        *capacity = (*capacity == 0) ? 32 : (*capacity * 2);
+        char **new_list = realloc(pkg_info->excluded_files, sizeof(char*) * (*capacity));
+        if (!new_list) {
+            runepkg_util_error("Failed to reallocate memory for excluded file list.\n");
+            return -1;
+        }
+        pkg_info->excluded_files = new_list;
+    }
+    pkg_info->excluded_files[pkg_info->excluded_count++] = path;
+    return 0;
+}
+
+/**
+ * @brief Moves files matched by path-exclude rules out of the install list.
+ *
+ * Paths tar already skipped are recovered from the md5sums control file, so
+ * the stored record names every shipped file that was left off the disk.
+ * @param pkg_info Package info with file_list and extraction paths populated.
+ * @return 0 on success, -1 on failure.
+ */
+static int apply_path_filters(PkgInfo *pkg_info) {
+    int capacity = 0;
+    int kept = 0;
+
+    for (int i = 0; i < pkg_info->file_count; i++) {
+        char *path = pkg_info->file_list[i];
+        if (runepkg_config_path_excluded(path)) {
+            if (add_excluded_file(pkg_info, path, &capacity) != 0) {
+                // Keep the list intact so the caller frees every entry
+                for (int j = i; j < pkg_info->file_count; j++) pkg_info->file_list[kept++] = pkg_info->file_list[j];
+                pkg_info->file_count = kept;
+                return -1;
+            }
+        } else {
+            pkg_info->file_list[kept++] = path;
+        }
+    }
+    pkg_info->file_count = kept;
+
+    char *md5sums_path = runepkg_util_concat_path(pkg_info->control_dir_path, "md5sums");
+    FILE *fp = md5sums_path ? fopen(md5sums_path, "r") : NULL;
+    runepkg_util_free_and_null(&md5sums_path);
+    if (fp) {
+        char line[PATH_MAX + 64];
+        while (fgets(line, sizeof(line), fp)) {
+            char *rel = strstr(line, "  ");
+            if (!rel) continue;
+            rel = runepkg_util_trim_whitespace(rel);
+            if (*rel == '\0' || !runepkg_config_path_excluded(rel)) continue;
+
+            // Files still in the data dir were handled above; absent ones were dropped by tar
+            char *on_disk = runepkg_util_concat_path(pkg_info->data_dir_path, rel);
+            struct stat st;
+            bool present = on_disk && lstat(on_disk, &st) == 0;
+            runepkg_util_free_and_null(&on_disk);
+            if (present) continue;
+
+            char *copy = strdup(rel);
+            if (!copy || add_excluded_file(pkg_info, copy, &capacity) != 0) {
+                free(copy);
+                fclose(fp);
+                return -1;
+            }
+        }
+        fclose(fp);
+    }
+
+    if (pkg_info->excluded_count > 0) {
+        runepkg_util_log_verbose("Path filters excluded %d files from %s.\n",
+                                 pkg_info->excluded_count, pkg_info->package_name ? pkg_info->package_name : "package");
+    }
+    return 0;
+}
+
 // --- Main Package Processing Function ---
 
 /**
@@ -256,7 +345,7 @@ int runepkg_pack_extract_and_collect_info(const char *deb_path, const char *cont
     
     runepkg_util_log_verbose("Extracting to directory: %s\n", package_extract_dir);
     
-    if (runepkg_util_extract_deb_complete(deb_path, package_extract_dir) != 0) {
+    if (runepkg_util_extract_deb_excluding(deb_path, package_extract_dir, runepkg_config_tar_excludes()) != 0) {
         runepkg_util_error("Failed to extract .deb package.\n");
         runepkg_util_free_and_null(&package_extract_dir);
         runepkg_pack_free_package_info(pkg_info);
@@ -297,6 +386,14 @@ int runepkg_pack_extract_and_collect_info(const char *deb_path, const char *cont
         return -1;
     }
     
+    if (g_path_filters_count > 0 && apply_path_filters(pkg_info) != 0) {
+        runepkg_util_error("Failed to apply path filters.\n");
+        runepkg_util_free_and_null(&control_file_path);
+        runepkg_util_free_and_null(&package_extract_dir);
+        runepkg_pack_free_package_info(pkg_info);
+        return -1;
+    }
+    
     runepkg_util_free_and_null(&control_file_path);
     runepkg_util_free_and_null(&package_extract_dir);
     
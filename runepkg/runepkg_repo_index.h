@@ -0,0 +1,82 @@
+/******************************************************************************
+ * Filename:    runepkg_repo_index.h
+ * Author:      <michkochris@gmail.com>
+ * Date:        started 01-03-2025
+ * Description: On-disk layout of repo_index.bin / repo_src_index.bin
+ *
+ * Copyright (c) 2025 runepkg (Runar Linux) All rights reserved.
+ * GPLV3
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <https://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#ifndef RUNEPKG_REPO_INDEX_H
+#define RUNEPKG_REPO_INDEX_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * The repository indexes are written by the C++ update code and mapped by
+ * both it and the C completion code, so the layout lives here once:
+ *     RepoIndexHeader, then header.count RepoIndexEntry records sorted by
+ *     (name, arch).
+ * The header carries the writer's entry size; a reader built with another
+ * layout (or an index from an older runepkg) refuses the file and the next
+ * 'runepkg update' rewrites it.
+ */
+
+#define RUNEPKG_REPO_INDEX_MAGIC   0x58444952u /* "RIDX" */
+#define RUNEPKG_REPO_INDEX_VERSION 1u
+
+typedef struct RepoIndexHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entry_size;   // sizeof(RepoIndexEntry) of the writer
+    uint32_t count;
+} RepoIndexHeader;
+
+typedef struct RepoIndexEntry {
+    char name[64];
+    uint32_t file_id;      // Line of the index's file list (repo_files.txt)
+    uint32_t offset;       // Stanza offset within that list
+    uint16_t arch;         // Row of the index's .archs table
+    uint16_t reserved;
+} RepoIndexEntry;
+
+/**
+ * @brief Validates a mapped repository index.
+ * @param map Start of the mapping.
+ * @param map_size Size of the mapping in bytes.
+ * @param count Receives the number of entries (0 when invalid).
+ * @return The first entry, or NULL when the mapping is not an index of this layout.
+ */
+static inline const RepoIndexEntry *runepkg_repo_index_entries(const void *map, size_t map_size, uint32_t *count) {
+    const RepoIndexHeader *hdr = (const RepoIndexHeader *)map;
+    *count = 0;
+    if (!map || map_size < sizeof(RepoIndexHeader) || hdr->magic != RUNEPKG_REPO_INDEX_MAGIC ||
+        hdr->version != RUNEPKG_REPO_INDEX_VERSION || hdr->entry_size != sizeof(RepoIndexEntry) ||
+        sizeof(RepoIndexHeader) + (uint64_t)hdr->count * sizeof(RepoIndexEntry) != map_size) return NULL;
+    *count = hdr->count;
+    return (const RepoIndexEntry *)((const char *)map + sizeof(RepoIndexHeader));
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RUNEPKG_REPO_INDEX_H
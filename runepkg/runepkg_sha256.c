@@ -0,0 +1,122 @@
+/******************************************************************************
+ * Filename:    runepkg_sha256.c
+ * Author:      <michkochris@gmail.com>
+ * Date:        2025-05-12
+ * Description: Standalone SHA-256 implementation (FIPS 180-4) for runepkg
+ * LICENSE:     GPL v3
+ ******************************************************************************/
+
+#include "runepkg_sha256.h"
+#include <stdio.h>
+#include <string.h>
+
+static const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define ROTATE_RIGHT(x, n) (((x) >> (n)) | ((x) << (32-(n))))
+#define CH(x, y, z) (((x) & (y)) ^ (~(x) & (z)))
+#define MAJ(x, y, z) (((x) & (y)) ^ ((x) & (z)) ^ ((y) & (z)))
+#define EP0(x) (ROTATE_RIGHT(x, 2) ^ ROTATE_RIGHT(x, 13) ^ ROTATE_RIGHT(x, 22))
+#define EP1(x) (ROTATE_RIGHT(x, 6) ^ ROTATE_RIGHT(x, 11) ^ ROTATE_RIGHT(x, 25))
+#define SIG0(x) (ROTATE_RIGHT(x, 7) ^ ROTATE_RIGHT(x, 18) ^ ((x) >> 3))
+#define SIG1(x) (ROTATE_RIGHT(x, 17) ^ ROTATE_RIGHT(x, 19) ^ ((x) >> 10))
+
+static void sha256_transform(uint32_t state[8], const uint8_t block[64]) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++)
+        w[i] = ((uint32_t)block[i*4] << 24) | ((uint32_t)block[i*4+1] << 16) |
+               ((uint32_t)block[i*4+2] << 8) | (uint32_t)block[i*4+3];
+    for (int i = 16; i < 64; i++)
+        w[i] = SIG1(w[i-2]) + w[i-7] + SIG0(w[i-15]) + w[i-16];
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 64; i++) {
+        uint32_t t1 = h + EP1(e) + CH(e, f, g) + K[i] + w[i];
+        uint32_t t2 = EP0(a) + MAJ(a, b, c);
+        h = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+    state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+    state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+void runepkg_sha256_init(runepkg_sha256_ctx *ctx) {
+    static const uint32_t initial[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+    ctx->size = 0;
+    memcpy(ctx->state, initial, sizeof(initial));
+}
+
+void runepkg_sha256_update(runepkg_sha256_ctx *ctx, const uint8_t *input, size_t input_len) {
+    size_t offset = ctx->size % 64;
+    ctx->size += input_len;
+
+    if (offset) {
+        size_t take = 64 - offset;
+        if (take > input_len) take = input_len;
+        memcpy(ctx->input + offset, input, take);
+        input += take;
+        input_len -= take;
+        if (offset + take < 64) return;
+        sha256_transform(ctx->state, ctx->input);
+    }
+    for (; input_len >= 64; input += 64, input_len -= 64)
+        sha256_transform(ctx->state, input);
+    memcpy(ctx->input, input, input_len);
+}
+
+void runepkg_sha256_final(runepkg_sha256_ctx *ctx, uint8_t result[32]) {
+    uint64_t bits = ctx->size * 8;
+    size_t offset = ctx->size % 64;
+    ctx->input[offset++] = 0x80;
+    if (offset > 56) {
+        memset(ctx->input + offset, 0, 64 - offset);
+        sha256_transform(ctx->state, ctx->input);
+        offset = 0;
+    }
+    memset(ctx->input + offset, 0, 56 - offset);
+    for (int i = 0; i < 8; i++)
+        ctx->input[56 + i] = (uint8_t)(bits >> (56 - 8 * i));
+    sha256_transform(ctx->state, ctx->input);
+
+    for (int i = 0; i < 8; i++) {
+        result[i*4] = (uint8_t)(ctx->state[i] >> 24);
+        result[i*4+1] = (uint8_t)(ctx->state[i] >> 16);
+        result[i*4+2] = (uint8_t)(ctx->state[i] >> 8);
+        result[i*4+3] = (uint8_t)ctx->state[i];
+    }
+}
+
+int runepkg_sha256_file(const char *path, char output[65]) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return -1;
+
+    runepkg_sha256_ctx ctx;
+    runepkg_sha256_init(&ctx);
+
+    uint8_t buffer[65536];
+    size_t bytes;
+    while ((bytes = fread(buffer, 1, sizeof(buffer), f)) != 0)
+        runepkg_sha256_update(&ctx, buffer, bytes);
+    int failed = ferror(f);
+    fclose(f);
+    if (failed) return -1;
+
+    uint8_t hash[32];
+    runepkg_sha256_final(&ctx, hash);
+    for (int i = 0; i < 32; i++)
+        sprintf(&output[i*2], "%02x", hash[i]);
+    output[64] = '\0';
+
+    return 0;
+}
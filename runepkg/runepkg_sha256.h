@@ -0,0 +1,33 @@
+/******************************************************************************
+ * Filename:    runepkg_sha256.h
+ * Author:      <michkochris@gmail.com>
+ * Date:        2025-05-12
+ * Description: Standalone SHA-256 implementation for runepkg
+ * LICENSE:     GPL v3
+ ******************************************************************************/
+
+#ifndef RUNEPKG_SHA256_H
+#define RUNEPKG_SHA256_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef struct {
+    uint64_t size;        // Size of input in bytes
+    uint32_t state[8];    // Current intermediate hash
+    uint8_t input[64];    // Input to be used in next step
+} runepkg_sha256_ctx;
+
+void runepkg_sha256_init(runepkg_sha256_ctx *ctx);
+void runepkg_sha256_update(runepkg_sha256_ctx *ctx, const uint8_t *input, size_t input_len);
+void runepkg_sha256_final(runepkg_sha256_ctx *ctx, uint8_t result[32]);
+
+/**
+ * @brief Computes the SHA-256 hash of a file.
+ * @param path Path to the file.
+ * @param output Buffer of at least 65 bytes to store the hex string.
+ * @return 0 on success, -1 on failure.
+ */
+int runepkg_sha256_file(const char *path, char output[65]);
+
+#endif // RUNEPKG_SHA256_H
@@ -36,6 +36,9 @@
 #include "runepkg_config.h"
 #include "runepkg_util.h"
 #include "runepkg_pack.h"
+#include "runepkg_stree.h"
+#include "runepkg_sha256.h"
+#include "runepkg_md5sums.h"
 
 /* AutocompleteHeader is defined in runepkg_storage.h for shared use */
 
@@ -44,6 +47,10 @@ static int compare_packages(const void *a, const void *b) {
     return strcmp(*(const char **)a, *(const char **)b);
 }
 
+static const char *package_name_at(const void *ctx, uint32_t i) {
+    return ((char *const *)ctx)[i];
+}
+
 // --- Public Storage Functions ---
 
 /**
@@ -162,9 +169,28 @@ int runepkg_storage_write_package_info(const char *pkg_name, const char *pkg_ver
     }
     // --- END NEW CODE ---
 
+    // Paths skipped by path-exclude rules; appended last so older records stay readable
+    fwrite(&pkg_info->excluded_count, sizeof(int), 1, bin_file);
+    for (int i = 0; i < pkg_info->excluded_count; i++) {
+        WRITE_STRING(pkg_info->excluded_files[i]);
+    }
+
     fclose(bin_file);
     free(binary_file_path);
 
+    // Keep the shipped md5sums beside the record for md5check and 'db diff --files'
+    if (pkg_info->control_dir_path) {
+        char *md5sums_src = runepkg_util_concat_path(pkg_info->control_dir_path, "md5sums");
+        if (md5sums_src && runepkg_util_file_exists(md5sums_src)) {
+            char *md5sums_dst = runepkg_util_concat_path(pkg_dir_path, "md5sums");
+            if (!md5sums_dst || runepkg_util_copy_file(md5sums_src, md5sums_dst) != 0) {
+                runepkg_log_verbose("Warning: Could not store md5sums for %s\n", pkg_name);
+            }
+            free(md5sums_dst);
+        }
+        free(md5sums_src);
+    }
+
     runepkg_log_verbose("Package info written successfully to persistent storage\n");
     return 0;
 }
@@ -245,6 +271,22 @@ int runepkg_storage_read_package_info(const char *pkg_name, const char *pkg_vers
     }
     // --- END NEW CODE ---
 
+    // Records written before path filters existed simply end here
+    if (fread(&pkg_info->excluded_count, sizeof(int), 1, bin_file) != 1) {
+        pkg_info->excluded_count = 0;
+    } else if (pkg_info->excluded_count < 0) {
+        goto read_error;
+    } else if (pkg_info->excluded_count > 0) {
+        pkg_info->excluded_files = calloc(pkg_info->excluded_count, sizeof(char *));
+        if (!pkg_info->excluded_files) {
+            printf("Error: Memory allocation failed for excluded file list.\n");
+            goto read_error;
+        }
+        for (int i = 0; i < pkg_info->excluded_count; i++) {
+            READ_STRING(pkg_info->excluded_files[i]);
+        }
+    }
+
     fclose(bin_file);
     free(binary_file_path);
     runepkg_log_verbose("Package info read successfully from persistent storage\n");
@@ -654,6 +696,15 @@ int runepkg_storage_build_autocomplete_index(void) {
     char index_path[PATH_MAX];
     snprintf(index_path, sizeof(index_path), "%s/runepkg_autocomplete.bin", g_runepkg_db_dir);
 
+    // The search tree goes first: replacing it touches db_dir, and the index must stay
+    // newer than db_dir or check_rebuild_autocomplete_index() would rebuild on every Tab.
+    char tree_path[PATH_MAX];
+    snprintf(tree_path, sizeof(tree_path), "%s/runepkg_autocomplete.stree", g_runepkg_db_dir);
+    uint64_t index_size = sizeof(AutocompleteHeader) + (uint64_t)count * sizeof(uint32_t) + strings_size;
+    if (runepkg_stree_write(tree_path, package_name_at, packages, (uint32_t)count, index_size) != 0) {
+        runepkg_log_verbose("Warning: Failed to write autocomplete search tree: %s\n", tree_path);
+    }
+
     FILE *fp = fopen(index_path, "wb");
     if (!fp) {
         runepkg_log_verbose("Error: Cannot create index file: %s\n", index_path);
@@ -702,3 +753,958 @@ error_cleanup:
     }
     return -1;
 }
+
+// --- Package holds ---
+
+/**
+ * @brief Loads the hold list, sorted and de-duplicated
+ */
+char **runepkg_storage_load_holds(int *count) {
+    *count = 0;
+    if (!g_runepkg_db_dir) return NULL;
+
+    char holds_path[PATH_MAX];
+    snprintf(holds_path, sizeof(holds_path), "%s/%s", g_runepkg_db_dir, RUNEPKG_STORAGE_HOLDS_FILE);
+    FILE *fp = fopen(holds_path, "r");
+    if (!fp) return NULL;
+
+    char **holds = NULL;
+    int capacity = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), fp)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        char *name = runepkg_util_trim_whitespace(line);
+        if (!name[0] || name[0] == '#') continue;
+        if (*count == capacity) {
+            capacity = capacity ? capacity * 2 : 16;
+            char **grown = realloc(holds, capacity * sizeof(char *));
+            if (!grown) break;
+            holds = grown;
+        }
+        holds[*count] = strdup(name);
+        if (holds[*count]) (*count)++;
+    }
+    fclose(fp);
+
+    qsort(holds, *count, sizeof(char *), compare_packages);
+    int unique = 0;
+    for (int i = 0; i < *count; i++) {
+        if (unique > 0 && strcmp(holds[unique - 1], holds[i]) == 0) {
+            free(holds[i]);
+        } else {
+            holds[unique++] = holds[i];
+        }
+    }
+    *count = unique;
+    return holds;
+}
+
+/**
+ * @brief Frees a list returned by runepkg_storage_load_holds()
+ */
+void runepkg_storage_free_holds(char **holds, int count) {
+    for (int i = 0; i < count; i++) free(holds[i]);
+    free(holds);
+}
+
+/**
+ * @brief Adds or removes a package name from the hold list
+ */
+int runepkg_storage_set_hold(const char *pkg_name, bool hold) {
+    if (!pkg_name || !pkg_name[0] || !g_runepkg_db_dir) return -1;
+
+    int count = 0;
+    char **holds = runepkg_storage_load_holds(&count);
+    bool present = false;
+    for (int i = 0; i < count; i++) {
+        if (strcmp(holds[i], pkg_name) == 0) present = true;
+    }
+    if (present == hold) {
+        runepkg_storage_free_holds(holds, count);
+        return 1; // Nothing to change
+    }
+
+    char holds_path[PATH_MAX], tmp_path[PATH_MAX + 8];
+    snprintf(holds_path, sizeof(holds_path), "%s/%s", g_runepkg_db_dir, RUNEPKG_STORAGE_HOLDS_FILE);
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", holds_path);
+    FILE *fp = fopen(tmp_path, "w");
+    if (!fp) {
+        runepkg_storage_free_holds(holds, count);
+        return -1;
+    }
+    bool written = !hold;
+    for (int i = 0; i < count; i++) {
+        if (!written && strcmp(pkg_name, holds[i]) < 0) {
+            fprintf(fp, "%s\n", pkg_name);
+            written = true;
+        }
+        if (!hold && strcmp(holds[i], pkg_name) == 0) continue;
+        fprintf(fp, "%s\n", holds[i]);
+    }
+    if (!written) fprintf(fp, "%s\n", pkg_name);
+    runepkg_storage_free_holds(holds, count);
+
+    if (fclose(fp) != 0 || rename(tmp_path, holds_path) != 0) {
+        unlink(tmp_path);
+        return -1;
+    }
+    return 0;
+}
+
+// --- Database snapshots ---
+
+/* Snapshot layout (native byte order, like pkginfo.bin itself):
+ *   "RUNESNAP" | u32 format version | u32 package count
+ *   per package: str name | str version | u32 file count | files
+ *   u32 db-level file count | files (the hold list)
+ *   SHA-256 of everything above
+ * where str is a u32 length followed by the bytes, and a file is
+ * str name | u64 size | contents.
+ * With hash_files ('db export --files'), a package with a stored md5sums
+ * also carries SNAPSHOT_INSTALLED_MD5SUMS: the same paths hashed from
+ * install_dir at export time, for 'db diff --files'. It describes the
+ * exporting host, so import does not restore it. */
+#define SNAPSHOT_MAGIC "RUNESNAP"
+#define SNAPSHOT_MAGIC_LEN 8
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_DIGEST_LEN 32
+#define SNAPSHOT_INSTALLED_MD5SUMS "md5sums.installed"
+
+typedef struct {
+    FILE *fp;
+    runepkg_sha256_ctx sha;
+    int error;
+} SnapshotWriter;
+
+static void snap_put(SnapshotWriter *w, const void *data, size_t len) {
+    if (w->error || len == 0) return;
+    if (fwrite(data, 1, len, w->fp) != len) {
+        w->error = 1;
+        return;
+    }
+    runepkg_sha256_update(&w->sha, data, len);
+}
+
+static void snap_put_u32(SnapshotWriter *w, uint32_t v) {
+    snap_put(w, &v, sizeof(v));
+}
+
+static void snap_put_str(SnapshotWriter *w, const char *s) {
+    snap_put_u32(w, (uint32_t)strlen(s));
+    snap_put(w, s, strlen(s));
+}
+
+static void snap_put_data(SnapshotWriter *w, const char *name, const void *data, size_t len) {
+    uint64_t size = (uint64_t)len;
+    snap_put_str(w, name);
+    snap_put(w, &size, sizeof(size));
+    snap_put(w, data, len);
+}
+
+static void snap_put_file(SnapshotWriter *w, const char *name, const char *path) {
+    FILE *in = fopen(path, "rb");
+    struct stat st;
+    if (!in || fstat(fileno(in), &st) != 0) {
+        if (in) fclose(in);
+        w->error = 1;
+        return;
+    }
+    uint64_t size = (uint64_t)st.st_size;
+    snap_put_str(w, name);
+    snap_put(w, &size, sizeof(size));
+
+    char buf[65536];
+    uint64_t total = 0;
+    size_t n;
+    while (!w->error && (n = fread(buf, 1, sizeof(buf), in)) > 0) {
+        if (total + n > size) n = (size_t)(size - total);
+        snap_put(w, buf, n);
+        total += n;
+        if (total == size) break;
+    }
+    if (total != size) w->error = 1;  // Shrunk while exporting
+    fclose(in);
+}
+
+/* Reads the package name and version that lead every pkginfo.bin record,
+ * without parsing the rest of it. */
+int runepkg_storage_read_record_identity(const char *bin_path, char **name, char **version) {
+    FILE *fp = fopen(bin_path, "rb");
+    if (!fp) return -1;
+    char **out[2] = { name, version };
+    int ret = fseek(fp, sizeof(PkgHeader), SEEK_SET) == 0 ? 0 : -1;
+    for (int i = 0; i < 2 && ret == 0; i++) {
+        size_t len;
+        *out[i] = NULL;
+        if (fread(&len, sizeof(size_t), 1, fp) != 1 || len < 2 || len > 1024 ||
+            !(*out[i] = malloc(len)) || fread(*out[i], 1, len, fp) != len || (*out[i])[len - 1] != '\0') {
+            ret = -1;
+        }
+    }
+    fclose(fp);
+    if (ret != 0) {
+        runepkg_util_free_and_null(name);
+        runepkg_util_free_and_null(version);
+    }
+    return ret;
+}
+
+/* Collects the sorted names of package record directories under db_dir. */
+static char **collect_record_dirs(int *count) {
+    *count = 0;
+    DIR *dir = opendir(g_runepkg_db_dir);
+    if (!dir) return NULL;
+
+    char **dirs = NULL;
+    int capacity = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.') continue;
+        char bin_path[PATH_MAX];
+        snprintf(bin_path, sizeof(bin_path), "%s/%s/%s", g_runepkg_db_dir, entry->d_name, RUNEPKG_STORAGE_BINARY_FILE);
+        if (!runepkg_util_file_exists(bin_path)) continue;
+        if (*count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            char **grown = realloc(dirs, capacity * sizeof(char *));
+            if (!grown) break;
+            dirs = grown;
+        }
+        dirs[*count] = strdup(entry->d_name);
+        if (dirs[*count]) (*count)++;
+    }
+    closedir(dir);
+
+    if (*count > 1) qsort(dirs, *count, sizeof(char *), compare_packages);
+    return dirs;
+}
+
+static void free_string_list(char **list, int count) {
+    for (int i = 0; i < count; i++) free(list[i]);
+    free(list);
+}
+
+/* Regular files of one record directory (dotfiles aside), sorted so equal
+ * databases give byte-identical snapshots. */
+static char **collect_record_files(const char *dir_path, int *count) {
+    *count = 0;
+    DIR *dir = opendir(dir_path);
+    if (!dir) return NULL;
+
+    char **files = NULL;
+    int capacity = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        char path[PATH_MAX];
+        struct stat st;
+        snprintf(path, sizeof(path), "%s/%s", dir_path, entry->d_name);
+        if (lstat(path, &st) != 0 || !S_ISREG(st.st_mode)) continue;
+        // Import refuses dotfile names, and export generates the installed hashes itself
+        if (entry->d_name[0] == '.' || strcmp(entry->d_name, SNAPSHOT_INSTALLED_MD5SUMS) == 0) continue;
+        if (*count == capacity) {
+            capacity = capacity ? capacity * 2 : 8;
+            char **grown = realloc(files, capacity * sizeof(char *));
+            if (!grown) break;
+            files = grown;
+        }
+        files[*count] = strdup(entry->d_name);
+        if (files[*count]) (*count)++;
+    }
+    closedir(dir);
+
+    if (*count > 1) qsort(files, *count, sizeof(char *), compare_packages);
+    return files;
+}
+
+typedef struct {
+    char *dir;
+    char *name;
+    char *version;
+} SnapshotRecord;
+
+/* Snapshots are ordered by package name, then version, so two of them can
+ * be compared with a single merge pass. */
+static int compare_snapshot_records(const void *a, const void *b) {
+    const SnapshotRecord *ra = a, *rb = b;
+    int cmp = strcmp(ra->name, rb->name);
+    return cmp != 0 ? cmp : strcmp(ra->version, rb->version);
+}
+
+/* Hashes the installed copy of every path in a stored md5sums, in the same
+ * "<md5>  <path>" form. A missing file hashes as 32 dashes; paths left off
+ * the disk by path-exclude keep their shipped hash, as in -m. */
+static char *hash_installed_files(const char *md5sums_path, size_t *len) {
+    FILE *in = fopen(md5sums_path, "r");
+    if (!in) return NULL;
+    char *out = NULL;
+    FILE *fp = open_memstream(&out, len);
+    if (!fp) {
+        fclose(in);
+        return NULL;
+    }
+
+    char line[PATH_MAX + 64];
+    while (fgets(line, sizeof(line), in)) {
+        char expected[33], rel[PATH_MAX], actual[33];
+        if (sscanf(line, "%32s  %s", expected, rel) != 2) continue;
+        const char *hash = expected;
+        if (!runepkg_config_path_excluded(rel)) {
+            char *full = runepkg_util_concat_path(g_system_install_root, rel);
+            hash = full && runepkg_md5_file(full, actual) == 0 ? actual : "--------------------------------";
+            free(full);
+        }
+        fprintf(fp, "%s  %s\n", hash, rel);
+    }
+    fclose(in);
+    if (fclose(fp) != 0) {
+        free(out);
+        return NULL;
+    }
+    return out;
+}
+
+/* Streams every record in db_dir to fp in snapshot format, hashing the
+ * installed files only when hash_files is set.
+ * Returns the number of packages written, or -1 on a write error. */
+static int snap_export_stream(FILE *fp, bool hash_files) {
+    int dir_count = 0;
+    char **dirs = collect_record_dirs(&dir_count);
+    SnapshotRecord *records = calloc(dir_count > 0 ? dir_count : 1, sizeof(SnapshotRecord));
+    if (!records) {
+        free_string_list(dirs, dir_count);
+        return -1;
+    }
+
+    // Drop directories whose record cannot be read rather than exporting half a package
+    int pkg_count = 0;
+    for (int i = 0; i < dir_count; i++) {
+        char bin_path[PATH_MAX];
+        snprintf(bin_path, sizeof(bin_path), "%s/%s/%s", g_runepkg_db_dir, dirs[i], RUNEPKG_STORAGE_BINARY_FILE);
+        SnapshotRecord *rec = &records[pkg_count];
+        if (runepkg_storage_read_record_identity(bin_path, &rec->name, &rec->version) != 0) {
+            runepkg_util_error("Skipping unreadable package record: %s\n", dirs[i]);
+            free(dirs[i]);
+            continue;
+        }
+        rec->dir = dirs[i];
+        pkg_count++;
+    }
+    free(dirs);
+    if (pkg_count > 1) qsort(records, pkg_count, sizeof(SnapshotRecord), compare_snapshot_records);
+
+    SnapshotWriter w;
+    memset(&w, 0, sizeof(w));
+    w.fp = fp;
+    runepkg_sha256_init(&w.sha);
+
+    snap_put(&w, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_LEN);
+    snap_put_u32(&w, SNAPSHOT_VERSION);
+    snap_put_u32(&w, (uint32_t)pkg_count);
+    for (int i = 0; i < pkg_count && !w.error; i++) {
+        char *dir_path = runepkg_util_concat_path(g_runepkg_db_dir, records[i].dir);
+        int file_count = 0;
+        char **files = dir_path ? collect_record_files(dir_path, &file_count) : NULL;
+        if (!dir_path) w.error = 1;
+
+        char *installed = NULL;
+        size_t installed_len = 0;
+        if (hash_files && dir_path && g_system_install_root) {
+            char *md5sums_path = runepkg_util_concat_path(dir_path, "md5sums");
+            if (md5sums_path && runepkg_util_file_exists(md5sums_path)) {
+                installed = hash_installed_files(md5sums_path, &installed_len);
+                if (!installed) w.error = 1;
+            }
+            free(md5sums_path);
+        }
+
+        snap_put_str(&w, records[i].name);
+        snap_put_str(&w, records[i].version);
+        snap_put_u32(&w, (uint32_t)file_count + (installed ? 1 : 0));
+        for (int f = 0; f < file_count; f++) {
+            char *file_path = runepkg_util_concat_path(dir_path, files[f]);
+            if (file_path) snap_put_file(&w, files[f], file_path);
+            else w.error = 1;
+            free(file_path);
+        }
+        if (installed) snap_put_data(&w, SNAPSHOT_INSTALLED_MD5SUMS, installed, installed_len);
+        free(installed);
+        free_string_list(files, file_count);
+        free(dir_path);
+    }
+
+    char holds_path[PATH_MAX];
+    snprintf(holds_path, sizeof(holds_path), "%s/%s", g_runepkg_db_dir, RUNEPKG_STORAGE_HOLDS_FILE);
+    bool has_holds = runepkg_util_file_exists(holds_path);
+    snap_put_u32(&w, has_holds ? 1 : 0);
+    if (has_holds) snap_put_file(&w, RUNEPKG_STORAGE_HOLDS_FILE, holds_path);
+
+    uint8_t digest[SNAPSHOT_DIGEST_LEN];
+    runepkg_sha256_final(&w.sha, digest);
+    if (!w.error && fwrite(digest, 1, sizeof(digest), fp) != sizeof(digest)) w.error = 1;
+
+    for (int i = 0; i < pkg_count; i++) {
+        free(records[i].dir);
+        free(records[i].name);
+        free(records[i].version);
+    }
+    free(records);
+    return w.error ? -1 : pkg_count;
+}
+
+/**
+ * @brief Writes every package record in db_dir to a single snapshot file
+ */
+int runepkg_storage_export_snapshot(const char *out_path, bool hash_files) {
+    if (!out_path || !g_runepkg_db_dir) return -1;
+
+    bool to_stdout = strcmp(out_path, "-") == 0;
+    char tmp_path[PATH_MAX + 8];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", out_path);
+
+    FILE *fp = to_stdout ? stdout : fopen(tmp_path, "wb");
+    if (!fp) {
+        runepkg_util_error("Cannot create snapshot file %s: %s\n", out_path, strerror(errno));
+        return -1;
+    }
+
+    int count = snap_export_stream(fp, hash_files);
+    if (to_stdout) {
+        if (fflush(stdout) != 0) count = -1;
+    } else {
+        if (fclose(fp) != 0) count = -1;
+        if (count < 0 || rename(tmp_path, out_path) != 0) {
+            unlink(tmp_path);
+            count = -1;
+        }
+    }
+    if (count < 0) runepkg_util_error("Failed to write snapshot %s\n", out_path);
+    return count;
+}
+
+typedef struct {
+    const unsigned char *p;
+    const unsigned char *end;
+} SnapshotReader;
+
+static const unsigned char *snap_take(SnapshotReader *r, size_t len) {
+    if ((size_t)(r->end - r->p) < len) return NULL;
+    const unsigned char *at = r->p;
+    r->p += len;
+    return at;
+}
+
+static int snap_take_u32(SnapshotReader *r, uint32_t *v) {
+    const unsigned char *at = snap_take(r, sizeof(*v));
+    if (!at) return -1;
+    memcpy(v, at, sizeof(*v));
+    return 0;
+}
+
+/* Copies a length-prefixed name into buf, rejecting anything that could
+ * step outside the record directory. */
+static int snap_take_name(SnapshotReader *r, char *buf, size_t buf_size) {
+    uint32_t len;
+    if (snap_take_u32(r, &len) != 0 || len == 0 || len >= buf_size) return -1;
+    const unsigned char *at = snap_take(r, len);
+    if (!at || memchr(at, '/', len) || memchr(at, '\0', len) || at[0] == '.') return -1;
+    memcpy(buf, at, len);
+    buf[len] = '\0';
+    return 0;
+}
+
+static int snap_take_file(SnapshotReader *r, char *name, size_t name_size, const unsigned char **data, uint64_t *size) {
+    if (snap_take_name(r, name, name_size) != 0) return -1;
+    const unsigned char *at = snap_take(r, sizeof(*size));
+    if (!at) return -1;
+    memcpy(size, at, sizeof(*size));
+    if (*size > (uint64_t)(r->end - r->p)) return -1;
+    *data = snap_take(r, (size_t)*size);
+    return *data ? 0 : -1;
+}
+
+static int snap_write_out(const char *dir, const char *name, const unsigned char *data, uint64_t size) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    FILE *fp = fopen(path, "wb");
+    if (!fp) return -1;
+    int ret = (size == 0 || fwrite(data, 1, (size_t)size, fp) == size) ? 0 : -1;
+    if (fclose(fp) != 0) ret = -1;
+    return ret;
+}
+
+typedef enum {
+    SNAPSHOT_VALIDATE,
+    SNAPSHOT_LIST,
+    SNAPSHOT_RESTORE,
+    SNAPSHOT_INDEX
+} SnapshotAction;
+
+/* One package of a loaded snapshot; md5sums points into the snapshot buffer
+ * (the installed-file hashes when the snapshot has them). */
+typedef struct {
+    char *name;
+    char *version;
+    const unsigned char *md5sums;
+    size_t md5sums_len;
+} SnapshotEntry;
+
+/* Walks a checksum-verified snapshot. VALIDATE checks every bound before
+ * anything touches the database; LIST prints name=version pairs; RESTORE
+ * writes the records and hold list under root; INDEX fills one SnapshotEntry
+ * per package. Returns the package count or -1. */
+static int snap_walk(const unsigned char *buf, size_t len, SnapshotAction action, SnapshotEntry *index, const char *root) {
+    SnapshotReader r = { buf + SNAPSHOT_MAGIC_LEN + sizeof(uint32_t), buf + len - SNAPSHOT_DIGEST_LEN };
+    uint32_t pkg_count, file_count;
+    if (snap_take_u32(&r, &pkg_count) != 0) return -1;
+
+    for (uint32_t i = 0; i < pkg_count; i++) {
+        char name[256], version[256], file_name[256], dir_path[PATH_MAX];
+        if (snap_take_name(&r, name, sizeof(name)) != 0 || snap_take_name(&r, version, sizeof(version)) != 0 ||
+            snap_take_u32(&r, &file_count) != 0) {
+            return -1;
+        }
+        if (action == SNAPSHOT_LIST) printf("%s=%s\n", name, version);
+        if (action == SNAPSHOT_INDEX) {
+            index[i].name = strdup(name);
+            index[i].version = strdup(version);
+            if (!index[i].name || !index[i].version) return -1;
+        }
+        if (action == SNAPSHOT_RESTORE) {
+            if (snprintf(dir_path, sizeof(dir_path), "%s/%s-%s", root, name, version) >= (int)sizeof(dir_path) ||
+                runepkg_util_create_dir_recursive(dir_path, 0755) != 0) {
+                return -1;
+            }
+        }
+        for (uint32_t f = 0; f < file_count; f++) {
+            const unsigned char *data;
+            uint64_t size;
+            if (snap_take_file(&r, file_name, sizeof(file_name), &data, &size) != 0) return -1;
+            bool installed = strcmp(file_name, SNAPSHOT_INSTALLED_MD5SUMS) == 0;
+            if (action == SNAPSHOT_RESTORE && !installed && snap_write_out(dir_path, file_name, data, size) != 0) {
+                runepkg_util_error("Failed to write %s/%s\n", dir_path, file_name);
+                return -1;
+            }
+            // Prefer the installed-file hashes; older snapshots only have the shipped md5sums
+            if (action == SNAPSHOT_INDEX && (installed || (!index[i].md5sums && strcmp(file_name, "md5sums") == 0))) {
+                index[i].md5sums = data;
+                index[i].md5sums_len = (size_t)size;
+            }
+        }
+    }
+
+    if (snap_take_u32(&r, &file_count) != 0) return -1;
+    for (uint32_t f = 0; f < file_count; f++) {
+        char file_name[256];
+        const unsigned char *data;
+        uint64_t size;
+        if (snap_take_file(&r, file_name, sizeof(file_name), &data, &size) != 0) return -1;
+        if (action == SNAPSHOT_RESTORE && snap_write_out(root, file_name, data, size) != 0) {
+            runepkg_util_error("Failed to write %s/%s\n", root, file_name);
+            return -1;
+        }
+    }
+
+    return r.p == r.end ? (int)pkg_count : -1;
+}
+
+/* Loads a snapshot ("-" reads stdin) and checks magic, version and digest. */
+static unsigned char *snap_load(const char *in_path, size_t *len) {
+    bool from_stdin = strcmp(in_path, "-") == 0;
+    FILE *fp = from_stdin ? stdin : fopen(in_path, "rb");
+    if (!fp) {
+        runepkg_util_error("Cannot open snapshot %s: %s\n", in_path, strerror(errno));
+        return NULL;
+    }
+
+    size_t capacity = 1 << 20, used = 0, n;
+    unsigned char *buf = malloc(capacity);
+    while (buf && (n = fread(buf + used, 1, capacity - used, fp)) > 0) {
+        used += n;
+        if (used == capacity) {
+            unsigned char *grown = realloc(buf, capacity * 2);
+            if (!grown) {
+                free(buf);
+                buf = NULL;
+                break;
+            }
+            buf = grown;
+            capacity *= 2;
+        }
+    }
+    if (!from_stdin) fclose(fp);
+    if (!buf) {
+        runepkg_util_error("Out of memory reading snapshot %s\n", in_path);
+        return NULL;
+    }
+
+    uint32_t version = 0;
+    size_t min_len = SNAPSHOT_MAGIC_LEN + 3 * sizeof(uint32_t) + SNAPSHOT_DIGEST_LEN;
+    if (used < min_len || memcmp(buf, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_LEN) != 0) {
+        runepkg_util_error("%s is not a runepkg database snapshot.\n", in_path);
+        free(buf);
+        return NULL;
+    }
+    memcpy(&version, buf + SNAPSHOT_MAGIC_LEN, sizeof(version));
+    if (version != SNAPSHOT_VERSION) {
+        runepkg_util_error("Unsupported snapshot format version %u in %s.\n", version, in_path);
+        free(buf);
+        return NULL;
+    }
+
+    runepkg_sha256_ctx sha;
+    uint8_t digest[SNAPSHOT_DIGEST_LEN];
+    runepkg_sha256_init(&sha);
+    runepkg_sha256_update(&sha, buf, used - SNAPSHOT_DIGEST_LEN);
+    runepkg_sha256_final(&sha, digest);
+    if (memcmp(digest, buf + used - SNAPSHOT_DIGEST_LEN, SNAPSHOT_DIGEST_LEN) != 0) {
+        runepkg_util_error("Snapshot %s is corrupt (checksum mismatch).\n", in_path);
+        free(buf);
+        return NULL;
+    }
+
+    *len = used;
+    return buf;
+}
+
+/* Renames every entry of from_dir listed in names into to_dir; on a failure
+ * the ones already moved are renamed back. */
+static int snap_move_entries(const char *from_dir, const char *to_dir, char **names, int count) {
+    for (int i = 0; i < count; i++) {
+        char from[PATH_MAX], to[PATH_MAX];
+        snprintf(from, sizeof(from), "%s/%s", from_dir, names[i]);
+        snprintf(to, sizeof(to), "%s/%s", to_dir, names[i]);
+        if (rename(from, to) == 0) continue;
+        runepkg_util_error("Cannot move %s to %s: %s\n", from, to, strerror(errno));
+        while (i-- > 0) {
+            snprintf(from, sizeof(from), "%s/%s", from_dir, names[i]);
+            snprintf(to, sizeof(to), "%s/%s", to_dir, names[i]);
+            rename(to, from);
+        }
+        return -1;
+    }
+    return 0;
+}
+
+/* Replaces the live records and hold list with the ones restored under
+ * staging. Everything involved sits in db_dir, so each step is a rename: the
+ * old entries go aside into a second hidden directory, the new ones take their
+ * place, and only then is the old set deleted. A failure puts the old set back. */
+static int snap_swap_in(const char *staging, char **old_dirs, int old_count) {
+    char aside[PATH_MAX];
+    snprintf(aside, sizeof(aside), "%s/.import-old-XXXXXX", g_runepkg_db_dir);
+    if (!mkdtemp(aside)) return -1;
+
+    char **old_names = calloc(old_count + 1, sizeof(char *));
+    char **new_names = NULL;
+    int old_names_count = 0, new_count = 0, new_cap = 0, ret = -1;
+    if (!old_names) goto out;
+    for (int i = 0; i < old_count; i++) old_names[old_names_count++] = old_dirs[i];
+    char holds_path[PATH_MAX];
+    snprintf(holds_path, sizeof(holds_path), "%s/%s", g_runepkg_db_dir, RUNEPKG_STORAGE_HOLDS_FILE);
+    if (runepkg_util_file_exists(holds_path)) old_names[old_names_count++] = RUNEPKG_STORAGE_HOLDS_FILE;
+
+    DIR *dir = opendir(staging);
+    if (!dir) goto out;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+        if (new_count == new_cap) {
+            new_cap = new_cap ? new_cap * 2 : 64;
+            char **grown = realloc(new_names, new_cap * sizeof(char *));
+            if (!grown) break;
+            new_names = grown;
+        }
+        if (!(new_names[new_count] = strdup(entry->d_name))) break;
+        new_count++;
+    }
+    bool listed = entry == NULL;
+    closedir(dir);
+    if (!listed) goto out;
+
+    if (snap_move_entries(g_runepkg_db_dir, aside, old_names, old_names_count) != 0) goto out;
+    if (snap_move_entries(staging, g_runepkg_db_dir, new_names, new_count) != 0) {
+        snap_move_entries(aside, g_runepkg_db_dir, old_names, old_names_count);
+        goto out;
+    }
+    ret = 0;
+
+out:
+    if (ret == 0) runepkg_storage_remove_directory_tree(aside);
+    else if (rmdir(aside) != 0) runepkg_util_error("Some previous records could not be moved back; they are in %s\n", aside);
+    free_string_list(new_names, new_count);
+    free(old_names);
+    return ret;
+}
+
+/**
+ * @brief Restores package records from a snapshot written by runepkg_storage_export_snapshot()
+ */
+int runepkg_storage_import_snapshot(const char *in_path, bool replace) {
+    if (!in_path || !g_runepkg_db_dir) return -1;
+
+    size_t len = 0;
+    unsigned char *buf = snap_load(in_path, &len);
+    if (!buf) return -1;
+    if (snap_walk(buf, len, SNAPSHOT_VALIDATE, NULL, NULL) < 0) {
+        runepkg_util_error("Snapshot %s is malformed.\n", in_path);
+        free(buf);
+        return -1;
+    }
+
+    int existing = 0;
+    char **dirs = collect_record_dirs(&existing);
+    if (existing > 0 && !replace) {
+        runepkg_util_error("%s already holds %d package records; use -f to replace them with the snapshot.\n",
+                           g_runepkg_db_dir, existing);
+        free_string_list(dirs, existing);
+        free(buf);
+        return -1;
+    }
+
+    // Restore beside the live records first, so a failed write leaves them untouched
+    char staging[PATH_MAX];
+    snprintf(staging, sizeof(staging), "%s/.import-XXXXXX", g_runepkg_db_dir);
+    int count = mkdtemp(staging) ? snap_walk(buf, len, SNAPSHOT_RESTORE, NULL, staging) : -1;
+    free(buf);
+    if (count < 0 || snap_swap_in(staging, dirs, existing) != 0) {
+        runepkg_util_error("Failed to import %s; %s was left unchanged.\n", in_path, g_runepkg_db_dir);
+        count = -1;
+    }
+    runepkg_storage_remove_directory_tree(staging);
+    free_string_list(dirs, existing);
+    return count;
+}
+
+/**
+ * @brief Prints the name=version list recorded in a snapshot
+ */
+int runepkg_storage_list_snapshot(const char *in_path) {
+    if (!in_path) return -1;
+
+    size_t len = 0;
+    unsigned char *buf = snap_load(in_path, &len);
+    if (!buf) return -1;
+    int count = snap_walk(buf, len, SNAPSHOT_VALIDATE, NULL, NULL) < 0 ? -1 : snap_walk(buf, len, SNAPSHOT_LIST, NULL, NULL);
+    if (count < 0) runepkg_util_error("Snapshot %s is malformed.\n", in_path);
+    free(buf);
+    return count;
+}
+
+// --- Snapshot diff ---
+
+typedef struct {
+    unsigned char *buf;
+    size_t len;
+    SnapshotEntry *entries;
+    int count;
+} LoadedSnapshot;
+
+static int compare_snapshot_entries(const void *a, const void *b) {
+    const SnapshotEntry *ea = a, *eb = b;
+    int cmp = strcmp(ea->name, eb->name);
+    return cmp != 0 ? cmp : strcmp(ea->version, eb->version);
+}
+
+static void snap_free_loaded(LoadedSnapshot *s) {
+    for (int i = 0; s->entries && i < s->count; i++) {
+        free(s->entries[i].name);
+        free(s->entries[i].version);
+    }
+    free(s->entries);
+    free(s->buf);
+    memset(s, 0, sizeof(*s));
+}
+
+/* Loads and indexes a snapshot; "live" snapshots the current database in
+ * memory instead of reading a file, hashing the installed files only when
+ * hash_files is set. */
+static int snap_load_indexed(const char *source, bool hash_files, LoadedSnapshot *s) {
+    memset(s, 0, sizeof(*s));
+    if (strcmp(source, "live") == 0) {
+        char *mem = NULL;
+        size_t mem_len = 0;
+        FILE *fp = open_memstream(&mem, &mem_len);
+        if (!fp) return -1;
+        int written = snap_export_stream(fp, hash_files);
+        if (fclose(fp) != 0 || written < 0) {
+            free(mem);
+            runepkg_util_error("Failed to snapshot the live database.\n");
+            return -1;
+        }
+        s->buf = (unsigned char *)mem;
+        s->len = mem_len;
+    } else {
+        s->buf = snap_load(source, &s->len);
+        if (!s->buf) return -1;
+    }
+
+    int count = snap_walk(s->buf, s->len, SNAPSHOT_VALIDATE, NULL, NULL);
+    s->entries = count >= 0 ? calloc(count > 0 ? count : 1, sizeof(SnapshotEntry)) : NULL;
+    s->count = count;
+    if (!s->entries || snap_walk(s->buf, s->len, SNAPSHOT_INDEX, s->entries, NULL) != count) {
+        runepkg_util_error("Snapshot %s is malformed.\n", source);
+        if (count < 0) s->count = 0;
+        snap_free_loaded(s);
+        return -1;
+    }
+
+    // Exported snapshots are already in name order; only foreign ones need sorting
+    for (int i = 1; i < count; i++) {
+        if (compare_snapshot_entries(&s->entries[i - 1], &s->entries[i]) > 0) {
+            qsort(s->entries, count, sizeof(SnapshotEntry), compare_snapshot_entries);
+            break;
+        }
+    }
+    return 0;
+}
+
+typedef struct {
+    const unsigned char *hash;  // 32 hex digits, not terminated
+    const unsigned char *path;
+    size_t path_len;
+} Md5sumsLine;
+
+static int compare_md5sums_lines(const void *a, const void *b) {
+    const Md5sumsLine *la = a, *lb = b;
+    size_t n = la->path_len < lb->path_len ? la->path_len : lb->path_len;
+    int cmp = memcmp(la->path, lb->path, n);
+    if (cmp != 0) return cmp;
+    return (la->path_len > lb->path_len) - (la->path_len < lb->path_len);
+}
+
+/* Splits an md5sums blob into path-sorted lines that point into the blob. */
+static Md5sumsLine *parse_md5sums(const unsigned char *data, size_t len, int *count) {
+    *count = 0;
+    if (!data || len == 0) return NULL;
+
+    int capacity = 0;
+    Md5sumsLine *lines = NULL;
+    const unsigned char *p = data, *end = data + len;
+    bool sorted = true;
+    while (p < end) {
+        const unsigned char *eol = memchr(p, '\n', (size_t)(end - p));
+        if (!eol) eol = end;
+        if (eol - p > 34 && p[32] == ' ' && p[33] == ' ') {
+            if (*count == capacity) {
+                capacity = capacity ? capacity * 2 : 64;
+                Md5sumsLine *grown = realloc(lines, capacity * sizeof(Md5sumsLine));
+                if (!grown) break;
+                lines = grown;
+            }
+            Md5sumsLine *l = &lines[*count];
+            l->hash = p;
+            l->path = p + 34;
+            l->path_len = (size_t)(eol - l->path);
+            if (l->path_len > 0 && l->path[l->path_len - 1] == '\r') l->path_len--;
+            if (*count > 0 && compare_md5sums_lines(&lines[*count - 1], l) > 0) sorted = false;
+            (*count)++;
+        }
+        p = eol + 1;
+    }
+    if (!sorted) qsort(lines, *count, sizeof(Md5sumsLine), compare_md5sums_lines);
+    return lines;
+}
+
+/* Merge-joins the md5sums tables of one package from both sides and prints
+ * per-file changes. Returns the number of differing files. */
+static int diff_md5sums(const SnapshotEntry *a, const SnapshotEntry *b) {
+    int na = 0, nb = 0;
+    Md5sumsLine *la = parse_md5sums(a->md5sums, a->md5sums_len, &na);
+    Md5sumsLine *lb = parse_md5sums(b->md5sums, b->md5sums_len, &nb);
+    int diffs = 0, i = 0, j = 0;
+    bool same_version = strcmp(a->version, b->version) == 0;
+
+    while (i < na || j < nb) {
+        int cmp = i >= na ? 1 : j >= nb ? -1 : compare_md5sums_lines(&la[i], &lb[j]);
+        const Md5sumsLine *l = cmp <= 0 ? &la[i] : &lb[j];
+        char mark = 0;
+        if (cmp < 0) mark = '-';
+        else if (cmp > 0) mark = '+';
+        else if (memcmp(la[i].hash, lb[j].hash, 32) != 0) mark = 'M';
+
+        if (mark) {
+            if (diffs == 0 && same_version) printf("! %s %s (files differ)\n", a->name, a->version);
+            printf("    %c /%.*s\n", mark, (int)l->path_len, (const char *)l->path);
+            diffs++;
+        }
+        if (cmp <= 0) i++;
+        if (cmp >= 0) j++;
+    }
+
+    free(la);
+    free(lb);
+    return diffs;
+}
+
+/**
+ * @brief Reports packages added, removed or changed between two snapshots
+ */
+int runepkg_storage_diff_snapshots(const char *source_a, const char *source_b, bool compare_files) {
+    if (!source_a || !source_b) return -1;
+
+    LoadedSnapshot a, b;
+    if (snap_load_indexed(source_a, compare_files, &a) != 0) return -1;
+    if (snap_load_indexed(source_b, compare_files, &b) != 0) {
+        snap_free_loaded(&a);
+        return -1;
+    }
+
+    int added = 0, removed = 0, changed = 0, files = 0;
+    int i = 0, j = 0;
+    while (i < a.count || j < b.count) {
+        int cmp = i >= a.count ? 1 : j >= b.count ? -1 : strcmp(a.entries[i].name, b.entries[j].name);
+        if (cmp < 0) {
+            printf("- %s %s\n", a.entries[i].name, a.entries[i].version);
+            removed++;
+            i++;
+            continue;
+        }
+        if (cmp > 0) {
+            printf("+ %s %s\n", b.entries[j].name, b.entries[j].version);
+            added++;
+            j++;
+            continue;
+        }
+
+        // Both sides have this name; a name can have several version rows
+        int a_end = i + 1, b_end = j + 1;
+        while (a_end < a.count && strcmp(a.entries[a_end].name, a.entries[i].name) == 0) a_end++;
+        while (b_end < b.count && strcmp(b.entries[b_end].name, b.entries[j].name) == 0) b_end++;
+        if (a_end - i == 1 && b_end - j == 1) {
+            if (strcmp(a.entries[i].version, b.entries[j].version) != 0) {
+                printf("~ %s %s -> %s\n", a.entries[i].name, a.entries[i].version, b.entries[j].version);
+                changed++;
+            }
+            if (compare_files) files += diff_md5sums(&a.entries[i], &b.entries[j]);
+            i = a_end;
+            j = b_end;
+            continue;
+        }
+
+        // Otherwise join the group's rows on version, which both sides have sorted
+        while (i < a_end || j < b_end) {
+            int vcmp = i >= a_end ? 1 : j >= b_end ? -1 : strcmp(a.entries[i].version, b.entries[j].version);
+            if (vcmp < 0) {
+                printf("- %s %s\n", a.entries[i].name, a.entries[i].version);
+                removed++;
+                i++;
+            } else if (vcmp > 0) {
+                printf("+ %s %s\n", b.entries[j].name, b.entries[j].version);
+                added++;
+                j++;
+            } else {
+                if (compare_files) files += diff_md5sums(&a.entries[i], &b.entries[j]);
+                i++;
+                j++;
+            }
+        }
+    }
+
+    printf("\033[1;34m[db]\033[0m %s -> %s: %d added, %d removed, %d changed",
+           source_a, source_b, added, removed, changed);
+    if (compare_files) printf(", %d files differ", files);
+    printf(".\n");
+
+    snap_free_loaded(&a);
+    snap_free_loaded(&b);
+    return added + removed + changed + files;
+}
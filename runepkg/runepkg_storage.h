@@ -48,6 +48,7 @@ typedef struct {
 
 // --- Storage Constants ---
 #define RUNEPKG_STORAGE_BINARY_FILE "pkginfo.bin"
+#define RUNEPKG_STORAGE_HOLDS_FILE "holds"
 
 // --- Storage Functions ---
 
@@ -87,6 +88,15 @@ int runepkg_storage_read_package_info(const char *pkg_name, const char *pkg_vers
  */
 int runepkg_storage_remove_package(const char *pkg_name, const char *pkg_version);
 
+/**
+ * @brief Reads the package name and version stored at the head of a pkginfo.bin record
+ * @param bin_path Path to the record's pkginfo.bin
+ * @param name Receives the malloc'd package name
+ * @param version Receives the malloc'd package version
+ * @return 0 on success, -1 on failure (both outputs NULL)
+ */
+int runepkg_storage_read_record_identity(const char *bin_path, char **name, char **version);
+
 /**
  * @brief Recursively delete a directory tree (files and subdirs).
  * @return 0 on success, -1 on failure
@@ -131,6 +141,58 @@ int runepkg_storage_print_package_info(const char *pkg_name, const char *pkg_ver
  */
 int runepkg_storage_build_autocomplete_index(void);
 
+/**
+ * @brief Loads the names of held packages (one per line in the db_dir holds file)
+ * @param count Receives the number of names returned
+ * @return Sorted, de-duplicated array of names (free with runepkg_storage_free_holds), or NULL if none
+ */
+char **runepkg_storage_load_holds(int *count);
+
+/**
+ * @brief Frees a list returned by runepkg_storage_load_holds()
+ */
+void runepkg_storage_free_holds(char **holds, int count);
+
+/**
+ * @brief Adds or removes a package name from the hold list
+ * @param pkg_name The package name
+ * @param hold true to hold, false to release
+ * @return 0 on success, 1 if already in the requested state, -1 on failure
+ */
+int runepkg_storage_set_hold(const char *pkg_name, bool hold);
+
+/**
+ * @brief Writes all package records and the hold list to one checksummed snapshot file
+ * @param out_path Destination file, or "-" for stdout
+ * @param hash_files Also hash the installed copy of every file in each record's md5sums
+ * @return Number of packages exported, -1 on failure
+ */
+int runepkg_storage_export_snapshot(const char *out_path, bool hash_files);
+
+/**
+ * @brief Restores package records from a snapshot, then the caller rebuilds the indexes
+ * @param in_path Snapshot file, or "-" for stdin
+ * @param replace Replace existing records; without it a non-empty database is refused
+ * @return Number of packages imported, -1 on failure
+ */
+int runepkg_storage_import_snapshot(const char *in_path, bool replace);
+
+/**
+ * @brief Prints the name=version pairs recorded in a snapshot, one per line
+ * @param in_path Snapshot file, or "-" for stdin
+ * @return Number of packages listed, -1 on failure
+ */
+int runepkg_storage_list_snapshot(const char *in_path);
+
+/**
+ * @brief Merge-joins two snapshots and prints added (+), removed (-) and changed (~) packages
+ * @param source_a Snapshot file, "-" for stdin, or "live" for the current database
+ * @param source_b Snapshot file, "-" for stdin, or "live" for the current database
+ * @param compare_files Also compare the per-file md5sums stored with each record
+ * @return Number of differences found, -1 on failure
+ */
+int runepkg_storage_diff_snapshots(const char *source_a, const char *source_b, bool compare_files);
+
 #ifdef __cplusplus
 }
 #endif
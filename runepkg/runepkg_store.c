@@ -0,0 +1,134 @@
+/******************************************************************************
+ * Filename:    runepkg_store.c
+ * Author:      <michkochris@gmail.com>
+ * Date:        started 01-03-2025
+ * Description: Content-addressed file store shared between install roots
+ *
+ * Copyright (c) 2025 runepkg (Runar Linux) All rights reserved.
+ * GPLV3
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <https://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <linux/fs.h>
+#endif
+
+#include "runepkg_store.h"
+#include "runepkg_config.h"
+#include "runepkg_sha256.h"
+#include "runepkg_util.h"
+
+// Set once linking or cloning from the store has failed in a way that will
+// repeat for every file (store on another filesystem, no reflink support).
+// Install workers run in parallel, so it is only touched atomically.
+static int g_store_unusable = 0;
+
+bool runepkg_store_enabled(void) {
+    return g_package_store && *g_package_store && !__atomic_load_n(&g_store_unusable, __ATOMIC_RELAXED);
+}
+
+static void store_give_up(const char *what, const char *dst, int err) {
+    if (__atomic_exchange_n(&g_store_unusable, 1, __ATOMIC_RELAXED)) return;
+    fprintf(stderr, "Warning: package_store: cannot %s %s from %s (%s); copying files instead\n",
+            what, dst, g_package_store, strerror(err));
+}
+
+// Path of the object for content hash with permission bits mode.
+static int store_object_path(const char *hash, mode_t mode, char *out, size_t out_len) {
+    int n = snprintf(out, out_len, "%s/objects/%.2s/%s-%03o", g_package_store, hash, hash, (unsigned int)(mode & 0777));
+    return (n > 0 && (size_t)n < out_len) ? 0 : -1;
+}
+
+// Adds src to the store as object unless it is already there.
+static int store_add_object(const char *src, const char *object) {
+    if (access(object, F_OK) == 0) return 0;
+
+    char dir[PATH_MAX];
+    snprintf(dir, sizeof(dir), "%s", object);
+    char *slash = strrchr(dir, '/');
+    if (!slash) return -1;
+    *slash = '\0';
+    if (runepkg_util_create_dir_recursive(dir, 0755) != 0) return -1;
+
+    // Fill a private temporary and link it into place, so a concurrent
+    // install never sees a partial object and the first writer wins without
+    // replacing an inode other roots already link to.
+    char tmp[PATH_MAX];
+    if (snprintf(tmp, sizeof(tmp), "%s/.tmp-XXXXXX", dir) >= (int)sizeof(tmp)) return -1;
+    int fd = mkstemp(tmp);
+    if (fd < 0) return -1;
+    close(fd);
+    int ret = runepkg_util_copy_file(src, tmp);
+    if (ret == 0 && link(tmp, object) != 0 && errno != EEXIST) ret = -1;
+    unlink(tmp);
+    return ret;
+}
+
+static int store_clone(const char *object, const char *dst, mode_t mode) {
+#ifdef FICLONE
+    int in = open(object, O_RDONLY);
+    if (in < 0) return -1;
+    int out = open(dst, O_WRONLY | O_CREAT | O_EXCL, mode & 0777);
+    if (out < 0) {
+        close(in);
+        return -1;
+    }
+    int ret = ioctl(out, FICLONE, in);
+    int err = errno;
+    if (ret == 0) fchmod(out, mode & 0777);
+    close(out);
+    close(in);
+    if (ret != 0) {
+        unlink(dst);
+        if (err == EOPNOTSUPP || err == ENOTTY || err == EXDEV || err == EINVAL) store_give_up("clone", dst, err);
+    }
+    return ret == 0 ? 0 : -1;
+#else
+    (void)object;
+    (void)mode;
+    store_give_up("clone", dst, EOPNOTSUPP);
+    return -1;
+#endif
+}
+
+int runepkg_store_materialize(const char *src, const char *dst) {
+    if (!runepkg_store_enabled()) return -1;
+
+    struct stat st;
+    if (stat(src, &st) != 0 || !S_ISREG(st.st_mode)) return -1;
+    char hash[65];
+    if (runepkg_sha256_file(src, hash) != 0) return -1;
+    char object[PATH_MAX];
+    if (store_object_path(hash, st.st_mode, object, sizeof(object)) != 0) return -1;
+    if (store_add_object(src, object) != 0) {
+        store_give_up("add", src, errno);
+        return -1;
+    }
+
+    if (!g_store_hardlink) return store_clone(object, dst, st.st_mode);
+
+    if (link(object, dst) == 0) return 0;
+    // EMLINK only affects this object; anything else will affect every file.
+    if (errno != EMLINK) store_give_up("link", dst, errno);
+    return -1;
+}
@@ -0,0 +1,67 @@
+/******************************************************************************
+ * Filename:    runepkg_store.h
+ * Author:      <michkochris@gmail.com>
+ * Date:        started 01-03-2025
+ * Description: Content-addressed file store shared between install roots
+ *
+ * Copyright (c) 2025 runepkg (Runar Linux) All rights reserved.
+ * GPLV3
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <https://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#ifndef RUNEPKG_STORE_H
+#define RUNEPKG_STORE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+
+/*
+ * With package_store set, every regular file a package installs is first
+ * entered into the store as
+ *     <package_store>/objects/<xx>/<sha256>-<mode>
+ * (xx being the first two hex digits) and then materialized at its install
+ * path from there, so roots built from the same debs share one copy of each
+ * unique file:
+ *   - reflink (default): a copy-on-write clone (FICLONE). Roots stay fully
+ *     writable; editing a file in one root never touches another.
+ *   - hardlink: the install path is a link to the object. Only for roots that
+ *     are never modified in place (ISO trees, read-only container layers),
+ *     since writing through any link changes every root.
+ * The store must be on the same filesystem as the roots. When a link or clone
+ * is not possible (other filesystem, no reflink support) the file is copied
+ * as before, and the store is bypassed for the rest of the run.
+ */
+
+/**
+ * @brief True when package_store is configured and still usable this run
+ */
+bool runepkg_store_enabled(void);
+
+/**
+ * @brief Installs regular file src at dst through the store
+ *
+ * dst must not exist. The object for src is added to the store if missing.
+ * @return 0 when dst was linked or cloned from the store, -1 when the caller
+ *         should fall back to a plain copy (dst is left absent)
+ */
+int runepkg_store_materialize(const char *src, const char *dst);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RUNEPKG_STORE_H
@@ -0,0 +1,203 @@
+/******************************************************************************
+ * Filename:    runepkg_stree.c
+ * Author:      <michkochris@gmail.com>
+ * Date:        started 01-03-2025
+ * Description: Static B+ tree over sorted name indexes for prefix completion
+ *
+ * Copyright (c) 2025 runepkg (Runar Linux) All rights reserved.
+ * GPLV3
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <https://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "runepkg_stree.h"
+
+#define B RUNEPKG_STREE_NODE_KEYS
+
+static RunepkgSTreeKey stree_key(const char *s) {
+    RunepkgSTreeKey k = {0, 0};
+    size_t i = 0;
+    for (; i < 8 && s[i]; i++) k.hi |= (uint64_t)(unsigned char)s[i] << (56 - 8 * i);
+    if (i == 8) {
+        for (; i < RUNEPKG_STREE_KEY_BYTES && s[i]; i++) k.lo |= (uint64_t)(unsigned char)s[i] << (56 - 8 * (i - 8));
+    }
+    return k;
+}
+
+static const RunepkgSTreeKey STREE_KEY_MAX = {UINT64_MAX, UINT64_MAX};
+
+// Number of keys in the node strictly below q; written without branches on the key data.
+static inline uint32_t stree_rank_in_node(const RunepkgSTreeKey *node, RunepkgSTreeKey q) {
+    uint32_t rank = 0;
+    for (int i = 0; i < B; i++) {
+        rank += (node[i].hi < q.hi) | ((node[i].hi == q.hi) & (node[i].lo < q.lo));
+    }
+    return rank;
+}
+
+int runepkg_stree_write(const char *path, runepkg_stree_name_fn name_at, const void *ctx,
+                        uint32_t count, uint64_t source_size) {
+    if (!path || !name_at) return -1;
+
+    RunepkgSTreeHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = RUNEPKG_STREE_MAGIC;
+    hdr.version = RUNEPKG_STREE_VERSION;
+    hdr.key_count = count;
+    hdr.source_size = source_size;
+
+    // Layer sizes in nodes; leaves first, each upper layer has one node per B+1 children.
+    uint32_t layer_nodes[RUNEPKG_STREE_MAX_LAYERS];
+    layer_nodes[0] = count ? (count + B - 1) / B : 1;
+    uint32_t layers = 1;
+    while (layer_nodes[layers - 1] > 1) {
+        if (layers == RUNEPKG_STREE_MAX_LAYERS) return -1;
+        layer_nodes[layers] = (layer_nodes[layers - 1] + B) / (B + 1);
+        layers++;
+    }
+    hdr.height = layers - 1;
+
+    // Root layer is stored first so the hot upper layers share pages.
+    uint64_t total_nodes = 0;
+    for (int h = (int)layers - 1; h >= 0; h--) {
+        hdr.layer_offset[h] = (uint32_t)total_nodes;
+        total_nodes += layer_nodes[h];
+    }
+
+    RunepkgSTreeKey *keys = malloc(total_nodes * B * sizeof(RunepkgSTreeKey));
+    if (!keys) return -1;
+
+    RunepkgSTreeKey *leaves = keys + (size_t)hdr.layer_offset[0] * B;
+    for (uint64_t i = 0; i < (uint64_t)layer_nodes[0] * B; i++) {
+        leaves[i] = i < count ? stree_key(name_at(ctx, (uint32_t)i)) : STREE_KEY_MAX;
+    }
+
+    uint64_t span = 1; // Leaf nodes under one node of the layer below
+    for (uint32_t h = 1; h < layers; h++) {
+        RunepkgSTreeKey *layer = keys + (size_t)hdr.layer_offset[h] * B;
+        for (uint64_t k = 0; k < layer_nodes[h]; k++) {
+            for (int i = 0; i < B; i++) {
+                uint64_t child = k * (B + 1) + i + 1;
+                uint64_t first = child * span * B;
+                layer[k * B + i] = first < count ? leaves[first] : STREE_KEY_MAX;
+            }
+        }
+        span *= B + 1;
+    }
+
+    char tmp_path[PATH_MAX + 8];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    FILE *fp = fopen(tmp_path, "wb");
+    if (!fp) {
+        free(keys);
+        return -1;
+    }
+    // Pad the header to a cache line so every node starts line-aligned in the mapping.
+    unsigned char header_block[64] = {0};
+    memcpy(header_block, &hdr, sizeof(hdr));
+    int ok = fwrite(header_block, sizeof(header_block), 1, fp) == 1 &&
+             fwrite(keys, sizeof(RunepkgSTreeKey) * B, total_nodes, fp) == total_nodes;
+    free(keys);
+    if (fclose(fp) != 0) ok = 0;
+    if (!ok || rename(tmp_path, path) != 0) {
+        unlink(tmp_path);
+        return -1;
+    }
+    return 0;
+}
+
+int runepkg_stree_open(RunepkgSTree *tree, const char *path, uint32_t key_count, uint64_t source_size) {
+    memset(tree, 0, sizeof(*tree));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < 64) {
+        close(fd);
+        return -1;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+
+    const RunepkgSTreeHeader *hdr = (const RunepkgSTreeHeader *)map;
+    uint64_t total_nodes = 0;
+    int valid = hdr->magic == RUNEPKG_STREE_MAGIC && hdr->version == RUNEPKG_STREE_VERSION &&
+                hdr->key_count == key_count && hdr->source_size == source_size &&
+                hdr->height < RUNEPKG_STREE_MAX_LAYERS;
+    if (valid) {
+        // The root layer starts at node 0 and the leaves are stored last.
+        total_nodes = hdr->key_count ? (hdr->key_count + B - 1) / B : 1;
+        total_nodes += hdr->layer_offset[0];
+        valid = hdr->layer_offset[hdr->height] == 0 &&
+                64 + total_nodes * B * sizeof(RunepkgSTreeKey) == (uint64_t)st.st_size;
+    }
+    if (!valid) {
+        munmap(map, st.st_size);
+        return -1;
+    }
+    tree->map = map;
+    tree->map_size = st.st_size;
+    tree->hdr = hdr;
+    tree->keys = (const RunepkgSTreeKey *)((const char *)map + 64);
+    return 0;
+}
+
+void runepkg_stree_close(RunepkgSTree *tree) {
+    if (tree && tree->map) munmap(tree->map, tree->map_size);
+    if (tree) memset(tree, 0, sizeof(*tree));
+}
+
+uint32_t runepkg_stree_lower_bound(const RunepkgSTree *tree, const char *query,
+                                   runepkg_stree_name_fn name_at, const void *ctx) {
+    const RunepkgSTreeHeader *hdr = tree->hdr;
+    RunepkgSTreeKey q = stree_key(query);
+
+    uint64_t k = 0;
+    for (uint32_t h = hdr->height; h >= 1; h--) {
+        const RunepkgSTreeKey *node = tree->keys + ((uint64_t)hdr->layer_offset[h] + k) * B;
+        k = k * (B + 1) + stree_rank_in_node(node, q);
+    }
+    const RunepkgSTreeKey *leaf = tree->keys + ((uint64_t)hdr->layer_offset[0] + k) * B;
+    uint64_t pos = k * B + stree_rank_in_node(leaf, q);
+    if (pos > hdr->key_count) pos = hdr->key_count;
+
+    // Names longer than the inline key can tie on all 16 bytes (think "golang-github-*");
+    // settle those on the full string, galloping so long runs stay logarithmic.
+    if (strnlen(query, RUNEPKG_STREE_KEY_BYTES + 1) > RUNEPKG_STREE_KEY_BYTES &&
+        pos < hdr->key_count && strcmp(name_at(ctx, (uint32_t)pos), query) < 0) {
+        uint64_t low = pos + 1, step = 1, high;
+        while (1) {
+            high = low + step - 1;
+            if (high >= hdr->key_count) { high = hdr->key_count; break; }
+            if (strcmp(name_at(ctx, (uint32_t)high), query) >= 0) break;
+            low = high + 1;
+            step *= 2;
+        }
+        while (low < high) {
+            uint64_t mid = low + (high - low) / 2;
+            if (strcmp(name_at(ctx, (uint32_t)mid), query) < 0) low = mid + 1;
+            else high = mid;
+        }
+        pos = low;
+    }
+    return (uint32_t)pos;
+}
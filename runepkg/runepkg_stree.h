@@ -0,0 +1,101 @@
+/******************************************************************************
+ * Filename:    runepkg_stree.h
+ * Author:      <michkochris@gmail.com>
+ * Date:        started 01-03-2025
+ * Description: Static B+ tree over sorted name indexes for prefix completion
+ *
+ * Copyright (c) 2025 runepkg (Runar Linux) All rights reserved.
+ * GPLV3
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <https://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#ifndef RUNEPKG_STREE_H
+#define RUNEPKG_STREE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * A search tree written beside a sorted name index (the autocomplete index and
+ * the repo indexes). Every name is reduced to its first 16 bytes, stored inline
+ * as two big-endian integers, and the keys are laid out as a static B+ tree of
+ * 8-key (128-byte) nodes: the leaf layer is the sorted key array itself and each
+ * upper layer holds the first key of every child subtree. A lower-bound search
+ * touches one node per layer (~6 at 100k names) and compares integers only; the
+ * string blob is read only to break ties between names sharing 16 bytes.
+ */
+
+#define RUNEPKG_STREE_MAGIC 0x45455254 // "TREE"
+#define RUNEPKG_STREE_VERSION 1
+#define RUNEPKG_STREE_NODE_KEYS 8
+#define RUNEPKG_STREE_KEY_BYTES 16
+#define RUNEPKG_STREE_MAX_LAYERS 10
+
+typedef struct {
+    uint64_t hi;
+    uint64_t lo;
+} RunepkgSTreeKey;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t key_count;       // Number of names in the source index
+    uint32_t height;          // Layers above the leaves
+    uint64_t source_size;     // Size of the index file the tree was built for
+    uint32_t layer_offset[RUNEPKG_STREE_MAX_LAYERS]; // First node of each layer, leaves at [0]
+} RunepkgSTreeHeader;
+
+typedef struct {
+    void *map;
+    size_t map_size;
+    const RunepkgSTreeHeader *hdr;
+    const RunepkgSTreeKey *keys;
+} RunepkgSTree;
+
+/* Returns the name at sorted position i of the source index. */
+typedef const char *(*runepkg_stree_name_fn)(const void *ctx, uint32_t i);
+
+/**
+ * @brief Builds the tree for a sorted name list and writes it atomically to path
+ * @param source_size Size of the index file the names come from (checked on open)
+ * @return 0 on success, -1 on failure
+ */
+int runepkg_stree_write(const char *path, runepkg_stree_name_fn name_at, const void *ctx,
+                        uint32_t count, uint64_t source_size);
+
+/**
+ * @brief Maps a tree, rejecting it unless it matches the index it will be used with
+ * @return 0 on success, -1 if missing, stale or malformed (tree is left closed)
+ */
+int runepkg_stree_open(RunepkgSTree *tree, const char *path, uint32_t key_count, uint64_t source_size);
+
+void runepkg_stree_close(RunepkgSTree *tree);
+
+/**
+ * @brief Finds the first position whose name is >= query (strcmp order)
+ * @param name_at Accessor into the source index, used only for 16-byte ties
+ * @return A position in [0, key_count]
+ */
+uint32_t runepkg_stree_lower_bound(const RunepkgSTree *tree, const char *query,
+                                   runepkg_stree_name_fn name_at, const void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RUNEPKG_STREE_H
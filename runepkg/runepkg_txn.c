@@ -0,0 +1,660 @@
+/******************************************************************************
+ * Filename:    runepkg_txn.c
+ * Author:      <michkochris@gmail.com>
+ * Date:        started 01-03-2025
+ * Description: Install/upgrade/remove transactions and rollback
+ *
+ * Copyright (c) 2025 runepkg (Runar Linux) All rights reserved.
+ * GPLV3
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <https://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <time.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "runepkg_txn.h"
+#include "runepkg_config.h"
+#include "runepkg_storage.h"
+#include "runepkg_util.h"
+
+// This run's transaction; created on the first change so read-only commands
+// and no-op installs leave nothing behind.
+static pthread_mutex_t g_txn_lock = PTHREAD_MUTEX_INITIALIZER;
+static FILE *g_txn_manifest = NULL;
+static char *g_txn_path = NULL;
+static char g_txn_id[40];
+static bool g_txn_failed = false;
+static bool g_txn_suspended = false;
+static bool g_txn_copy_warned = false;
+static int g_txn_created = 0;
+static int g_txn_displaced = 0;
+static int g_txn_records = 0;
+
+static char *txn_root(void) {
+    if (g_transaction_dir && g_transaction_dir[0]) {
+        return strdup(g_transaction_dir);
+    }
+    if (!g_runepkg_base_dir) {
+        return NULL;
+    }
+    return runepkg_util_concat_path(g_runepkg_base_dir, "transactions");
+}
+
+// Length of install_dir without trailing slashes, so "/" and "/srv/root/"
+// both compare cleanly against package paths.
+static size_t txn_root_len(const char *root) {
+    size_t len = strlen(root);
+    while (len > 0 && root[len - 1] == '/') {
+        len--;
+    }
+    return len;
+}
+
+// Returns path relative to install_dir, or NULL if it is outside it or could
+// not be written as one manifest line.
+static const char *txn_relative(const char *path) {
+    const char *root = g_system_install_root;
+    if (!root || !path) {
+        return NULL;
+    }
+    size_t len = txn_root_len(root);
+    if (strncmp(path, root, len) != 0 || path[len] != '/') {
+        return NULL;
+    }
+    while (path[len] == '/') {
+        len++;
+    }
+    if (!path[len] || strchr(path + len, '\n')) {
+        return NULL;
+    }
+    return path + len;
+}
+
+static int txn_make_parent(const char *path) {
+    char *parent = strdup(path);
+    if (!parent) {
+        return -1;
+    }
+    char *slash = strrchr(parent, '/');
+    int ret = 0;
+    if (slash && slash != parent) {
+        *slash = '\0';
+        ret = runepkg_util_create_dir_recursive(parent, 0755);
+    }
+    free(parent);
+    return ret;
+}
+
+static int txn_copy_tree(const char *src, const char *dst) {
+    struct stat st;
+    if (lstat(src, &st) != 0) {
+        return -1;
+    }
+
+    if (S_ISLNK(st.st_mode)) {
+        char target[PATH_MAX];
+        ssize_t n = readlink(src, target, sizeof(target) - 1);
+        if (n < 0) {
+            return -1;
+        }
+        target[n] = '\0';
+        return symlink(target, dst);
+    }
+
+    if (!S_ISDIR(st.st_mode)) {
+        return runepkg_util_copy_file(src, dst);
+    }
+
+    if (mkdir(dst, st.st_mode & 07777) != 0 && errno != EEXIST) {
+        return -1;
+    }
+    DIR *dir = opendir(src);
+    if (!dir) {
+        return -1;
+    }
+    int ret = 0;
+    struct dirent *entry;
+    while (ret == 0 && (entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+        char *s = runepkg_util_concat_path(src, entry->d_name);
+        char *d = runepkg_util_concat_path(dst, entry->d_name);
+        ret = (s && d) ? txn_copy_tree(s, d) : -1;
+        free(s);
+        free(d);
+    }
+    closedir(dir);
+    return ret;
+}
+
+static int txn_remove(const char *path) {
+    struct stat st;
+    if (lstat(path, &st) != 0) {
+        return errno == ENOENT ? 0 : -1;
+    }
+    if (S_ISDIR(st.st_mode)) {
+        return runepkg_storage_remove_directory_tree(path);
+    }
+    return unlink(path);
+}
+
+// Empties a path before something is restored there. Package records are
+// whole trees; under install_dir only files are ours, so a directory that
+// has since appeared is removed only if empty.
+static int txn_clear(const char *path, bool tree) {
+    struct stat st;
+    if (!tree && lstat(path, &st) == 0 && S_ISDIR(st.st_mode)) {
+        return rmdir(path);
+    }
+    return txn_remove(path);
+}
+
+// Moves src to dst, creating dst's parents. A rename keeps this O(1); when
+// transaction_dir is on another filesystem we copy and delete instead.
+static int txn_move(const char *src, const char *dst) {
+    if (txn_make_parent(dst) != 0) {
+        return -1;
+    }
+    if (rename(src, dst) == 0) {
+        return 0;
+    }
+    if (errno != EXDEV) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&g_txn_lock);
+    if (!g_txn_copy_warned) {
+        g_txn_copy_warned = true;
+        fprintf(stderr, "Warning: transaction_dir is not on the same filesystem as %s; "
+                        "copying instead of renaming.\n", src);
+    }
+    pthread_mutex_unlock(&g_txn_lock);
+
+    if (txn_copy_tree(src, dst) != 0) {
+        txn_remove(dst);
+        return -1;
+    }
+    return txn_remove(src);
+}
+
+static int txn_open_locked(void) {
+    char *root = txn_root();
+    if (!root) {
+        return -1;
+    }
+
+    struct timespec ts;
+    struct tm tm_now;
+    char stamp[20];
+    clock_gettime(CLOCK_REALTIME, &ts);
+    localtime_r(&ts.tv_sec, &tm_now);
+    strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &tm_now);
+    snprintf(g_txn_id, sizeof(g_txn_id), "%s-%06d", stamp, (int)(ts.tv_nsec / 1000));
+
+    g_txn_path = runepkg_util_concat_path(root, g_txn_id);
+    free(root);
+    if (!g_txn_path) {
+        return -1;
+    }
+
+    char *manifest = runepkg_util_concat_path(g_txn_path, "manifest");
+    if (runepkg_util_create_dir_recursive(g_txn_path, 0700) != 0 ||
+        !manifest || (g_txn_manifest = fopen(manifest, "w")) == NULL) {
+        fprintf(stderr, "Warning: cannot start transaction in %s; rollback will not be available for this run.\n",
+                g_txn_path);
+        free(manifest);
+        runepkg_util_free_and_null(&g_txn_path);
+        return -1;
+    }
+    free(manifest);
+
+    fprintf(g_txn_manifest, "root %.*s\n", (int)txn_root_len(g_system_install_root), g_system_install_root);
+    fprintf(g_txn_manifest, "db %s\n", g_runepkg_db_dir);
+    fflush(g_txn_manifest);
+    runepkg_log_verbose("[txn] Started transaction %s\n", g_txn_id);
+    return 0;
+}
+
+// Caller holds g_txn_lock. A transaction that could not be created is not
+// retried for every file; the run carries on without one.
+static int txn_begin_locked(void) {
+    if (g_txn_manifest) {
+        return 0;
+    }
+    if (g_txn_failed || txn_open_locked() != 0) {
+        g_txn_failed = true;
+        return -1;
+    }
+    return 0;
+}
+
+// Appends one manifest line. Flushed immediately so a run that dies halfway
+// can still be rolled back to where it started.
+static void txn_log_locked(char op, const char *arg) {
+    fprintf(g_txn_manifest, "%c %s\n", op, arg);
+    fflush(g_txn_manifest);
+}
+
+bool runepkg_txn_enabled(void) {
+    return g_keep_transactions > 0 && !g_txn_suspended &&
+           g_system_install_root && g_runepkg_db_dir;
+}
+
+void runepkg_txn_suspend(bool suspend) {
+    g_txn_suspended = suspend;
+}
+
+int runepkg_txn_displace(const char *path) {
+    if (!runepkg_txn_enabled()) {
+        return -1;
+    }
+    const char *rel = txn_relative(path);
+    if (!rel) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&g_txn_lock);
+    if (txn_begin_locked() != 0) {
+        pthread_mutex_unlock(&g_txn_lock);
+        return -1;
+    }
+    char *files = runepkg_util_concat_path(g_txn_path, "files");
+    pthread_mutex_unlock(&g_txn_lock);
+
+    char *backup = files ? runepkg_util_concat_path(files, rel) : NULL;
+    free(files);
+    if (!backup) {
+        return -1;
+    }
+
+    // Already saved earlier in this run: what is there now was written by
+    // this transaction, so the caller can simply delete it.
+    struct stat st;
+    if (lstat(backup, &st) == 0 || txn_move(path, backup) != 0) {
+        free(backup);
+        return -1;
+    }
+    free(backup);
+
+    pthread_mutex_lock(&g_txn_lock);
+    txn_log_locked('D', rel);
+    g_txn_displaced++;
+    pthread_mutex_unlock(&g_txn_lock);
+    return 0;
+}
+
+void runepkg_txn_note_created(const char *path) {
+    if (!runepkg_txn_enabled()) {
+        return;
+    }
+    const char *rel = txn_relative(path);
+    if (!rel) {
+        return;
+    }
+
+    pthread_mutex_lock(&g_txn_lock);
+    if (txn_begin_locked() == 0) {
+        txn_log_locked('C', rel);
+        g_txn_created++;
+    }
+    pthread_mutex_unlock(&g_txn_lock);
+}
+
+int runepkg_txn_save_record(const char *pkg_name, const char *pkg_version) {
+    char record[PATH_MAX];
+    if (!runepkg_txn_enabled() ||
+        runepkg_storage_get_package_path(pkg_name, pkg_version, record) != 0 ||
+        !runepkg_util_file_exists(record)) {
+        return -1;
+    }
+    const char *base = strrchr(record, '/') + 1;
+
+    pthread_mutex_lock(&g_txn_lock);
+    if (txn_begin_locked() != 0) {
+        pthread_mutex_unlock(&g_txn_lock);
+        return -1;
+    }
+    char *db = runepkg_util_concat_path(g_txn_path, "db");
+    pthread_mutex_unlock(&g_txn_lock);
+
+    char *backup = db ? runepkg_util_concat_path(db, base) : NULL;
+    free(db);
+    struct stat st;
+    if (!backup || lstat(backup, &st) == 0 || txn_move(record, backup) != 0) {
+        free(backup);
+        return -1;
+    }
+    free(backup);
+
+    pthread_mutex_lock(&g_txn_lock);
+    txn_log_locked('R', base);
+    g_txn_records++;
+    pthread_mutex_unlock(&g_txn_lock);
+    return 0;
+}
+
+void runepkg_txn_note_record(const char *pkg_name, const char *pkg_version) {
+    char record[PATH_MAX];
+    if (!runepkg_txn_enabled() ||
+        runepkg_storage_get_package_path(pkg_name, pkg_version, record) != 0) {
+        return;
+    }
+
+    pthread_mutex_lock(&g_txn_lock);
+    if (txn_begin_locked() == 0) {
+        txn_log_locked('r', strrchr(record, '/') + 1);
+        g_txn_records++;
+    }
+    pthread_mutex_unlock(&g_txn_lock);
+}
+
+static int compare_ids(const void *a, const void *b) {
+    return strcmp(*(const char *const *)a, *(const char *const *)b);
+}
+
+// Transaction ids under root, oldest first (ids sort chronologically).
+static char **txn_collect(const char *root, int *count) {
+    *count = 0;
+    DIR *dir = opendir(root);
+    if (!dir) {
+        return NULL;
+    }
+
+    char **ids = NULL;
+    int cap = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+        char *txn = runepkg_util_concat_path(root, entry->d_name);
+        char *manifest = txn ? runepkg_util_concat_path(txn, "manifest") : NULL;
+        bool ok = manifest && runepkg_util_file_exists(manifest);
+        free(manifest);
+        free(txn);
+        if (!ok) {
+            continue;
+        }
+        if (*count == cap) {
+            cap = cap ? cap * 2 : 16;
+            char **grown = realloc(ids, cap * sizeof(char *));
+            if (!grown) {
+                break;
+            }
+            ids = grown;
+        }
+        ids[(*count)++] = strdup(entry->d_name);
+    }
+    closedir(dir);
+
+    if (ids) {
+        qsort(ids, *count, sizeof(char *), compare_ids);
+    }
+    return ids;
+}
+
+static void txn_free_ids(char **ids, int count) {
+    for (int i = 0; i < count; i++) {
+        free(ids[i]);
+    }
+    free(ids);
+}
+
+void runepkg_txn_commit(void) {
+    pthread_mutex_lock(&g_txn_lock);
+    if (!g_txn_manifest) {
+        pthread_mutex_unlock(&g_txn_lock);
+        return;
+    }
+    fclose(g_txn_manifest);
+    g_txn_manifest = NULL;
+    runepkg_log_verbose("[txn] Transaction %s: %d files created, %d replaced or removed, %d package records; "
+                        "'runepkg rollback' undoes it.\n",
+                        g_txn_id, g_txn_created, g_txn_displaced, g_txn_records);
+    runepkg_util_free_and_null(&g_txn_path);
+    pthread_mutex_unlock(&g_txn_lock);
+
+    char *root = txn_root();
+    if (!root) {
+        return;
+    }
+    int count = 0;
+    char **ids = txn_collect(root, &count);
+    for (int i = 0; (unsigned long)(count - i) > g_keep_transactions; i++) {
+        char *old = runepkg_util_concat_path(root, ids[i]);
+        if (old) {
+            runepkg_log_verbose("[txn] Pruning transaction %s\n", ids[i]);
+            runepkg_storage_remove_directory_tree(old);
+            free(old);
+        }
+    }
+    txn_free_ids(ids, count);
+    free(root);
+}
+
+// Splits a manifest buffer into lines in place.
+static char **txn_split_lines(char *buf, int *count) {
+    int cap = 64;
+    char **lines = malloc(cap * sizeof(char *));
+    *count = 0;
+    char *save = NULL;
+    for (char *line = strtok_r(buf, "\n", &save); line && lines; line = strtok_r(NULL, "\n", &save)) {
+        if (*count == cap) {
+            cap *= 2;
+            char **grown = realloc(lines, cap * sizeof(char *));
+            if (!grown) {
+                free(lines);
+                return NULL;
+            }
+            lines = grown;
+        }
+        lines[(*count)++] = line;
+    }
+    return lines;
+}
+
+// Replays one manifest backwards. Each step tolerates having already been
+// done, so a rollback that stops halfway can simply be run again.
+static int txn_undo(const char *root, const char *id) {
+    char *txn = runepkg_util_concat_path(root, id);
+    char *manifest = txn ? runepkg_util_concat_path(txn, "manifest") : NULL;
+    char *buf = manifest ? runepkg_util_read_file_content(manifest, NULL) : NULL;
+    free(manifest);
+    int count = 0;
+    char **lines = buf ? txn_split_lines(buf, &count) : NULL;
+    if (!lines || count < 2) {
+        fprintf(stderr, "Error: cannot read manifest of transaction %s\n", id);
+        free(lines);
+        free(buf);
+        free(txn);
+        return -1;
+    }
+
+    char cur_root[PATH_MAX];
+    snprintf(cur_root, sizeof(cur_root), "%.*s",
+             (int)txn_root_len(g_system_install_root), g_system_install_root);
+    if (strncmp(lines[0], "root ", 5) != 0 || strcmp(lines[0] + 5, cur_root) != 0 ||
+        strncmp(lines[1], "db ", 3) != 0 || strcmp(lines[1] + 3, g_runepkg_db_dir) != 0) {
+        fprintf(stderr, "Error: transaction %s was recorded for %s, not the configured install_dir/database.\n",
+                id, strncmp(lines[0], "root ", 5) == 0 ? lines[0] + 5 : "another root");
+        free(lines);
+        free(buf);
+        free(txn);
+        return -1;
+    }
+
+    // An empty root means "/"; concat_path wants a directory to append to.
+    const char *base_root = cur_root[0] ? cur_root : "/";
+    char *files = runepkg_util_concat_path(txn, "files");
+    char *db = runepkg_util_concat_path(txn, "db");
+    int failures = 0, restored = 0, deleted = 0, records = 0;
+
+    for (int i = count - 1; i >= 2 && files && db; i--) {
+        char op = lines[i][0];
+        const char *arg = lines[i] + 2;
+        if (lines[i][1] != ' ' || !*arg) {
+            continue;
+        }
+
+        bool is_record = (op == 'r' || op == 'R');
+        char *live = runepkg_util_concat_path(is_record ? g_runepkg_db_dir : base_root, arg);
+        char *saved = (op == 'D' || op == 'R') ? runepkg_util_concat_path(op == 'D' ? files : db, arg) : NULL;
+        if (!live || ((op == 'D' || op == 'R') && !saved)) {
+            failures++;
+        } else if (op == 'C' || op == 'r') {
+            if (txn_clear(live, op == 'r') != 0) {
+                fprintf(stderr, "Error: cannot remove %s: %s\n", live, strerror(errno));
+                failures++;
+            } else if (op == 'C') {
+                deleted++;
+            } else {
+                records++;
+            }
+        } else if (op == 'D' || op == 'R') {
+            struct stat st;
+            if (lstat(saved, &st) == 0) {
+                if (txn_clear(live, op == 'R') != 0) {
+                    fprintf(stderr, "Error: cannot clear %s: %s\n", live, strerror(errno));
+                    failures++;
+                } else if (txn_move(saved, live) != 0) {
+                    fprintf(stderr, "Error: cannot restore %s: %s\n", live, strerror(errno));
+                    failures++;
+                } else if (op == 'D') {
+                    restored++;
+                } else {
+                    records++;
+                }
+            }
+        }
+        free(live);
+        free(saved);
+    }
+
+    if (!files || !db) {
+        failures++;
+    }
+    if (failures == 0) {
+        runepkg_storage_remove_directory_tree(txn);
+        printf("Rolled back transaction %s: %d files restored, %d removed, %d package records.\n",
+               id, restored, deleted, records);
+    } else {
+        fprintf(stderr, "Error: %d changes of transaction %s could not be undone; it has been kept so "
+                        "'runepkg rollback' can be retried.\n", failures, id);
+    }
+
+    free(files);
+    free(db);
+    free(lines);
+    free(buf);
+    free(txn);
+    return failures == 0 ? 0 : -1;
+}
+
+int runepkg_txn_rollback(const char *target_id) {
+    if (!g_system_install_root || !g_runepkg_db_dir) {
+        fprintf(stderr, "Error: install_dir and runepkg_dir must be configured.\n");
+        return -1;
+    }
+    char *root = txn_root();
+    if (!root) {
+        return -1;
+    }
+
+    int count = 0;
+    char **ids = txn_collect(root, &count);
+    if (count == 0) {
+        printf("No transactions to roll back.\n");
+        txn_free_ids(ids, count);
+        free(root);
+        return 0;
+    }
+
+    int stop = count - 1;
+    if (target_id) {
+        for (stop = count - 1; stop >= 0 && strcmp(ids[stop], target_id) != 0; stop--);
+        if (stop < 0) {
+            fprintf(stderr, "Error: no transaction '%s'; see 'runepkg rollback list'.\n", target_id);
+            txn_free_ids(ids, count);
+            free(root);
+            return -1;
+        }
+    }
+
+    int undone = 0;
+    for (int i = count - 1; i >= stop; i--) {
+        if (txn_undo(root, ids[i]) != 0) {
+            undone = -1;
+            break;
+        }
+        undone++;
+    }
+
+    txn_free_ids(ids, count);
+    free(root);
+    return undone;
+}
+
+int runepkg_txn_list(void) {
+    char *root = txn_root();
+    if (!root) {
+        return 0;
+    }
+    int count = 0;
+    char **ids = txn_collect(root, &count);
+    if (count == 0) {
+        printf("No transactions recorded in %s\n", root);
+    }
+
+    for (int i = 0; i < count; i++) {
+        char *txn = runepkg_util_concat_path(root, ids[i]);
+        char *manifest = txn ? runepkg_util_concat_path(txn, "manifest") : NULL;
+        FILE *fp = manifest ? fopen(manifest, "r") : NULL;
+        int created = 0, displaced = 0;
+        char line[PATH_MAX + 4];
+
+        printf("%s ", ids[i]);
+        while (fp && fgets(line, sizeof(line), fp)) {
+            line[strcspn(line, "\n")] = '\0';
+            if (line[1] != ' ') {
+                continue;
+            }
+            switch (line[0]) {
+                case 'C': created++; break;
+                case 'D': displaced++; break;
+                case 'r': printf(" +%s", line + 2); break;
+                case 'R': printf(" -%s", line + 2); break;
+                default: break;
+            }
+        }
+        printf("  (%d created, %d replaced or removed)\n", created, displaced);
+        if (fp) {
+            fclose(fp);
+        }
+        free(manifest);
+        free(txn);
+    }
+
+    txn_free_ids(ids, count);
+    free(root);
+    return count;
+}
@@ -0,0 +1,104 @@
+/******************************************************************************
+ * Filename:    runepkg_txn.h
+ * Author:      <michkochris@gmail.com>
+ * Date:        started 01-03-2025
+ * Description: Install/upgrade/remove transactions and rollback
+ *
+ * Copyright (c) 2025 runepkg (Runar Linux) All rights reserved.
+ * GPLV3
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <https://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#ifndef RUNEPKG_TXN_H
+#define RUNEPKG_TXN_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+
+/*
+ * Each runepkg run that changes install_dir is one transaction, stored as
+ *     <transaction_dir>/<id>/manifest
+ *     <transaction_dir>/<id>/files/<path>    files it replaced or removed
+ *     <transaction_dir>/<id>/db/<name-version> package records it replaced
+ * The manifest names the root and database it applies to, then one line per
+ * change in the order it happened:
+ *     C <path>  created where nothing was before
+ *     D <path>  existing file moved into files/
+ *     r <dir>   package record created
+ *     R <dir>   existing package record moved into db/
+ * Displaced files are renamed, not copied, so journaling costs one rename per
+ * file and 'runepkg rollback' undoes a transaction with renames alone by
+ * replaying its manifest backwards. Maintainer scripts are not undone.
+ */
+
+/**
+ * @brief True when changes made by this run are being journaled
+ */
+bool runepkg_txn_enabled(void);
+
+/**
+ * @brief Stops or resumes journaling (bootstrap builds other roots)
+ */
+void runepkg_txn_suspend(bool suspend);
+
+/**
+ * @brief Moves an existing file or symlink out of the way into the transaction
+ * @param path Absolute path under install_dir about to be replaced or removed
+ * @return 0 when path was moved aside (it no longer exists), -1 when the
+ *         caller should delete it as before (journaling off or not possible)
+ */
+int runepkg_txn_displace(const char *path);
+
+/**
+ * @brief Records that path is being created where nothing existed
+ */
+void runepkg_txn_note_created(const char *path);
+
+/**
+ * @brief Moves an existing package record into the transaction
+ * @return 0 when the record was moved aside, -1 when the caller should remove it
+ */
+int runepkg_txn_save_record(const char *pkg_name, const char *pkg_version);
+
+/**
+ * @brief Records that a package record was written by this run
+ */
+void runepkg_txn_note_record(const char *pkg_name, const char *pkg_version);
+
+/**
+ * @brief Closes this run's transaction and prunes those beyond keep_transactions
+ */
+void runepkg_txn_commit(void);
+
+/**
+ * @brief Undoes transactions, newest first
+ * @param target_id Roll back through this transaction, or NULL for only the newest
+ * @return Number of transactions undone, -1 on failure
+ */
+int runepkg_txn_rollback(const char *target_id);
+
+/**
+ * @brief Prints the kept transactions, oldest first
+ * @return Number of transactions listed
+ */
+int runepkg_txn_list(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RUNEPKG_TXN_H
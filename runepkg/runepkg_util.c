@@ -600,6 +600,10 @@ bool runepkg_util_parse_yes_no(const char *s, bool default_val) {
 // --- Command Execution ---
 
 int runepkg_util_execute_command(const char *command_path, char *const argv[]) {
+    return runepkg_util_execute_command_in(NULL, command_path, argv);
+}
+
+int runepkg_util_execute_command_in(const char *work_dir, const char *command_path, char *const argv[]) {
     runepkg_util_log_debug("Executing command: %s\n", command_path);
     pid_t pid = fork();
 
@@ -607,6 +611,11 @@ int runepkg_util_execute_command(const char *command_path, char *const argv[]) {
         perror("Failed to fork process");
         return -1;
     } else if (pid == 0) {
+        // Change directory in the child only, so concurrent extractions don't race on the cwd
+        if (work_dir && chdir(work_dir) != 0) {
+            perror("Failed to change directory");
+            _exit(1);
+        }
         // Use execvp to search PATH and allow relative command names
         execvp(argv[0], argv);
         perror("Failed to execute command");
@@ -652,21 +661,6 @@ static int extract_deb_archive(const char *deb_path, const char *destination_dir
         return -1;
     }
 
-    char current_dir[PATH_MAX];
-    if (getcwd(current_dir, sizeof(current_dir)) == NULL) {
-        perror("getcwd failed");
-        runepkg_util_error("Failed to get current working directory.\n");
-        free(absolute_deb_path);
-        return -1;
-    }
-
-    if (chdir(destination_dir) != 0) {
-        perror("Failed to change directory for .deb extraction");
-        runepkg_util_error("Could not change to '%s'.\n", destination_dir);
-        free(absolute_deb_path);
-        return -1;
-    }
-
     char *ar_path = "/usr/bin/ar";
 
     char *argv_ar[] = {
@@ -676,12 +670,7 @@ static int extract_deb_archive(const char *deb_path, const char *destination_dir
         NULL
     };
 
-    int result = runepkg_util_execute_command(ar_path, argv_ar);
-
-    if (chdir(current_dir) != 0) {
-        perror("Failed to change back to original directory");
-        runepkg_util_log_verbose("Continuing, but directory state is unexpected.\n");
-    }
+    int result = runepkg_util_execute_command_in(destination_dir, ar_path, argv_ar);
 
     free(absolute_deb_path);
 
@@ -740,7 +729,7 @@ static int find_tar_archives(const char *deb_extract_dir, char **control_archive
     return 0;
 }
 
-static int extract_tar_archive(const char *archive_path, const char *destination_dir) {
+static int extract_tar_archive(const char *archive_path, const char *destination_dir, const char *const *excludes) {
     if (!archive_path || !destination_dir) {
         runepkg_util_error("extract_tar_archive: NULL archive_path or destination_dir.\n");
         return -1;
@@ -759,35 +748,33 @@ static int extract_tar_archive(const char *archive_path, const char *destination
         return -1;
     }
 
-    char current_dir[PATH_MAX];
-    if (getcwd(current_dir, sizeof(current_dir)) == NULL) {
-        perror("getcwd failed");
-        runepkg_util_error("Failed to get current working directory.\n");
-        return -1;
-    }
-
-    if (chdir(destination_dir) != 0) {
-        perror("Failed to change directory for tar extraction");
-        runepkg_util_error("Could not change to '%s'.\n", destination_dir);
-        return -1;
-    }
-
     char *tar_path = "/usr/bin/tar";
 
-    char *argv_tar[] = {
-        "tar",
-        "-xf",
-        (char *)archive_path,
-        NULL
-    };
-
-    int result = runepkg_util_execute_command(tar_path, argv_tar);
+    int exclude_count = 0;
+    while (excludes && excludes[exclude_count]) exclude_count++;
 
-    if (chdir(current_dir) != 0) {
-        perror("Failed to change back to original directory");
-        runepkg_util_log_verbose("Continuing, but directory state is unexpected.\n");
+    // Excluded members are skipped by tar itself, so their bytes never hit the disk
+    char **argv_tar = calloc((size_t)exclude_count + 7, sizeof(char *));
+    if (!argv_tar) {
+        runepkg_util_error("Memory allocation failed for tar arguments.\n");
+        return -1;
+    }
+    int argc = 0;
+    argv_tar[argc++] = "tar";
+    argv_tar[argc++] = "-xf";
+    argv_tar[argc++] = (char *)archive_path;
+    if (exclude_count > 0) {
+        argv_tar[argc++] = "--anchored";
+        argv_tar[argc++] = "--wildcards";
+        argv_tar[argc++] = "--wildcards-match-slash";
+        for (int i = 0; i < exclude_count; i++) {
+            argv_tar[argc++] = (char *)excludes[i];
+        }
     }
 
+    int result = runepkg_util_execute_command_in(destination_dir, tar_path, argv_tar);
+    free(argv_tar);
+
     if (result != 0) {
         runepkg_util_error("Failed to execute 'tar' for archive extraction.\n");
         return -1;
@@ -798,6 +785,10 @@ static int extract_tar_archive(const char *archive_path, const char *destination
 }
 
 int runepkg_util_extract_deb_complete(const char *deb_path, const char *extract_dir) {
+    return runepkg_util_extract_deb_excluding(deb_path, extract_dir, NULL);
+}
+
+int runepkg_util_extract_deb_excluding(const char *deb_path, const char *extract_dir, const char *const *data_excludes) {
     if (!deb_path || !extract_dir) {
         runepkg_util_error("extract_deb_complete: NULL deb_path or extract_dir.\n");
         return -1;
@@ -843,7 +834,7 @@ int runepkg_util_extract_deb_complete(const char *deb_path, const char *extract_
         return -1;
     }
 
-    if (extract_tar_archive(control_archive_path, control_extract_dir) != 0) {
+    if (extract_tar_archive(control_archive_path, control_extract_dir, NULL) != 0) {
         runepkg_util_error("Failed to extract control archive.\n");
         runepkg_util_free_and_null(&temp_dir);
         runepkg_util_free_and_null(&control_archive_path);
@@ -853,7 +844,7 @@ int runepkg_util_extract_deb_complete(const char *deb_path, const char *extract_
         return -1;
     }
 
-    if (extract_tar_archive(data_archive_path, data_extract_dir) != 0) {
+    if (extract_tar_archive(data_archive_path, data_extract_dir, data_excludes) != 0) {
         runepkg_util_error("Failed to extract data archive.\n");
         runepkg_util_free_and_null(&temp_dir);
         runepkg_util_free_and_null(&control_archive_path);
@@ -1010,6 +1001,28 @@ int runepkg_util_init_fhs(const char *root) {
     return 0;
 }
 
+// True when a Build-Depends restriction list ("amd64 i386]" or "!armel]", the
+// text after '[') admits the native architecture.
+static bool arch_restriction_matches(const char *list) {
+    const char *native = runepkg_config_native_arch();
+    bool negated = false, matched = false;
+    while (*list && *list != ']') {
+        while (*list == ' ' || *list == '\t') list++;
+        bool neg = (*list == '!');
+        if (neg) list++;
+        size_t len = strcspn(list, " \t]");
+        if (len == 0) break;
+        bool hit = (len == 3 && strncmp(list, "any", 3) == 0) ||
+                   (len == 9 && strncmp(list, "linux-any", 9) == 0) ||
+                   (len == strlen(native) && strncmp(list, native, len) == 0) ||
+                   (len == strlen(native) + 4 && strncmp(list, "any-", 4) == 0 && strncmp(list + 4, native, len - 4) == 0);
+        if (neg) negated = true;
+        if (hit) matched = true;
+        list += len;
+    }
+    return negated ? !matched : matched;
+}
+
 char **parse_depends(const char *depends) {
     if (!depends || *depends == '\0') return NULL;
 
@@ -1038,14 +1051,24 @@ char **parse_depends(const char *depends) {
         char *pipe = strchr(token, '|');
         if (pipe) *pipe = '\0';
 
+        // Entries restricted to other architectures ([!amd64], [armel]) do not apply here
+        char *bracket = strchr(token, '[');
+        if (bracket && !arch_restriction_matches(bracket + 1)) {
+            token = strtok(NULL, ",");
+            continue;
+        }
+
         // Find end: stop at space, tab, or '('
         char *end = token;
         while (*end && *end != ' ' && *end != '\t' && *end != '(') end++;
         *end = '\0';
 
-        // Strip Debian-specific suffixes and restrictions: :any, [arch], <profile>
-        char *extra = strpbrk(token, ":[<");
+        // Strip restrictions and profiles ([arch], <profile>) and the :any/:native
+        // qualifiers; an explicit :arch stays so the resolver can honour it
+        char *extra = strpbrk(token, "[<");
         if (extra) *extra = '\0';
+        char *colon = strchr(token, ':');
+        if (colon && (strcmp(colon + 1, "any") == 0 || strcmp(colon + 1, "native") == 0)) *colon = '\0';
         char *clean_name = runepkg_util_trim_whitespace(token);
 
         // If not empty, add
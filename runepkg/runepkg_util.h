@@ -195,6 +195,17 @@ char *runepkg_util_get_config_value(const char *filepath, const char *key, char
  */
 int runepkg_util_extract_deb_complete(const char *deb_path, const char *extract_dir);
 
+/**
+ * @brief Same as runepkg_util_extract_deb_complete, but skips data.tar members.
+ *
+ * @param deb_path The full path to the .deb package file.
+ * @param extract_dir The directory where the .deb should be extracted.
+ * @param data_excludes NULL-terminated tar "--exclude=PATTERN" arguments applied
+ *        to the data archive only, or NULL for a full extraction.
+ * @return 0 on success, -1 on failure.
+ */
+int runepkg_util_extract_deb_excluding(const char *deb_path, const char *extract_dir, const char *const *data_excludes);
+
 /**
  * @brief Creates a .deb package from a source directory.
  * @param source_dir Directory containing 'control/' and 'data/'.
@@ -218,8 +229,18 @@ int runepkg_util_init_fhs(const char *root);
  */
 int runepkg_util_execute_command(const char *command_path, char *const argv[]);
 
+/**
+ * @brief Like runepkg_util_execute_command(), but runs the child in work_dir.
+ * The parent's working directory is never changed, so this is safe to call
+ * from several threads at once.
+ * @param work_dir Directory for the child to chdir into, or NULL to inherit.
+ */
+int runepkg_util_execute_command_in(const char *work_dir, const char *command_path, char *const argv[]);
+
 /**
  * @brief Parses the Depends field from a package control file.
+ * Alternatives keep their first entry, entries whose [arch] restriction excludes
+ * the native architecture are dropped, and an explicit ":arch" qualifier is kept.
  * @param depends The depends string (e.g., "libc6 (>= 2.2.5), libsomething").
  * @return A null-terminated array of package names, or NULL on error. Caller must free.
  */
@@ -0,0 +1,129 @@
+#!/usr/bin/env bash
+# End-to-end check of 'runepkg serve'.
+# A node mirrors a file:// repository with two suites:
+#   local   gzip lists, which the node keeps byte for byte
+#   xzonly  .xz lists fetched by hash, which the node transcodes to .gz
+# A client then runs 'update' and 'install' through the node. Every list and
+# package it receives must pass its Release checksum check.
+#
+# Usage: tests/serve_test.sh [path/to/runepkg] [port]
+set -euo pipefail
+
+RUNEPKG="$(realpath "${1:-./runepkg}")"
+PORT="${2:-31420}"
+WORK="$(mktemp -d)"
+SERVE_PID=""
+
+cleanup() {
+    if [ -n "$SERVE_PID" ]; then
+        kill "$SERVE_PID" 2>/dev/null || true
+        wait "$SERVE_PID" 2>/dev/null || true
+    fi
+    rm -rf "$WORK"
+}
+trap cleanup EXIT
+
+fail() {
+    echo "FAIL: $*"
+    if [ -f "$WORK/serve.log" ]; then sed 's/^/  serve: /' "$WORK/serve.log"; fi
+    exit 1
+}
+
+for tool in xz dpkg-deb sha256sum curl; do
+    command -v "$tool" >/dev/null || { echo "SKIP: $tool not installed"; exit 0; }
+done
+
+# write_conf <dir> <deb line>...
+write_conf() {
+    local dir="$1"; shift
+    mkdir -p "$dir"
+    {
+        echo "runepkg_dir=$dir"
+        echo "control_dir=$dir/control"
+        echo "install_dir=$dir/root"
+        echo "runepkg_db=$dir/db"
+        echo "download_dir=$dir/dl"
+        echo "build_dir=$dir/build"
+        echo "runepkg_debs=$dir/debs"
+        echo "fetch_contents=no"
+        echo "architectures=amd64"
+        for line in "$@"; do echo "$line"; done
+    } > "$dir/runepkgconfig"
+}
+
+# make_deb <name> <version> [depends]
+make_deb() {
+    local pkg="$WORK/build/$1"
+    mkdir -p "$pkg/DEBIAN" "$pkg/usr/share/$1"
+    {
+        echo "Package: $1"
+        echo "Version: $2"
+        echo "Architecture: amd64"
+        echo "Maintainer: runepkg tests <tests@runepkg>"
+        if [ -n "${3:-}" ]; then echo "Depends: $3"; fi
+        echo "Description: serve test package $1"
+    } > "$pkg/DEBIAN/control"
+    echo "$1 $2" > "$pkg/usr/share/$1/payload"
+    dpkg-deb --build "$pkg" "$WORK/mirror/pool/${1}_${2}_amd64.deb" >/dev/null
+}
+
+# --- Upstream mirror ---
+MIRROR="$WORK/mirror"
+mkdir -p "$MIRROR/pool"
+make_deb libserve 1.0
+make_deb servetool 1.0 libserve
+write_conf "$WORK/node" "deb file://$MIRROR local main" "deb file://$MIRROR xzonly main"
+RUNEPKG_CONFIG_PATH="$WORK/node/runepkgconfig" "$RUNEPKG" scan-repo "$MIRROR" >/dev/null || fail "scan-repo"
+
+# The xzonly suite publishes the same list as .xz only, with Acquire-By-Hash.
+XZ_LIST="$MIRROR/dists/xzonly/main/binary-amd64"
+mkdir -p "$XZ_LIST/by-hash/SHA256"
+gzip -dc "$MIRROR/dists/local/main/binary-amd64/Packages.gz" > "$XZ_LIST/Packages"
+xz -k "$XZ_LIST/Packages"
+XZ_SHA=$(sha256sum "$XZ_LIST/Packages.xz" | cut -d' ' -f1)
+cp "$XZ_LIST/Packages.xz" "$XZ_LIST/by-hash/SHA256/$XZ_SHA"
+{
+    echo "Suite: xzonly"
+    echo "Codename: xzonly"
+    echo "Architectures: amd64"
+    echo "Components: main"
+    echo "Acquire-By-Hash: yes"
+    echo "SHA256:"
+    for f in Packages Packages.xz; do
+        echo " $(sha256sum "$XZ_LIST/$f" | cut -d' ' -f1) $(stat -c %s "$XZ_LIST/$f") main/binary-amd64/$f"
+    done
+} > "$MIRROR/dists/xzonly/Release"
+
+# --- Node: update from the mirror, then serve ---
+RUNEPKG_CONFIG_PATH="$WORK/node/runepkgconfig" "$RUNEPKG" update > "$WORK/node.log" 2>&1 || fail "node update: $(cat "$WORK/node.log")"
+RUNEPKG_CONFIG_PATH="$WORK/node/runepkgconfig" "$RUNEPKG" -v serve "$PORT" > "$WORK/serve.log" 2>&1 &
+SERVE_PID=$!
+for _ in $(seq 50); do
+    curl -sf -o /dev/null "http://127.0.0.1:$PORT/dists/local/Release" && break
+    kill -0 "$SERVE_PID" 2>/dev/null || fail "serve exited"
+    sleep 0.1
+done
+
+# --- Client: update and install through the node ---
+write_conf "$WORK/client" "deb http://127.0.0.1:$PORT/ local main" "deb http://127.0.0.1:$PORT/ xzonly main"
+export RUNEPKG_CONFIG_PATH="$WORK/client/runepkgconfig"
+"$RUNEPKG" update > "$WORK/client-update.log" 2>&1 || fail "client update: $(cat "$WORK/client-update.log")"
+if grep -aq "Warning" "$WORK/client-update.log"; then
+    fail "client update warned: $(grep -a "Warning" "$WORK/client-update.log")"
+fi
+for suite in local xzonly; do
+    ls "$WORK/client/db/lists/"*"_dists_${suite}_main_binary-amd64_Packages.gz" >/dev/null 2>&1 || fail "client has no $suite list"
+done
+
+printf "y\ny\ny\n" | "$RUNEPKG" -i servetool > "$WORK/client-install.log" 2>&1 || fail "client install: $(cat "$WORK/client-install.log")"
+# The installed .debs are cleaned from the client's download_dir, so fetch each
+# one through the node again and check it against the client's list.
+for pkg in libserve servetool; do
+    [ -f "$WORK/client/root/usr/share/$pkg/payload" ] || fail "$pkg was not installed: $(cat "$WORK/client-install.log")"
+    want=$(gzip -dc "$WORK/client/db/lists/"*"_dists_local_main_binary-amd64_Packages.gz" |
+           awk -v p="$pkg" '/^Package:/ { cur = $2 } cur == p && /^SHA256:/ { print $2 }')
+    got=$(curl -sf "http://127.0.0.1:$PORT/pool/${pkg}_1.0_amd64.deb" | sha256sum | cut -d' ' -f1)
+    [ -n "$want" ] && [ "$want" = "$got" ] || fail "$pkg.deb from the node does not match the list's SHA256"
+done
+
+echo "PASS: update and install through runepkg serve"